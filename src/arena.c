@@ -0,0 +1,117 @@
+/**
+ * @file
+ * @brief Arena allocator implementation
+ * @author Tomas Martykan (xmarty07)
+ * @author Filip Stolfa (xstolf00)
+ * @author Patrik Korytar (xkoryt04)
+ *
+ * FIT VUT IFJ Project:
+ * Compiler of IFJ21 Language
+ */
+
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "errors.h"
+
+// COMPILE-TIME CONSTANTS
+
+#define ARENA_CHUNK_SIZE 4096 /**< Default data size of chunk. */
+
+/**
+ * Type with the strictest alignment used by compiler.
+ */
+typedef union {
+  long l;
+  double d;
+  void* p;
+} arena_align_t;
+
+#define ARENA_ALIGN sizeof(arena_align_t) /**< Alignment of objects. */
+
+// PRIVATE FUNCTION FORWARD DECLARATIONS
+
+/**
+ * Allocates new chunk and prepends it to arena.
+ * @param arena Arena to add chunk to.
+ * @param size Minimal data size of the chunk.
+ * @return Created chunk. NULL if failed to create.
+ */
+arena_chunk_t* arena_chunk_add(arena_t* arena, size_t size);
+
+// FUNCTION DEFINITIONS
+
+void arena_init(arena_t* arena) { arena->chunks = NULL; }
+
+arena_chunk_t* arena_chunk_add(arena_t* arena, size_t size) {
+  if (size < ARENA_CHUNK_SIZE) {
+    size = ARENA_CHUNK_SIZE;
+  }
+
+  // data follows the header, header size keeps it aligned
+  size_t header = (sizeof(arena_chunk_t) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  arena_chunk_t* chunk = malloc(header + size);
+  if (!chunk) {
+    error_set(EXITSTATUS_INTERNAL_ERROR);
+    return NULL;
+  }
+
+  chunk->data = (char*)chunk + header;
+  chunk->size = size;
+  chunk->used = 0;
+  chunk->next = arena->chunks;
+  arena->chunks = chunk;
+
+  return chunk;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+  arena_chunk_t* chunk = arena->chunks;
+  if (!chunk || chunk->size - chunk->used < size) {
+    chunk = arena_chunk_add(arena, size);
+    if (!chunk) {
+      return NULL;
+    }
+  }
+
+  void* ptr = chunk->data + chunk->used;
+  chunk->used += size;
+  return ptr;
+}
+
+char* arena_strdup(arena_t* arena, const char* str) {
+  size_t len = strlen(str) + 1;
+  char* copy = arena_alloc(arena, len);
+  if (!copy) {
+    return NULL;
+  }
+  memcpy(copy, str, len);
+  return copy;
+}
+
+void arena_reset(arena_t* arena) {
+  arena_chunk_t* chunk = arena->chunks;
+  if (!chunk) {
+    return;
+  }
+
+  // keep the most recent chunk only
+  while (chunk->next) {
+    arena_chunk_t* next = chunk->next->next;
+    free(chunk->next);
+    chunk->next = next;
+  }
+  chunk->used = 0;
+}
+
+void arena_free(arena_t* arena) {
+  while (arena->chunks) {
+    arena_chunk_t* next = arena->chunks->next;
+    free(arena->chunks);
+    arena->chunks = next;
+  }
+}
@@ -0,0 +1,96 @@
+/**
+ * @file
+ * @brief Arena allocator API
+ * @author Tomas Martykan (xmarty07)
+ * @author Filip Stolfa (xstolf00)
+ * @author Patrik Korytar (xkoryt04)
+ *
+ * FIT VUT IFJ Project:
+ * Compiler of IFJ21 Language
+ *
+ * @section DESCRIPTION
+ *  Allocator for many small objects with common lifetime.
+ *  Objects are not freed one by one, whole arena is reset at once.
+ *
+ * @section IMPLEMENTATION
+ *  Arena is a list of chunks, objects are carved from the first one.
+ *  When it is full, a new chunk is allocated and prepended.
+ */
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+// DATA STRUCTURES
+
+/**
+ * @struct arena_chunk_t
+ * @brief Block of memory objects are allocated from.
+ * @var arena_chunk_t::next
+ *  Previously filled chunk.
+ * @var arena_chunk_t::size
+ *  Size of data.
+ * @var arena_chunk_t::used
+ *  Number of bytes of data already allocated.
+ * @var arena_chunk_t::data
+ *  Memory of the chunk.
+ */
+typedef struct arena_chunk {
+  struct arena_chunk* next;
+  size_t size;
+  size_t used;
+  char* data;
+} arena_chunk_t;
+
+/**
+ * @struct arena_t
+ * @brief Arena allocator.
+ * @var arena_t::chunks
+ *  Chunk currently allocated from, NULL if none.
+ */
+typedef struct {
+  arena_chunk_t* chunks;
+} arena_t;
+
+// PUBLIC FUNCTION FORWARD DECLARATIONS
+
+/**
+ * Initializes empty arena. Does not allocate any memory.
+ * @param arena Arena to initialize.
+ */
+void arena_init(arena_t* arena);
+
+/**
+ * Allocates memory from arena.
+ * Sets global error flag on failure.
+ * @param arena Arena to allocate from.
+ * @param size Number of bytes to allocate.
+ * @return Allocated memory, suitably aligned for any object.
+ *  NULL if failed to allocate.
+ */
+void* arena_alloc(arena_t* arena, size_t size);
+
+/**
+ * Copies string into arena.
+ * Sets global error flag on failure.
+ * @param arena Arena to allocate from.
+ * @param str String to copy.
+ * @return Copy of the string. NULL if failed to allocate.
+ */
+char* arena_strdup(arena_t* arena, const char* str);
+
+/**
+ * Releases all objects allocated from arena.
+ * Keeps the most recent chunk for further allocations.
+ * @param arena Arena to reset.
+ */
+void arena_reset(arena_t* arena);
+
+/**
+ * Releases all memory of arena.
+ * @param arena Arena to free.
+ */
+void arena_free(arena_t* arena);
+
+#endif  // __ARENA_H__
@@ -0,0 +1,440 @@
+/**
+ * @file
+ * @brief Abstract syntax tree implementation
+ * @author Tomas Martykan (xmarty07)
+ * @author Filip Stolfa (xstolf00)
+ * @author Patrik Korytar (xkoryt04)
+ *
+ * FIT VUT IFJ Project:
+ * Compiler of IFJ21 Language
+ */
+
+#include "ast.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "errors.h"
+
+// DATA STRUCTURES
+
+/**
+ * @struct ast_func_entry_t
+ * @brief Function definition found by the called function.
+ * @var ast_func_entry_t::node
+ *  Definition of the function.
+ * @var ast_func_entry_t::reachable
+ *  Can function be called from the top level?
+ */
+typedef struct {
+  ast_node_t* node;
+  bool reachable;
+} ast_func_entry_t;
+
+// GLOBAL VARIABLES
+
+arena_t ast_arena = {NULL};
+ast_node_t* ast_program = NULL;
+
+// Where the next statement of the current block is linked
+ast_node_t** ast_tail = &ast_program;
+// Statement whose block is being built, NULL at the top level
+ast_node_t* ast_parent = NULL;
+// Statement whose variables and values are being built
+ast_node_t* ast_stmt = NULL;
+// Call whose arguments are being built
+ast_node_t* ast_call = NULL;
+// Number of statements created, position of the next one
+int ast_count = 0;
+
+// Definitions of functions sorted by their symbol table data
+ast_func_entry_t* ast_funcs = NULL;
+int ast_func_count = 0;
+// Functions found reachable whose bodies were not visited yet
+ast_func_entry_t** ast_worklist = NULL;
+int ast_work_count = 0;
+
+// PRIVATE FUNCTION FORWARD DECLARATIONS
+
+/**
+ * Allocates statement and links it to the current block.
+ * Sets global error flag on failure.
+ * @param kind Kind of the statement.
+ * @return Pointer to the statement. NULL if failed.
+ */
+ast_node_t* ast_statement(ast_kind_t kind);
+
+/**
+ * Appends expression to the end of list.
+ * Sets global error flag on failure.
+ * @param list List to append to.
+ * @param tree Expression, NULL if its parsing failed.
+ * @param to_number Is integer converted to number before it is stored?
+ */
+void ast_expr_append(ast_expr_t** list, exptree_node_t* tree, bool to_number);
+
+/**
+ * Creates leaf of variable.
+ * Sets global error flag on failure.
+ * @param name Name of the variable.
+ * @param type Type of the variable.
+ * @param lvl Level of scope of the variable.
+ * @return Pointer to the leaf. NULL if failed.
+ */
+exptree_node_t* ast_id(char* name, char type, int lvl);
+
+/**
+ * Starts block of statement.
+ * @param node Statement containing the block.
+ * @param block Where the first statement of the block is linked.
+ */
+void ast_block_begin(ast_node_t* node, ast_node_t** block);
+
+/**
+ * Ends block of the current statement.
+ */
+void ast_block_end();
+
+/**
+ * Compares entries of function definitions by their functions.
+ * @param a First entry.
+ * @param b Second entry.
+ * @return Negative, zero or positive as in qsort.
+ */
+int ast_func_compare(const void* a, const void* b);
+
+/**
+ * Finds entry of function definition.
+ * @param func Symbol table data of the function.
+ * @return Pointer to the entry. NULL if function is not defined.
+ */
+ast_func_entry_t* ast_func_find(symtab_func_data_t* func);
+
+/**
+ * Marks called function reachable, its body is visited later.
+ * Links the call to definition of the function.
+ * @param call Function call, NULL if there is none.
+ */
+void ast_reach_call(ast_node_t* call);
+
+/**
+ * Marks functions called by statements of block reachable.
+ * Branches never taken are skipped.
+ * @param node First statement of the block.
+ */
+void ast_reach_block(ast_node_t* node);
+
+// FUNCTION DEFINITIONS
+
+void ast_init() {
+  arena_init(&ast_arena);
+  ast_program = NULL;
+  ast_tail = &ast_program;
+  ast_parent = NULL;
+  ast_stmt = NULL;
+  ast_call = NULL;
+  ast_count = 0;
+}
+
+void ast_free() {
+  arena_free(&ast_arena);
+  ast_program = NULL;
+  ast_tail = &ast_program;
+  ast_parent = NULL;
+  ast_stmt = NULL;
+  ast_call = NULL;
+  ast_count = 0;
+}
+
+ast_node_t* ast_statement(ast_kind_t kind) {
+  ast_node_t* node = arena_alloc(&ast_arena, sizeof(ast_node_t));
+  if (!node) {
+    return NULL;
+  }
+
+  *node = (ast_node_t){.kind = kind,
+                       .parent = ast_parent,
+                       .index = ast_count,
+                       .last = ast_count};
+  ast_count++;
+  *ast_tail = node;
+  ast_tail = &node->next;
+  return node;
+}
+
+void ast_expr_append(ast_expr_t** list, exptree_node_t* tree, bool to_number) {
+  if (!tree) {
+    return;
+  }
+
+  ast_expr_t* expr = arena_alloc(&ast_arena, sizeof(ast_expr_t));
+  if (!expr) {
+    return;
+  }
+
+  expr->tree = tree;
+  expr->to_number = to_number;
+  expr->next = NULL;
+
+  while (*list) {
+    list = &(*list)->next;
+  }
+  *list = expr;
+}
+
+exptree_node_t* ast_id(char* name, char type, int lvl) {
+  token_t token;
+  token.type = TT_ID;
+  token.attr.str = name;
+  token.begin = 0;
+  token.end = 0;
+  return exptree_leaf(&ast_arena, &token, type, lvl);
+}
+
+void ast_block_begin(ast_node_t* node, ast_node_t** block) {
+  ast_parent = node;
+  ast_tail = block;
+}
+
+void ast_block_end() {
+  if (!ast_parent) {
+    return;
+  }
+
+  ast_parent->last = ast_count - 1;
+  ast_tail = &ast_parent->next;
+  ast_parent = ast_parent->parent;
+}
+
+void ast_function_begin(const char* name) {
+  ast_stmt = ast_statement(AST_FUNCTION);
+  if (ast_stmt) {
+    ast_stmt->name = arena_strdup(&ast_arena, name);
+  }
+}
+
+void ast_function_param(char* name, char type) {
+  if (ast_stmt) {
+    ast_expr_append(&ast_stmt->ids, ast_id(name, type, 0), false);
+  }
+}
+
+void ast_function_body(symtab_func_data_t* func) {
+  if (!ast_stmt || !func) {
+    return;
+  }
+
+  ast_stmt->func = func;
+  ast_stmt->ret_count = strlen(func->return_types);
+  ast_block_begin(ast_stmt, &ast_stmt->body);
+  ast_stmt = NULL;
+}
+
+void ast_function_end() { ast_block_end(); }
+
+void ast_call_begin(symtab_func_data_t* func) {
+  if (ast_stmt) {
+    // results are assigned by the statement being built
+    ast_call = arena_alloc(&ast_arena, sizeof(ast_node_t));
+    if (ast_call) {
+      *ast_call = (ast_node_t){.kind = AST_CALL, .parent = ast_parent};
+      ast_stmt->call = ast_call;
+    }
+  } else {
+    ast_call = ast_statement(AST_CALL);
+  }
+
+  if (ast_call) {
+    ast_call->func = func;
+  }
+}
+
+void ast_call_arg(const token_t* token, char type, int lvl) {
+  if (ast_call) {
+    ast_expr_append(&ast_call->ids, exptree_leaf(&ast_arena, token, type, lvl),
+                    false);
+  }
+}
+
+void ast_call_end() { ast_call = NULL; }
+
+void ast_local_begin(const char* name, char type) {
+  ast_stmt = ast_statement(AST_LOCAL);
+  if (ast_stmt) {
+    ast_stmt->name = arena_strdup(&ast_arena, name);
+    ast_stmt->type = type;
+  }
+}
+
+void ast_local_end() { ast_stmt = NULL; }
+
+void ast_assign_begin() { ast_stmt = ast_statement(AST_ASSIGN); }
+
+void ast_assign_id(char* name, char type, int lvl) {
+  if (ast_stmt) {
+    ast_expr_append(&ast_stmt->ids, ast_id(name, type, lvl), false);
+  }
+}
+
+void ast_assign_end(int count) {
+  if (ast_stmt) {
+    ast_stmt->value_count = count;
+  }
+  ast_stmt = NULL;
+}
+
+void ast_return_begin(int ret_count) {
+  ast_stmt = ast_statement(AST_RETURN);
+  if (ast_stmt) {
+    ast_stmt->ret_count = ret_count;
+  }
+}
+
+void ast_return_end() {
+  if (ast_stmt) {
+    int count = 0;
+    for (ast_expr_t* value = ast_stmt->values; value; value = value->next) {
+      count++;
+    }
+    ast_stmt->value_count = count;
+  }
+  ast_stmt = NULL;
+}
+
+void ast_value(exptree_node_t* tree, bool to_number) {
+  if (ast_stmt) {
+    ast_expr_append(&ast_stmt->values, tree, to_number);
+  }
+}
+
+void ast_if_begin(exptree_node_t* cond, char type) {
+  ast_node_t* node = ast_statement(AST_IF);
+  if (node) {
+    node->cond = cond;
+    node->type = type;
+    ast_block_begin(node, &node->body);
+  }
+}
+
+void ast_if_else() {
+  if (ast_parent) {
+    ast_tail = &ast_parent->else_body;
+  }
+}
+
+void ast_if_end() { ast_block_end(); }
+
+void ast_while_begin(exptree_node_t* cond, char type) {
+  ast_node_t* node = ast_statement(AST_WHILE);
+  if (node) {
+    node->cond = cond;
+    node->type = type;
+    ast_block_begin(node, &node->body);
+  }
+}
+
+void ast_while_end() { ast_block_end(); }
+
+ast_func_entry_t* ast_func_find(symtab_func_data_t* func) {
+  ast_node_t node = {.func = func};
+  ast_func_entry_t key = {.node = &node};
+  return bsearch(&key, ast_funcs, ast_func_count, sizeof(ast_func_entry_t),
+                 ast_func_compare);
+}
+
+int ast_func_compare(const void* a, const void* b) {
+  const symtab_func_data_t* x = ((const ast_func_entry_t*)a)->node->func;
+  const symtab_func_data_t* y = ((const ast_func_entry_t*)b)->node->func;
+  return (x > y) - (x < y);
+}
+
+void ast_reach_call(ast_node_t* call) {
+  if (!call || !call->func || call->func->builtin != BUILTIN_NONE) {
+    return;
+  }
+
+  ast_func_entry_t* entry = ast_func_find(call->func);
+  if (entry) {
+    call->def = entry->node;
+  }
+  if (entry && !entry->reachable) {
+    entry->reachable = true;
+    ast_worklist[ast_work_count++] = entry;
+  }
+}
+
+void ast_reach_block(ast_node_t* node) {
+  for (; node; node = node->next) {
+    switch (node->kind) {
+      case AST_CALL:
+        ast_reach_call(node);
+        break;
+      case AST_LOCAL:
+      case AST_ASSIGN:
+        ast_reach_call(node->call);
+        break;
+      case AST_IF:
+        if (exptree_truth(node->cond) != EXPTREE_FALSE) {
+          ast_reach_block(node->body);
+        }
+        if (exptree_truth(node->cond) != EXPTREE_TRUE) {
+          ast_reach_block(node->else_body);
+        }
+        break;
+      case AST_WHILE:
+        if (exptree_truth(node->cond) != EXPTREE_FALSE) {
+          ast_reach_block(node->body);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void ast_prune() {
+  ast_func_count = 0;
+  for (ast_node_t* node = ast_program; node; node = node->next) {
+    ast_func_count += node->kind == AST_FUNCTION && node->func;
+  }
+  if (!ast_func_count) {
+    return;
+  }
+
+  ast_funcs = malloc(sizeof(ast_func_entry_t) * ast_func_count);
+  ast_worklist = malloc(sizeof(ast_func_entry_t*) * ast_func_count);
+  if (!ast_funcs || !ast_worklist) {
+    error_set(EXITSTATUS_INTERNAL_ERROR);
+    goto FREE;
+  }
+
+  int count = 0;
+  for (ast_node_t* node = ast_program; node; node = node->next) {
+    if (node->kind == AST_FUNCTION && node->func) {
+      ast_funcs[count++] = (ast_func_entry_t){.node = node};
+    }
+  }
+  qsort(ast_funcs, ast_func_count, sizeof(ast_func_entry_t), ast_func_compare);
+
+  // top level statements are the roots, function bodies are visited once
+  ast_work_count = 0;
+  ast_reach_block(ast_program);
+  while (ast_work_count > 0) {
+    ast_reach_block(ast_worklist[--ast_work_count]->node->body);
+  }
+
+  for (ast_node_t** node = &ast_program; *node;) {
+    if ((*node)->kind == AST_FUNCTION && (*node)->func &&
+        !ast_func_find((*node)->func)->reachable) {
+      *node = (*node)->next;
+    } else {
+      node = &(*node)->next;
+    }
+  }
+
+FREE:
+  free(ast_funcs);
+  free(ast_worklist);
+  ast_funcs = NULL;
+  ast_worklist = NULL;
+}
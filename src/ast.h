@@ -0,0 +1,285 @@
+/**
+ * @file
+ * @brief Abstract syntax tree API
+ * @author Tomas Martykan (xmarty07)
+ * @author Filip Stolfa (xstolf00)
+ * @author Patrik Korytar (xkoryt04)
+ *
+ * FIT VUT IFJ Project:
+ * Compiler of IFJ21 Language
+ *
+ * @section DESCRIPTION
+ *  Tree of the whole program built by the parser. Code is generated
+ *  from it by a separate walk after the program is parsed.
+ *
+ * @section IMPLEMENTATION
+ *  Statements of a block are a linked list, nested blocks are lists
+ *  of their statements. Nodes and expression trees are allocated from
+ *  one arena freed with the program. Parser builds the tree through
+ *  functions called in the order of the source, statement being built
+ *  is kept in global variables.
+ */
+
+#ifndef __AST_H__
+#define __AST_H__
+
+#include <stdbool.h>
+
+#include "arena.h"
+#include "exptree.h"
+#include "scanner.h"
+#include "symtable.h"
+
+// DATA STRUCTURES
+
+/**
+ * @brief Kind of statement.
+ */
+typedef enum {
+  AST_FUNCTION,  ///< Function definition
+  AST_CALL,      ///< Function call
+  AST_LOCAL,     ///< Declaration of local variable
+  AST_ASSIGN,    ///< Assignment to variables
+  AST_IF,        ///< If-then-else
+  AST_WHILE,     ///< While loop
+  AST_RETURN,    ///< Return from function
+} ast_kind_t;
+
+/**
+ * @struct ast_expr_t
+ * @brief Item of list of expressions.
+ * @var ast_expr_t::tree
+ *  Expression tree, leaf for variables and arguments.
+ * @var ast_expr_t::to_number
+ *  Is integer value converted to number before it is stored?
+ * @var ast_expr_t::next
+ *  Next item of the list.
+ */
+typedef struct ast_expr {
+  exptree_node_t* tree;
+  bool to_number;
+  struct ast_expr* next;
+} ast_expr_t;
+
+/**
+ * @struct ast_node_t
+ * @brief Statement of the program.
+ * @var ast_node_t::kind
+ *  Kind of the statement.
+ * @var ast_node_t::next
+ *  Next statement of the same block.
+ * @var ast_node_t::parent
+ *  Statement containing the block, NULL at the top level.
+ * @var ast_node_t::name
+ *  Name of the function (AST_FUNCTION) or the variable (AST_LOCAL).
+ * @var ast_node_t::type
+ *  Type of the variable (AST_LOCAL) or the condition (AST_IF, AST_WHILE).
+ * @var ast_node_t::func
+ *  Defined (AST_FUNCTION) or called (AST_CALL) function.
+ * @var ast_node_t::cond
+ *  Condition (AST_IF, AST_WHILE).
+ * @var ast_node_t::ids
+ *  Parameters (AST_FUNCTION), assigned variables (AST_ASSIGN) or
+ *  arguments (AST_CALL).
+ * @var ast_node_t::values
+ *  Assigned (AST_LOCAL, AST_ASSIGN) or returned (AST_RETURN) expressions.
+ * @var ast_node_t::call
+ *  Call whose results are assigned (AST_LOCAL, AST_ASSIGN).
+ * @var ast_node_t::def
+ *  Definition of called user function (AST_CALL), set by ast_prune.
+ * @var ast_node_t::value_count
+ *  Number of assigned (AST_ASSIGN) or returned (AST_RETURN) values.
+ * @var ast_node_t::ret_count
+ *  Number of declared return values (AST_FUNCTION, AST_RETURN).
+ * @var ast_node_t::body
+ *  Body (AST_FUNCTION, AST_WHILE) or then branch (AST_IF).
+ * @var ast_node_t::else_body
+ *  Else branch (AST_IF).
+ * @var ast_node_t::index
+ *  Position of the statement in order of the source.
+ * @var ast_node_t::last
+ *  Position of the last statement nested in its blocks, index if none.
+ */
+typedef struct ast_node {
+  ast_kind_t kind;
+  struct ast_node* next;
+  struct ast_node* parent;
+  char* name;
+  char type;
+  symtab_func_data_t* func;
+  exptree_node_t* cond;
+  ast_expr_t* ids;
+  ast_expr_t* values;
+  struct ast_node* call;
+  struct ast_node* def;
+  int value_count;
+  int ret_count;
+  struct ast_node* body;
+  struct ast_node* else_body;
+  int index;
+  int last;
+} ast_node_t;
+
+// GLOBAL VARIABLES
+
+/// Arena of nodes and expression trees of the program.
+extern arena_t ast_arena;
+
+/// First statement of the program, NULL if empty.
+extern ast_node_t* ast_program;
+
+// PUBLIC FUNCTION FORWARD DECLARATIONS
+
+/**
+ * Initializes empty program.
+ */
+void ast_init();
+
+/**
+ * Frees the whole program.
+ */
+void ast_free();
+
+/**
+ * Starts function definition, parameters follow.
+ * Sets global error flag on failure.
+ * @param name Name of the function.
+ */
+void ast_function_begin(const char* name);
+
+/**
+ * Adds parameter of defined function.
+ * Sets global error flag on failure.
+ * @param name Name of the parameter.
+ * @param type Type of the parameter.
+ */
+void ast_function_param(char* name, char type);
+
+/**
+ * Starts body of defined function.
+ * @param func Defined function.
+ */
+void ast_function_body(symtab_func_data_t* func);
+
+/**
+ * Ends function definition.
+ */
+void ast_function_end();
+
+/**
+ * Starts function call, assigned by the declaration or assignment
+ * being built if there is one. Arguments follow.
+ * Sets global error flag on failure.
+ * @param func Called function.
+ */
+void ast_call_begin(symtab_func_data_t* func);
+
+/**
+ * Adds argument of function call.
+ * Sets global error flag on failure.
+ * @param token Literal or variable token.
+ * @param type Static type of the argument.
+ * @param lvl Level of scope of the variable.
+ */
+void ast_call_arg(const token_t* token, char type, int lvl);
+
+/**
+ * Ends function call.
+ */
+void ast_call_end();
+
+/**
+ * Starts declaration of local variable, initial value can follow.
+ * Sets global error flag on failure.
+ * @param name Name of the variable.
+ * @param type Type of the variable.
+ */
+void ast_local_begin(const char* name, char type);
+
+/**
+ * Ends declaration of local variable.
+ */
+void ast_local_end();
+
+/**
+ * Starts assignment, assigned variables and values follow.
+ * Sets global error flag on failure.
+ */
+void ast_assign_begin();
+
+/**
+ * Adds assigned variable.
+ * Sets global error flag on failure.
+ * @param name Name of the variable.
+ * @param type Type of the variable.
+ * @param lvl Level of scope of the variable.
+ */
+void ast_assign_id(char* name, char type, int lvl);
+
+/**
+ * Ends assignment.
+ * @param count Number of assigned values.
+ */
+void ast_assign_end(int count);
+
+/**
+ * Starts return statement, returned values follow.
+ * Sets global error flag on failure.
+ * @param ret_count Number of declared return values of the function.
+ */
+void ast_return_begin(int ret_count);
+
+/**
+ * Ends return statement.
+ */
+void ast_return_end();
+
+/**
+ * Adds value of declaration, assignment or return being built.
+ * Sets global error flag on failure.
+ * @param tree Expression of the value.
+ * @param to_number Is integer converted to number before it is stored?
+ */
+void ast_value(exptree_node_t* tree, bool to_number);
+
+/**
+ * Starts if statement, then branch follows.
+ * Sets global error flag on failure.
+ * @param cond Condition.
+ * @param type Static type of the condition.
+ */
+void ast_if_begin(exptree_node_t* cond, char type);
+
+/**
+ * Starts else branch of if statement.
+ */
+void ast_if_else();
+
+/**
+ * Ends if statement.
+ */
+void ast_if_end();
+
+/**
+ * Starts while loop, body follows.
+ * Sets global error flag on failure.
+ * @param cond Condition.
+ * @param type Static type of the condition.
+ */
+void ast_while_begin(exptree_node_t* cond, char type);
+
+/**
+ * Ends while loop.
+ */
+void ast_while_end();
+
+/**
+ * Removes definitions of functions which cannot be called from
+ * the top level, directly or through other functions. Calls in
+ * branches which are never taken are not counted. Other calls of
+ * user functions are linked to their definitions.
+ * Sets global error flag on allocation failure.
+ */
+void ast_prune();
+
+#endif  // __AST_H__
@@ -11,94 +11,462 @@
 
 #include "codegen.h"
 
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "errors.h"
+#include "optimizer.h"
+#include "other.h"
 #include "scanner.h"
 #include "scope.h"
 
-// Variables to keep track of temp vars
-int tmpmax = 0;
+// State of code generation is private to each thread, every thread
+// generates code of one function at a time
+
+// Number of $tmp variables used by the current function, the optimizer
+// allocates the variables defined in the end
+THREAD_LOCAL int tmpmax = 0;
+
+// Values of expressions available in the current basic block
+THREAD_LOCAL arena_t cse_arena;
+THREAD_LOCAL codegen_cse_value_t cse_values[CODEGEN_CSE_MAX_VALUES];
+THREAD_LOCAL int cse_count = 0;
+// Number of $cse variables defined in the current function
+THREAD_LOCAL int cse_max = 0;
+// Occurrences of subtrees in the expression being generated,
+// slots of previous expressions have older generation
+THREAD_LOCAL codegen_cse_slot_t* cse_slots = NULL;
+THREAD_LOCAL int cse_size = 0;
+THREAD_LOCAL int cse_used = 0;
+THREAD_LOCAL int cse_gen = 0;
+// Variables assigned by the current assignment, separated by newlines
+THREAD_LOCAL dynstr_t cse_assigned;
+
+// Values of loop invariant expressions computed before the loops being
+// generated, inner loops add theirs after the values of outer ones.
+// Variables of the copies are replaced by their unique names
+THREAD_LOCAL arena_t licm_arena;
+THREAD_LOCAL exptree_node_t* licm_values[CODEGEN_LICM_MAX_VALUES];
+THREAD_LOCAL int licm_count = 0;
+// Number of $licm variables defined in the current function
+THREAD_LOCAL int licm_max = 0;
+// Loop whose invariant expressions are being searched
+THREAD_LOCAL const ast_node_t* licm_loop;
+// No operation which can fail was evaluated by the condition yet
+THREAD_LOCAL bool licm_clean;
+// Variables which cannot be nil once the condition is evaluated
+THREAD_LOCAL const char* licm_proven[CODEGEN_LICM_MAX_PROVEN];
+THREAD_LOCAL int licm_proven_count;
+// Stores of all statements sorted by name and position, collected before
+// workers start, so variables assigned in a loop are found by search
+codegen_store_t* licm_stores = NULL;
+int licm_store_count = 0;
+int licm_store_max = 0;
 
 // Variables to generate unique IDs for labels, while supporting nesting
-int idmax = -1;
-int iddepth = -1;
-int idstack[100];
+#define IDSTACK_INIT_SIZE 16
+THREAD_LOCAL int idmax = -1;
+THREAD_LOCAL int iddepth = -1;
+THREAD_LOCAL int idstack_size = 0;
+THREAD_LOCAL int* idstack = NULL;
+
+// Function whose call is being generated
+THREAD_LOCAL symtab_func_data_t* last_function;
+
+THREAD_LOCAL dynstr_t main_buffer;
+THREAD_LOCAL dynstr_t function_buffer;
+// Definitions of local variables of the function being generated
+THREAD_LOCAL dynstr_t frame_buffer;
+THREAD_LOCAL dynstr_t expression_assign_buffer;
+// Definitions of builtin functions, appended to the end of output,
+// only the main thread defines them when it joins the code of functions
+dynstr_t builtin_buffer;
+
+THREAD_LOCAL dynstr_t* active_buffer;
+
+// Labels of the function are numbered in its own namespace,
+// 0 for code outside of functions
+THREAD_LOCAL int label_namespace = 0;
+// Builtin functions called by the generated code, in order of first call
+THREAD_LOCAL symtab_builtin_t builtin_calls[CODEGEN_BUILTIN_COUNT];
+THREAD_LOCAL int builtin_call_count = 0;
+
+// Pool of workers generating code of functions
+pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+codegen_chunk_t* pool_chunks;
+int pool_count;
+int pool_next;
+
+// First operand of concatenation chain, kept until the second one
+THREAD_LOCAL const exptree_node_t* concat_first;
+// Was the first CONCAT of the chain generated?
+THREAD_LOCAL bool concat_started;
+
+// Code of branches never taken is generated to discard buffer and dropped
+THREAD_LOCAL dynstr_t discard_buffer;
+THREAD_LOCAL int discard_depth = 0;
+THREAD_LOCAL dynstr_t* discard_saved_buffer;
+THREAD_LOCAL int discard_saved_tmpmax;
+
+bool codegen_inlining = false;
+int codegen_inlined = 0;
+// Definition of function whose body is inlined, NULL if none
+THREAD_LOCAL const ast_node_t* inline_func = NULL;
+// Label at the end of the inlined body, returns jump to it
+THREAD_LOCAL int inline_label;
+THREAD_LOCAL bool inline_returned;
+// Assignment of results of the call waits until the body is generated
+THREAD_LOCAL dynstr_t inline_assign_buffer;
+THREAD_LOCAL dynstr_t inline_assigned;
+THREAD_LOCAL int inline_assign_count = 0;
+// Number of calls inlined in the current chunk
+THREAD_LOCAL int inline_count = 0;
+
+// Function being generated if it calls itself in tail position,
+// such calls jump back to its body, NULL otherwise
+THREAD_LOCAL const ast_node_t* tail_func = NULL;
+
+// PRIVATE FUNCTION FORWARD DECLARATIONS
+
+/** Forget all values, at the beginning of a basic block */
+void codegen_cse_clear();
+
+/** Forget values computed from the variable */
+void codegen_cse_invalidate(const char* id);
+
+/** Does computation read the variable? */
+bool codegen_cse_uses(const exptree_node_t* node, const char* id);
+
+/** Number of $cse variable holding the value, -1 if none */
+int codegen_cse_find(const exptree_node_t* node);
+
+/** Add to occurrences of the subtree in the expression, returns the sum */
+int codegen_cse_occurs(const exptree_node_t* node, int add);
+
+/** Double size of the table of occurrences */
+bool codegen_cse_grow();
+
+/** Is subtree a computation worth remembering? */
+bool codegen_cse_candidate(const exptree_node_t* node);
+
+/** Push remembered value of subtree, false if there is none */
+bool codegen_cse_push(const exptree_node_t* node);
+
+/** Save value of subtree on the stack if it is computed again later */
+void codegen_cse_save(const exptree_node_t* node);
+
+/** Count occurrences of subtrees, repeated subtrees are not entered */
+void codegen_cse_count(const exptree_node_t* node);
+
+/** Count occurrence of subtree, was it seen before? */
+bool codegen_cse_seen(const exptree_node_t* node);
 
-char* last_function_name;
+/**
+ * Compute invariant expressions of while loop before it, returns
+ * number of values of outer loops to be restored after it
+ */
+int codegen_licm_begin(const ast_node_t* loop);
+
+/** Forget values hoisted out of the loop */
+void codegen_licm_end(int count);
+
+/**
+ * Hoist maximal invariant subtrees of loop condition evaluated before
+ * any operation which can fail, in order of evaluation
+ */
+void codegen_licm_condition(const exptree_node_t* node, bool root);
+
+/** Hoist maximal invariant subtrees of expression which cannot fail */
+void codegen_licm_body(const exptree_node_t* node);
+
+/**
+ * Compute value of subtree into a new $licm variable, false if it was
+ * not hoisted. Variables of the subtree are depth scopes deeper
+ */
+bool codegen_licm_hoist(const exptree_node_t* node, int depth);
+
+/** Number of $licm variable holding the value, -1 if none */
+int codegen_licm_find(const exptree_node_t* node);
+
+/** Push hoisted value of subtree, false if there is none */
+bool codegen_licm_push(const exptree_node_t* node);
+
+/** Does subtree compute hoisted value? */
+bool codegen_licm_equal(const exptree_node_t* node,
+                        const exptree_node_t* value);
+
+/** Move variables of hoisted copy depth scopes up */
+void codegen_licm_lift(exptree_node_t* node, int depth);
+
+/** Replace variables of hoisted copy by their unique names */
+void codegen_licm_resolve(exptree_node_t* node);
+
+/**
+ * Is no variable of subtree assigned in the loop? Variables are depth
+ * scopes deeper than the loop
+ */
+bool codegen_licm_invariant(const exptree_node_t* node, int depth);
+
+/** Is variable declared or assigned in body of the loop? */
+bool codegen_licm_assigned(const ast_node_t* loop, const char* id);
+
+/**
+ * Collect variables declared or assigned by statements of block into
+ * licm_stores. Sets global error flag on failure.
+ */
+void codegen_licm_collect(const ast_node_t* node);
+
+/** Append store to licm_stores, sets global error flag on failure */
+void codegen_licm_store(const char* name, int index);
+
+/** Compare stores by name and position, for qsort */
+int codegen_licm_store_compare(const void* a, const void* b);
+
+/** Free stores collected by codegen_licm_collect */
+void codegen_licm_stores_free();
+
+/** Can operation fail even if its operands are not nil? */
+bool codegen_licm_may_fail(const exptree_node_t* node);
+
+/** Can subtree be computed before the loop without failing? */
+bool codegen_licm_safe(const exptree_node_t* node);
+
+/** Remember variables which operations of subtree fail on if nil */
+void codegen_licm_prove(const exptree_node_t* node, bool deep);
+
+/** Is variable known not to be nil? */
+bool codegen_licm_proven(const char* id);
+
+/** Is subtree an operand of instruction, leaf or hoisted value? */
+bool codegen_operand(const exptree_node_t* node);
+
+/**
+ * Define variables of the function in its header, locals and then temps,
+ * count of temps allocated by the optimizer or -1 to define all of them
+ */
+void codegen_define_frame(int count);
+
+/** Append symbol of literal or variable without newline */
+void codegen_symbol(token_t* token, int lvl);
+
+/** Initialize state private to the calling thread */
+void codegen_thread_init();
+
+/** Free state private to the calling thread */
+void codegen_thread_free();
+
+/** Start code in a new namespace of labels, counters start again */
+void codegen_chunk_begin(int index);
+
+/** Generate code of function definition into its chunk */
+void codegen_chunk_generate(codegen_chunk_t* chunk);
+
+/** Generate chunks taken from the pool until none is left */
+void codegen_worker();
+
+/** Start routine of spawned worker thread */
+void* codegen_worker_thread(void* arg);
+
+/** Remember call of builtin function, it is defined when code is joined */
+void codegen_builtin_call(symtab_builtin_t builtin);
+
+/** Define builtin functions which were not defined yet, in order */
+void codegen_builtin_define(const symtab_builtin_t* builtins, int count);
+
+/** Append symbol of expression tree leaf and newline */
+void codegen_literal(const exptree_node_t* node);
+
+/** Generate statements of block in order */
+void codegen_block(const ast_node_t* node);
+
+/** Generate one statement, nested blocks included */
+void codegen_statement(const ast_node_t* node);
+
+/** Generate function definition */
+void codegen_function_definition(const ast_node_t* node);
+
+/** Generate function call, results are left on the stack */
+void codegen_call(const ast_node_t* node);
+
+/** Push assigned or returned values, from a call or expressions */
+void codegen_values(const ast_node_t* node);
+
+/** Size of block for inlining, more than the maximum if it calls a user
+ * function */
+int codegen_inline_cost(const ast_node_t* node);
+
+/** Number of operands and operations of expression tree */
+int codegen_tree_cost(const exptree_node_t* node);
+
+/** Generate body of called function in place of the call */
+void codegen_inline(const ast_node_t* call);
+
+/** Define parameters of inlined function, assigned from the stack */
+void codegen_inline_params(const ast_expr_t* param);
+
+/** Swap pending assignment of the caller with the one of inlined body */
+void codegen_inline_swap();
+
+/**
+ * Is statement a call of tail_func whose results are returned right
+ * away? Statement is the call, or assignment of results which are
+ * returned by the next statement
+ */
+bool codegen_tail_call_is(const ast_node_t* node);
+
+/** Does function return right after the statement, with no values? */
+bool codegen_tail_position(const ast_node_t* node);
+
+/** Does block contain a tail call of tail_func? */
+bool codegen_tail_calls(const ast_node_t* node);
+
+/** Assign arguments to parameters and jump to the body of tail_func */
+void codegen_tail_call(const ast_node_t* call);
+
+/** Assign parameters of tail_func from the stack */
+void codegen_tail_params(const ast_expr_t* param);
+
+/** Count repeated values before generating code of the expression */
+void codegen_expression_begin(const exptree_node_t* node);
+
+/** Generate code of subtree, reusing and saving repeated values */
+void codegen_expression_tree(const exptree_node_t* node);
+
+/** Are all operands of concatenation chain literals or variables? */
+bool codegen_concat_flat(const exptree_node_t* node);
+
+/** Concatenate operands of chain into LF@$tmp1 */
+void codegen_concat_operand(const exptree_node_t* node);
 
-dynstr_t main_buffer;
-dynstr_t function_buffer;
-dynstr_t expression_assign_buffer;
+/**
+ * Generate jump to label with given ID when condition has given value,
+ * relational operations compare and jump at once
+ */
+void codegen_condition_jump(const exptree_node_t* node, char type, bool value,
+                            char* label, int id);
 
-dynstr_t* active_buffer;
+/** Append label with given ID and newline */
+void codegen_label_name(char* label, int id);
 
 void codegen_init() {
+  codegen_thread_init();
+  dynstr_init(&builtin_buffer);
+
+  printf(".IFJcode21\n");
+}
+
+void codegen_free() {
+  printf("%s\n", main_buffer.str);
+  printf("%s", builtin_buffer.str);
+  codegen_thread_free();
+  dynstr_free_buffer(&builtin_buffer);
+}
+
+void codegen_thread_init() {
   dynstr_init(&main_buffer);
   dynstr_init(&function_buffer);
+  dynstr_init(&frame_buffer);
   dynstr_init(&expression_assign_buffer);
+  dynstr_init(&discard_buffer);
+  dynstr_init(&cse_assigned);
+  dynstr_init(&inline_assign_buffer);
+  dynstr_init(&inline_assigned);
+  arena_init(&cse_arena);
+  arena_init(&licm_arena);
 
   active_buffer = &main_buffer;
-
-  printf(".IFJcode21\n");
 }
 
-void codegen_free() {
-  printf("%s\n", main_buffer.str);
+void codegen_thread_free() {
   dynstr_free_buffer(&main_buffer);
   dynstr_free_buffer(&function_buffer);
+  dynstr_free_buffer(&frame_buffer);
   dynstr_free_buffer(&expression_assign_buffer);
+  dynstr_free_buffer(&discard_buffer);
+  dynstr_free_buffer(&cse_assigned);
+  dynstr_free_buffer(&inline_assign_buffer);
+  dynstr_free_buffer(&inline_assigned);
+  arena_free(&cse_arena);
+  arena_free(&licm_arena);
+  free(cse_slots);
+  cse_slots = NULL;
+  cse_size = 0;
+  free(idstack);
+  idstack = NULL;
+  idstack_size = 0;
+}
+
+void codegen_label_push() {
+  if (iddepth + 1 >= idstack_size) {
+    int new_size = idstack_size ? idstack_size * 2 : IDSTACK_INIT_SIZE;
+    int* tmp = realloc(idstack, sizeof(int) * new_size);
+    if (!tmp) {
+      error_set(EXITSTATUS_INTERNAL_ERROR);
+      return;
+    }
+    idstack = tmp;
+    idstack_size = new_size;
+  }
+
+  iddepth++;
+  idmax++;
+  idstack[iddepth] = idmax;
 }
 
 void codegen_get_temp_vars(int count) {
-  for (int i = tmpmax; i < count; i++) {
-    dynstr_append_str(active_buffer, "DEFVAR LF@$tmp");
-    dynstr_append_int(active_buffer, i + 1);
-    dynstr_append_str(active_buffer, "\n");
-    tmpmax++;
+  if (count > tmpmax) {
+    tmpmax = count;
   }
 }
 
-void codegen_function_call_begin(char* name) {
-  last_function_name = name;
-  if (strcmp(last_function_name, "write") == 0) return;
-  if (strcmp(last_function_name, "readi") == 0) return;
-  if (strcmp(last_function_name, "readn") == 0) return;
-  if (strcmp(last_function_name, "reads") == 0) return;
-  if (strcmp(last_function_name, "tointeger") == 0) return;
-  if (strcmp(last_function_name, "substr") == 0) return;
-  if (strcmp(last_function_name, "ord") == 0) return;
-  if (strcmp(last_function_name, "chr") == 0) return;
+void codegen_define_frame(int count) {
+  dynstr_append_str(&main_buffer, frame_buffer.str);
+  dynstr_clear(&frame_buffer);
+
+  // variables of temps which were not allocated keep their names
+  int counts[] = {count < 0 ? tmpmax : count, count < 0 ? cse_max : 0,
+                  count < 0 ? licm_max : 0};
+  char* names[] = {"DEFVAR LF@$tmp", "DEFVAR LF@$cse", "DEFVAR LF@$licm"};
+  for (int i = 0; i < 3; i++) {
+    for (int var = 1; var <= counts[i]; var++) {
+      dynstr_append_str(&main_buffer, names[i]);
+      dynstr_append_int(&main_buffer, var);
+      dynstr_append_str(&main_buffer, "\n");
+    }
+  }
+}
+
+void codegen_function_call_begin(symtab_func_data_t* func) {
+  last_function = func;
+  if (func->builtin != BUILTIN_NONE) return;
 
   dynstr_append_str(active_buffer, "CREATEFRAME\n");
 }
 
-void codegen_literal(token_t* token, int lvl) {
+void codegen_symbol(token_t* token, int lvl) {
   switch (token->type) {
     case TT_INTEGER:
       dynstr_append_str(active_buffer, "int@");
       dynstr_append_int(active_buffer, token->attr.int_val);
-      dynstr_append_str(active_buffer, "\n");
       break;
     case TT_NUMBER:
       dynstr_append_str(active_buffer, "float@");
       dynstr_append_double(active_buffer, token->attr.num_val);
-      dynstr_append_str(active_buffer, "\n");
       break;
     case TT_STRING:
       dynstr_append_str(active_buffer, "string@");
       dynstr_append_str(active_buffer, token->attr.str);
-      dynstr_append_str(active_buffer, "\n");
       break;
     case TT_K_NIL:
-      dynstr_append_str(active_buffer, "nil@nil\n");
+      dynstr_append_str(active_buffer, "nil@nil");
       break;
     case TT_ID:
       dynstr_append_str(active_buffer, "LF@");
       dynstr_append_str(active_buffer,
                         scope_get_correct_id(token->attr.str, lvl));
-      dynstr_append_str(active_buffer, "\n");
       break;
     default:
       // Error
@@ -108,96 +476,101 @@ void codegen_literal(token_t* token, int lvl) {
   }
 }
 
-int writeskip = 0;
-
-void codegen_function_call_argument(token_t* token, int argpos, int lvl) {
-  if (last_function_name == NULL) {
-    return;
-  }
-  if (strcmp(last_function_name, "write") == 0) {
-    dynstr_append_str(active_buffer, "JUMPIFEQ $write_nil");
-    dynstr_append_int(active_buffer, writeskip);
-    dynstr_append_str(active_buffer, " nil@nil ");
-    codegen_literal(token, lvl);
-
-    dynstr_append_str(active_buffer, "WRITE ");
-    codegen_literal(token, lvl);
-
-    dynstr_append_str(active_buffer, "JUMP $write_end");
-    dynstr_append_int(active_buffer, writeskip);
-    dynstr_append_str(active_buffer, "\n");
-
-    dynstr_append_str(active_buffer, "LABEL $write_nil");
-    dynstr_append_int(active_buffer, writeskip);
-    dynstr_append_str(active_buffer, "\n");
-    dynstr_append_str(active_buffer, "WRITE string@nil\n");
-    dynstr_append_str(active_buffer, "LABEL $write_end");
-    dynstr_append_int(active_buffer, writeskip);
-    dynstr_append_str(active_buffer, "\n");
-
-    writeskip++;
-    return;
-  }
-  if (strcmp(last_function_name, "readi") == 0) return;
-  if (strcmp(last_function_name, "readn") == 0) return;
-  if (strcmp(last_function_name, "reads") == 0) return;
-  if (strcmp(last_function_name, "tointeger") == 0) {
-    if (argpos == 0) {
-      codegen_tointeger_define();
+void codegen_literal(const exptree_node_t* node) {
+  codegen_expression_symbol(node);
+  dynstr_append_str(active_buffer, "\n");
+}
 
-      dynstr_append_str(active_buffer, "CREATEFRAME\n");
-      dynstr_append_str(active_buffer, "DEFVAR TF@n\n");
-      dynstr_append_str(active_buffer, "MOVE TF@n ");
-      codegen_literal(token, lvl);
-    }
-    return;
-  }
-  if (strcmp(last_function_name, "substr") == 0) {
-    if (argpos == 0) {
-      codegen_substr_define();
+THREAD_LOCAL int writeskip = 0;
 
-      dynstr_append_str(active_buffer, "CREATEFRAME\n");
-      dynstr_append_str(active_buffer, "DEFVAR TF@str\n");
-      dynstr_append_str(active_buffer, "MOVE TF@str ");
-      codegen_literal(token, lvl);
-    }
-    if (argpos == 1) {
-      dynstr_append_str(active_buffer, "DEFVAR TF@i\n");
-      dynstr_append_str(active_buffer, "MOVE TF@i ");
-      codegen_literal(token, lvl);
-    }
-    if (argpos == 2) {
-      dynstr_append_str(active_buffer, "DEFVAR TF@j\n");
-      dynstr_append_str(active_buffer, "MOVE TF@j ");
-      codegen_literal(token, lvl);
-    }
+void codegen_function_call_argument(const exptree_node_t* arg, int argpos) {
+  if (last_function == NULL) {
     return;
   }
-  if (strcmp(last_function_name, "ord") == 0) {
-    if (argpos == 0) {
-      codegen_ord_define();
+  switch (last_function->builtin) {
+    case BUILTIN_WRITE:
+      dynstr_append_str(active_buffer, "JUMPIFEQ ");
+      codegen_label_name("$write_nil", writeskip);
+      dynstr_append_str(active_buffer, " nil@nil ");
+      codegen_literal(arg);
+
+      dynstr_append_str(active_buffer, "WRITE ");
+      codegen_literal(arg);
+
+      dynstr_append_str(active_buffer, "JUMP ");
+      codegen_label_name("$write_end", writeskip);
+      dynstr_append_str(active_buffer, "\n");
 
-      dynstr_append_str(active_buffer, "CREATEFRAME\n");
-      dynstr_append_str(active_buffer, "DEFVAR TF@str\n");
-      dynstr_append_str(active_buffer, "MOVE TF@str ");
-      codegen_literal(token, lvl);
-    } else {
-      dynstr_append_str(active_buffer, "DEFVAR TF@i\n");
-      dynstr_append_str(active_buffer, "MOVE TF@i ");
-      codegen_literal(token, lvl);
-    }
-    return;
-  }
-  if (strcmp(last_function_name, "chr") == 0) {
-    if (argpos == 0) {
-      codegen_chr_define();
+      dynstr_append_str(active_buffer, "LABEL ");
+      codegen_label_name("$write_nil", writeskip);
+      dynstr_append_str(active_buffer, "\n");
+      dynstr_append_str(active_buffer, "WRITE string@nil\n");
+      dynstr_append_str(active_buffer, "LABEL ");
+      codegen_label_name("$write_end", writeskip);
+      dynstr_append_str(active_buffer, "\n");
 
-      dynstr_append_str(active_buffer, "CREATEFRAME\n");
-      dynstr_append_str(active_buffer, "DEFVAR TF@i\n");
-      dynstr_append_str(active_buffer, "MOVE TF@i ");
-      codegen_literal(token, lvl);
-    }
-    return;
+      writeskip++;
+      return;
+    case BUILTIN_READS:
+    case BUILTIN_READI:
+    case BUILTIN_READN:
+      return;
+    case BUILTIN_TOINTEGER:
+      if (argpos == 0) {
+        codegen_builtin_call(BUILTIN_TOINTEGER);
+
+        dynstr_append_str(active_buffer, "CREATEFRAME\n");
+        dynstr_append_str(active_buffer, "DEFVAR TF@n\n");
+        dynstr_append_str(active_buffer, "MOVE TF@n ");
+        codegen_literal(arg);
+      }
+      return;
+    case BUILTIN_SUBSTR:
+      if (argpos == 0) {
+        codegen_builtin_call(BUILTIN_SUBSTR);
+
+        dynstr_append_str(active_buffer, "CREATEFRAME\n");
+        dynstr_append_str(active_buffer, "DEFVAR TF@str\n");
+        dynstr_append_str(active_buffer, "MOVE TF@str ");
+        codegen_literal(arg);
+      }
+      if (argpos == 1) {
+        dynstr_append_str(active_buffer, "DEFVAR TF@i\n");
+        dynstr_append_str(active_buffer, "MOVE TF@i ");
+        codegen_literal(arg);
+      }
+      if (argpos == 2) {
+        dynstr_append_str(active_buffer, "DEFVAR TF@j\n");
+        dynstr_append_str(active_buffer, "MOVE TF@j ");
+        codegen_literal(arg);
+      }
+      return;
+    case BUILTIN_ORD:
+      if (argpos == 0) {
+        codegen_builtin_call(BUILTIN_ORD);
+
+        dynstr_append_str(active_buffer, "CREATEFRAME\n");
+        dynstr_append_str(active_buffer, "DEFVAR TF@str\n");
+        dynstr_append_str(active_buffer, "MOVE TF@str ");
+        codegen_literal(arg);
+      } else {
+        dynstr_append_str(active_buffer, "DEFVAR TF@i\n");
+        dynstr_append_str(active_buffer, "MOVE TF@i ");
+        codegen_literal(arg);
+      }
+      return;
+    case BUILTIN_CHR:
+      if (argpos == 0) {
+        codegen_builtin_call(BUILTIN_CHR);
+
+        dynstr_append_str(active_buffer, "CREATEFRAME\n");
+        dynstr_append_str(active_buffer, "DEFVAR TF@i\n");
+        dynstr_append_str(active_buffer, "MOVE TF@i ");
+        codegen_literal(arg);
+      }
+      return;
+    case BUILTIN_NONE:
+      break;
   }
 
   dynstr_append_str(active_buffer, "DEFVAR TF@$arg");
@@ -206,54 +579,51 @@ void codegen_function_call_argument(token_t* token, int argpos, int lvl) {
   dynstr_append_str(active_buffer, "MOVE TF@$arg");
   dynstr_append_int(active_buffer, argpos);
   dynstr_append_str(active_buffer, " ");
-  codegen_literal(token, lvl);
+  codegen_literal(arg);
 }
 
-void codegen_function_call_do(char* name) {
-  last_function_name = NULL;
-  if (strcmp(name, "write") == 0) {
-    return;
-  }
-  if (strcmp(name, "reads") == 0) {
-    codegen_get_temp_vars(1);
-    dynstr_append_str(active_buffer, "READ LF@$tmp1 string\n");
-    dynstr_append_str(active_buffer, "PUSHS LF@$tmp1\n");
-    return;
-  }
-  if (strcmp(name, "readn") == 0) {
-    codegen_get_temp_vars(1);
-    dynstr_append_str(active_buffer, "READ LF@$tmp1 float\n");
-    dynstr_append_str(active_buffer, "PUSHS LF@$tmp1\n");
-    return;
-  }
-  if (strcmp(name, "readi") == 0) {
-    codegen_get_temp_vars(1);
-    dynstr_append_str(active_buffer, "READ LF@$tmp1 int\n");
-    dynstr_append_str(active_buffer, "PUSHS LF@$tmp1\n");
-    return;
-  }
-  if (strcmp(name, "tointeger") == 0) {
-    dynstr_append_str(active_buffer, "CALL $tointeger\n");
-    return;
-  }
-  if (strcmp(name, "substr") == 0) {
-    dynstr_append_str(active_buffer, "CALL $substr\n");
-    return;
-  }
-  if (strcmp(name, "ord") == 0) {
-    dynstr_append_str(active_buffer, "CALL $ord\n");
-    return;
-  };
-  if (strcmp(name, "chr") == 0) {
-    dynstr_append_str(active_buffer, "CALL $chr\n");
-    return;
+void codegen_function_call_do(symtab_func_data_t* func) {
+  last_function = NULL;
+  switch (func->builtin) {
+    case BUILTIN_WRITE:
+      return;
+    case BUILTIN_READS:
+      codegen_get_temp_vars(1);
+      dynstr_append_str(active_buffer, "READ LF@$tmp1 string\n");
+      dynstr_append_str(active_buffer, "PUSHS LF@$tmp1\n");
+      return;
+    case BUILTIN_READN:
+      codegen_get_temp_vars(1);
+      dynstr_append_str(active_buffer, "READ LF@$tmp1 float\n");
+      dynstr_append_str(active_buffer, "PUSHS LF@$tmp1\n");
+      return;
+    case BUILTIN_READI:
+      codegen_get_temp_vars(1);
+      dynstr_append_str(active_buffer, "READ LF@$tmp1 int\n");
+      dynstr_append_str(active_buffer, "PUSHS LF@$tmp1\n");
+      return;
+    case BUILTIN_TOINTEGER:
+      dynstr_append_str(active_buffer, "CALL $tointeger\n");
+      return;
+    case BUILTIN_SUBSTR:
+      dynstr_append_str(active_buffer, "CALL $substr\n");
+      return;
+    case BUILTIN_ORD:
+      dynstr_append_str(active_buffer, "CALL $ord\n");
+      return;
+    case BUILTIN_CHR:
+      dynstr_append_str(active_buffer, "CALL $chr\n");
+      return;
+    case BUILTIN_NONE:
+      break;
   }
   dynstr_append_str(active_buffer, "CALL $fn_");
-  dynstr_append_str(active_buffer, name);
+  dynstr_append_str(active_buffer, func->func_name);
   dynstr_append_str(active_buffer, "\n");
 }
 
 void codegen_function_definition_begin(char* name) {
+  codegen_cse_clear();
   dynstr_append_str(active_buffer, "JUMP $endfn_");
   dynstr_append_str(active_buffer, name);
   dynstr_append_str(active_buffer, "\n");
@@ -286,12 +656,16 @@ void codegen_function_definition_end(char* name, int ret_count) {
   dynstr_append_str(active_buffer, name);
   dynstr_append_str(active_buffer, "\n\n");
 
-  // Switch buffers back
+  // Switch buffers back, temps are defined with the other variables
+  codegen_define_frame(optimizer_function(&function_buffer));
   dynstr_append_str(&main_buffer, function_buffer.str);
   dynstr_clear(&function_buffer);
   active_buffer = &main_buffer;
 
   tmpmax = 0;
+  cse_max = 0;
+  licm_max = 0;
+  codegen_cse_clear();
 }
 
 void codegen_function_return(int ret_count, int exp_count) {
@@ -302,174 +676,1038 @@ void codegen_function_return(int ret_count, int exp_count) {
   dynstr_append_str(active_buffer, "RETURN\n");
 }
 
-void codegen_expression_push_value(token_t* token, int lvl) {
+void codegen_expression_push_value(const exptree_node_t* node) {
   dynstr_append_str(active_buffer, "PUSHS ");
-  codegen_literal(token, lvl);
-}
-
-void codegen_expression_plus() { dynstr_append_str(active_buffer, "ADDS\n"); }
-void codegen_expression_minus() { dynstr_append_str(active_buffer, "SUBS\n"); }
-void codegen_expression_mul() { dynstr_append_str(active_buffer, "MULS\n"); }
-void codegen_expression_div() { dynstr_append_str(active_buffer, "DIVS\n"); }
-void codegen_expression_divint() {
-  dynstr_append_str(active_buffer, "IDIVS\n");
-}
-void codegen_expression_eq() { dynstr_append_str(active_buffer, "EQS\n"); }
-void codegen_expression_neq() {
-  dynstr_append_str(active_buffer, "EQS\nNOTS\n");
-}
-void codegen_expression_lt() { dynstr_append_str(active_buffer, "LTS\n"); }
-void codegen_expression_gt() { dynstr_append_str(active_buffer, "GTS\n"); }
-
-void codegen_expression_concat() {
-  codegen_get_temp_vars(3);
-  dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
-  dynstr_append_str(active_buffer, "POPS LF@$tmp2\n");
-  dynstr_append_str(active_buffer, "CONCAT LF@$tmp3 LF@$tmp2 LF@$tmp1\n");
-  dynstr_append_str(active_buffer, "PUSHS LF@$tmp3\n");
-}
-void codegen_expression_strlen() {
-  codegen_get_temp_vars(2);
-  dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
-  dynstr_append_str(active_buffer, "STRLEN LF@$tmp2 LF@$tmp1\n");
-  dynstr_append_str(active_buffer, "PUSHS LF@$tmp2\n");
-}
-void codegen_expression_lte() {
-  codegen_get_temp_vars(3);
-  dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
-  dynstr_append_str(active_buffer, "POPS LF@$tmp2\n");
-  dynstr_append_str(active_buffer, "EQ LF@$tmp3 LF@$tmp2 LF@$tmp1\n");
-  dynstr_append_str(active_buffer, "PUSHS LF@$tmp3\n");
-  dynstr_append_str(active_buffer, "LT LF@$tmp3 LF@$tmp2 LF@$tmp1\n");
-  dynstr_append_str(active_buffer, "PUSHS LF@$tmp3\n");
-  dynstr_append_str(active_buffer, "ORS\n");
-}
-void codegen_expression_gte() {
-  codegen_get_temp_vars(3);
-  dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
-  dynstr_append_str(active_buffer, "POPS LF@$tmp2\n");
-  dynstr_append_str(active_buffer, "EQ LF@$tmp3 LF@$tmp2 LF@$tmp1\n");
-  dynstr_append_str(active_buffer, "PUSHS LF@$tmp3\n");
-  dynstr_append_str(active_buffer, "GT LF@$tmp3 LF@$tmp2 LF@$tmp1\n");
-  dynstr_append_str(active_buffer, "PUSHS LF@$tmp3\n");
-  dynstr_append_str(active_buffer, "ORS\n");
-}
-
-void codegen_cast_int_to_float1() {
-  dynstr_append_str(active_buffer, "INT2FLOATS\n");
+  codegen_expression_symbol(node);
+  dynstr_append_str(active_buffer, "\n");
 }
 
-void codegen_cast_int_to_float2() {
-  codegen_get_temp_vars(1);
-  dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
-  dynstr_append_str(active_buffer, "INT2FLOATS\n");
-  dynstr_append_str(active_buffer, "PUSHS LF@$tmp1\n");
-}
+void codegen_expression_symbol(const exptree_node_t* node) {
+  int var = exptree_is_leaf(node) ? -1 : codegen_licm_find(node);
+  if (var != -1) {
+    dynstr_append_str(active_buffer, "LF@$licm");
+    dynstr_append_int(active_buffer, var);
+    return;
+  }
 
-void codegen_cast_float_to_int1() {
-  dynstr_append_str(active_buffer, "FLOAT2INTS\n");
+  token_t token;
+  token.attr = node->value;
+  switch (node->kind) {
+    case EXP_INTEGER:
+      token.type = TT_INTEGER;
+      break;
+    case EXP_NUMBER:
+      token.type = TT_NUMBER;
+      break;
+    case EXP_STRING:
+      token.type = TT_STRING;
+      break;
+    case EXP_ID:
+      token.type = TT_ID;
+      break;
+    default:
+      token.type = TT_K_NIL;
+      break;
+  }
+  codegen_symbol(&token, node->lvl);
 }
 
-void codegen_cast_float_to_int2() {
-  codegen_get_temp_vars(1);
-  dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
-  dynstr_append_str(active_buffer, "FLOAT2INTS\n");
-  dynstr_append_str(active_buffer, "PUSHS LF@$tmp1\n");
+void codegen_expression(const exptree_node_t* node) {
+  codegen_expression_begin(node);
+  codegen_expression_tree(node);
 }
 
-void codegen_not_nil() {
-  dynstr_append_str(active_buffer, "PUSHS nil@nil\n");
-  dynstr_append_str(active_buffer, "EQS\nNOTS\n");
+void codegen_expression_begin(const exptree_node_t* node) {
+  cse_gen++;
+  cse_used = 0;
+  codegen_cse_count(node);
 }
 
-void codegen_define_var(char* old_id, int lvl) {
-  char* id = scope_get_correct_id(old_id, lvl);
-
-  dynstr_append_str(&main_buffer, "DEFVAR LF@");
-  dynstr_append_str(&main_buffer, id);
-  dynstr_append_str(&main_buffer, "\n");
-  dynstr_append_str(&main_buffer, "MOVE LF@");
-  dynstr_append_str(&main_buffer, id);
-  dynstr_append_str(&main_buffer, " nil@nil\n");
-}
+void codegen_expression_tree(const exptree_node_t* node) {
+  if (exptree_is_leaf(node)) {
+    codegen_expression_push_value(node);
+    return;
+  }
 
-int expression_assign_count = 0;
+  if (codegen_licm_push(node) || codegen_cse_push(node)) {
+    return;
+  }
 
-void codegen_assign_expression_add(char* old_id, int lvl) {
-  char* id = scope_get_correct_id(old_id, lvl);
-  dynstr_prepend_str(&expression_assign_buffer, "\n");
-  dynstr_prepend_str(&expression_assign_buffer, id);
-  dynstr_prepend_str(&expression_assign_buffer, "POPS LF@");
-  expression_assign_count++;
-}
+  if (node->kind == EXP_CONCAT && codegen_concat_flat(node)) {
+    codegen_expression_concat_chain(node);
+    codegen_cse_save(node);
+    return;
+  }
 
-void codegen_assign_expression_finish(int count) {
-  codegen_get_temp_vars(1);
-  for (int i = 0; i < count - expression_assign_count; i++) {
-    dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
+  // operands in order, operation works on top of the stack
+  codegen_expression_tree(node->left);
+  if (node->right) {
+    codegen_expression_tree(node->right);
+  }
+
+  switch (node->kind) {
+    case EXP_INT2FLOAT:
+      codegen_cast_int_to_float1();
+      break;
+    case EXP_FLOAT2INT:
+      codegen_cast_float_to_int1();
+      break;
+    case EXP_STRLEN:
+      codegen_expression_strlen();
+      break;
+    case EXP_PLUS:
+      codegen_expression_plus();
+      break;
+    case EXP_MINUS:
+      codegen_expression_minus();
+      break;
+    case EXP_MUL:
+      codegen_expression_mul();
+      break;
+    case EXP_DIV:
+      codegen_expression_div();
+      break;
+    case EXP_DIVINT:
+      codegen_expression_divint();
+      break;
+    case EXP_CONCAT:
+      codegen_expression_concat();
+      break;
+    case EXP_EQ:
+      codegen_expression_eq();
+      break;
+    case EXP_NEQ:
+      codegen_expression_neq();
+      break;
+    case EXP_LT:
+      codegen_expression_lt();
+      break;
+    case EXP_LTE:
+      codegen_expression_lte();
+      break;
+    case EXP_GT:
+      codegen_expression_gt();
+      break;
+    case EXP_GTE:
+      codegen_expression_gte();
+      break;
+    default:
+      break;
+  }
+
+  codegen_cse_save(node);
+}
+
+bool codegen_cse_candidate(const exptree_node_t* node) {
+  return !exptree_is_leaf(node) && node->kind != EXP_INT2FLOAT &&
+         node->kind != EXP_FLOAT2INT;
+}
+
+bool codegen_cse_push(const exptree_node_t* node) {
+  int var = codegen_cse_candidate(node) ? codegen_cse_find(node) : -1;
+  if (var == -1) {
+    return false;
+  }
+  dynstr_append_str(active_buffer, "PUSHS LF@$cse");
+  dynstr_append_int(active_buffer, var);
+  dynstr_append_str(active_buffer, "\n");
+  return true;
+}
+
+void codegen_cse_save(const exptree_node_t* node) {
+  // value is computed again later, save it
+  if (codegen_cse_candidate(node) && codegen_cse_occurs(node, 0) > 1 &&
+      cse_count < CODEGEN_CSE_MAX_VALUES) {
+    int var = cse_count + 1;
+    if (var > cse_max) {
+      cse_max = var;
+    }
+    dynstr_append_str(active_buffer, "POPS LF@$cse");
+    dynstr_append_int(active_buffer, var);
+    dynstr_append_str(active_buffer, "\nPUSHS LF@$cse");
+    dynstr_append_int(active_buffer, var);
+    dynstr_append_str(active_buffer, "\n");
+
+    cse_values[cse_count].node = exptree_copy(&cse_arena, node);
+    cse_values[cse_count].var = var;
+    if (cse_values[cse_count].node) {
+      cse_count++;
+    }
+  }
+}
+
+void codegen_cse_clear() {
+  cse_count = 0;
+  arena_reset(&cse_arena);
+}
+
+void codegen_cse_invalidate(const char* id) {
+  int kept = 0;
+  for (int i = 0; i < cse_count; i++) {
+    if (!codegen_cse_uses(cse_values[i].node, id)) {
+      cse_values[kept++] = cse_values[i];
+    }
+  }
+  cse_count = kept;
+}
+
+bool codegen_cse_uses(const exptree_node_t* node, const char* id) {
+  if (node->kind == EXP_ID) {
+    return !strcmp(scope_get_correct_id(node->value.str, node->lvl), id);
+  }
+  if (exptree_is_leaf(node)) {
+    return false;
+  }
+  return codegen_cse_uses(node->left, id) ||
+         (node->right && codegen_cse_uses(node->right, id));
+}
+
+int codegen_cse_find(const exptree_node_t* node) {
+  for (int i = 0; i < cse_count; i++) {
+    if (exptree_equal(cse_values[i].node, node)) {
+      return cse_values[i].var;
+    }
+  }
+  return -1;
+}
+
+int codegen_cse_occurs(const exptree_node_t* node, int add) {
+  // at most half full
+  if (2 * (cse_used + 1) > cse_size && !codegen_cse_grow()) {
+    return 0;
+  }
+  int i = node->hash & (cse_size - 1);
+  while (cse_slots[i].gen == cse_gen &&
+         !exptree_equal(cse_slots[i].node, node)) {
+    i = (i + 1) & (cse_size - 1);
+  }
+  if (cse_slots[i].gen != cse_gen) {
+    cse_slots[i].node = node;
+    cse_slots[i].occurs = 0;
+    cse_slots[i].gen = cse_gen;
+    cse_used++;
+  }
+  cse_slots[i].occurs += add;
+  return cse_slots[i].occurs;
+}
+
+bool codegen_cse_grow() {
+  int size = cse_size ? cse_size * 2 : 64;
+  codegen_cse_slot_t* slots = calloc(size, sizeof(codegen_cse_slot_t));
+  if (!slots) {
+    error_set(EXITSTATUS_INTERNAL_ERROR);
+    return false;
+  }
+  for (int i = 0; i < cse_size; i++) {
+    if (cse_slots[i].gen == cse_gen) {
+      int j = cse_slots[i].node->hash & (size - 1);
+      while (slots[j].gen == cse_gen) {
+        j = (j + 1) & (size - 1);
+      }
+      slots[j] = cse_slots[i];
+    }
+  }
+  free(cse_slots);
+  cse_slots = slots;
+  cse_size = size;
+  return true;
+}
+
+void codegen_cse_count(const exptree_node_t* node) {
+  if (exptree_is_leaf(node)) {
+    return;
+  }
+  // operands of repeated subtree are not counted again
+  if (codegen_cse_candidate(node) && codegen_cse_seen(node)) {
+    return;
+  }
+  codegen_cse_count(node->left);
+  if (node->right) {
+    codegen_cse_count(node->right);
+  }
+}
+
+bool codegen_cse_seen(const exptree_node_t* node) {
+  return codegen_cse_find(node) != -1 || codegen_cse_occurs(node, 1) > 1;
+}
+
+int codegen_licm_begin(const ast_node_t* loop) {
+  int count = licm_count;
+  // condition which is not evaluated proves nothing
+  if (exptree_truth(loop->cond) != EXPTREE_UNKNOWN) {
+    return count;
+  }
+
+  licm_loop = loop;
+  licm_clean = true;
+  licm_proven_count = 0;
+  codegen_licm_condition(loop->cond, true);
+
+  // the condition runs before every pass of the body, so values which
+  // cannot fail on its proven variables are safe to compute early
+  for (const ast_node_t* node = loop->body; node && licm_proven_count;
+       node = node->next) {
+    if (node->cond) {
+      codegen_licm_body(node->cond);
+    }
+    for (ast_expr_t* value = node->values; value; value = value->next) {
+      codegen_licm_body(value->tree);
+    }
+  }
+  return count;
+}
+
+void codegen_licm_end(int count) {
+  licm_count = count;
+  if (!licm_count) {
+    arena_reset(&licm_arena);
+  }
+}
+
+void codegen_licm_condition(const exptree_node_t* node, bool root) {
+  if (exptree_is_leaf(node)) {
+    return;
+  }
+  // computed before the loop, so the first evaluation fails the same way
+  if (!root && licm_clean && codegen_licm_invariant(node, 0) &&
+      codegen_licm_hoist(node, 0)) {
+    codegen_licm_prove(node, true);
+    return;
+  }
+
+  codegen_licm_condition(node->left, false);
+  if (node->right) {
+    codegen_licm_condition(node->right, false);
+  }
+  if (licm_clean) {
+    codegen_licm_prove(node, false);
+  }
+  // only equality never fails
+  if (node->kind != EXP_EQ && node->kind != EXP_NEQ) {
+    licm_clean = false;
+  }
+}
+
+void codegen_licm_body(const exptree_node_t* node) {
+  if (exptree_is_leaf(node)) {
+    return;
+  }
+  if (codegen_licm_safe(node) && codegen_licm_invariant(node, 1) &&
+      codegen_licm_hoist(node, 1)) {
+    return;
+  }
+
+  codegen_licm_body(node->left);
+  if (node->right) {
+    codegen_licm_body(node->right);
+  }
+}
+
+bool codegen_licm_hoist(const exptree_node_t* node, int depth) {
+  if (licm_count >= CODEGEN_LICM_MAX_VALUES) {
+    return false;
+  }
+  exptree_node_t* copy = exptree_copy(&licm_arena, node);
+  if (!copy) {
+    return false;
+  }
+  codegen_licm_lift(copy, depth);
+  if (codegen_licm_find(copy) != -1) {
+    // hoisted already
+    return true;
+  }
+
+  codegen_expression(copy);
+  int var = licm_count + 1;
+  if (var > licm_max) {
+    licm_max = var;
+  }
+  dynstr_append_str(active_buffer, "POPS LF@$licm");
+  dynstr_append_int(active_buffer, var);
+  dynstr_append_str(active_buffer, "\n");
+
+  codegen_licm_resolve(copy);
+  licm_values[licm_count++] = copy;
+  return true;
+}
+
+int codegen_licm_find(const exptree_node_t* node) {
+  for (int i = licm_count - 1; i >= 0; i--) {
+    if (codegen_licm_equal(node, licm_values[i])) {
+      return i + 1;
+    }
+  }
+  return -1;
+}
+
+bool codegen_licm_push(const exptree_node_t* node) {
+  int var = codegen_licm_find(node);
+  if (var == -1) {
+    return false;
+  }
+  dynstr_append_str(active_buffer, "PUSHS LF@$licm");
+  dynstr_append_int(active_buffer, var);
+  dynstr_append_str(active_buffer, "\n");
+  return true;
+}
+
+bool codegen_licm_equal(const exptree_node_t* node,
+                        const exptree_node_t* value) {
+  if (node->kind != value->kind || node->type != value->type) {
+    return false;
+  }
+  switch (node->kind) {
+    case EXP_INTEGER:
+      return node->value.int_val == value->value.int_val;
+    case EXP_NUMBER:
+      return node->value.num_val == value->value.num_val;
+    case EXP_STRING:
+      return !strcmp(node->value.str, value->value.str);
+    case EXP_NIL:
+      return true;
+    case EXP_ID:
+      return !strcmp(scope_get_correct_id(node->value.str, node->lvl),
+                     value->value.str);
+    default:
+      return codegen_licm_equal(node->left, value->left) &&
+             (!node->right || codegen_licm_equal(node->right, value->right));
+  }
+}
+
+void codegen_licm_lift(exptree_node_t* node, int depth) {
+  if (node->kind == EXP_ID) {
+    node->lvl -= depth;
+  }
+  if (!exptree_is_leaf(node)) {
+    codegen_licm_lift(node->left, depth);
+    if (node->right) {
+      codegen_licm_lift(node->right, depth);
+    }
+  }
+}
+
+void codegen_licm_resolve(exptree_node_t* node) {
+  if (node->kind == EXP_ID) {
+    char* id = arena_strdup(&licm_arena,
+                            scope_get_correct_id(node->value.str, node->lvl));
+    // unresolved copy only matches the same variable
+    if (id) {
+      node->value.str = id;
+    }
+  }
+  if (!exptree_is_leaf(node)) {
+    codegen_licm_resolve(node->left);
+    if (node->right) {
+      codegen_licm_resolve(node->right);
+    }
+  }
+}
+
+bool codegen_licm_invariant(const exptree_node_t* node, int depth) {
+  if (node->kind == EXP_ID) {
+    return node->lvl >= depth &&
+           !codegen_licm_assigned(licm_loop, node->value.str);
+  }
+  if (exptree_is_leaf(node)) {
+    return true;
+  }
+  return codegen_licm_invariant(node->left, depth) &&
+         (!node->right || codegen_licm_invariant(node->right, depth));
+}
+
+bool codegen_licm_assigned(const ast_node_t* loop, const char* id) {
+  // first store of the variable after the loop statement itself
+  int low = 0;
+  int high = licm_store_count;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    int cmp = strcmp(licm_stores[mid].name, id);
+    if (cmp < 0 || (!cmp && licm_stores[mid].index <= loop->index)) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low < licm_store_count && !strcmp(licm_stores[low].name, id) &&
+         licm_stores[low].index <= loop->last;
+}
+
+void codegen_licm_collect(const ast_node_t* node) {
+  for (; node && !error_get(); node = node->next) {
+    if (node->kind == AST_LOCAL) {
+      codegen_licm_store(node->name, node->index);
+    }
+    if (node->kind == AST_ASSIGN) {
+      for (ast_expr_t* var = node->ids; var; var = var->next) {
+        codegen_licm_store(var->tree->value.str, node->index);
+      }
+    }
+    codegen_licm_collect(node->body);
+    codegen_licm_collect(node->else_body);
+  }
+}
+
+void codegen_licm_store(const char* name, int index) {
+  if (licm_store_count == licm_store_max) {
+    int max = licm_store_max ? 2 * licm_store_max : 16;
+    codegen_store_t* stores =
+        realloc(licm_stores, max * sizeof(codegen_store_t));
+    if (!stores) {
+      error_set(EXITSTATUS_INTERNAL_ERROR);
+      return;
+    }
+    licm_stores = stores;
+    licm_store_max = max;
+  }
+  licm_stores[licm_store_count++] = (codegen_store_t){name, index};
+}
+
+int codegen_licm_store_compare(const void* a, const void* b) {
+  const codegen_store_t* x = a;
+  const codegen_store_t* y = b;
+  int cmp = strcmp(x->name, y->name);
+  return cmp ? cmp : (x->index > y->index) - (x->index < y->index);
+}
+
+void codegen_licm_stores_free() {
+  free(licm_stores);
+  licm_stores = NULL;
+  licm_store_count = 0;
+  licm_store_max = 0;
+}
+
+bool codegen_licm_may_fail(const exptree_node_t* node) {
+  switch (node->kind) {
+    case EXP_DIV:
+    case EXP_DIVINT:
+      // division by zero
+      return !(node->right->kind == EXP_INTEGER &&
+               node->right->value.int_val != 0) &&
+             !(node->right->kind == EXP_NUMBER &&
+               node->right->value.num_val != 0);
+    case EXP_FLOAT2INT:
+      // out of range of integer
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool codegen_licm_safe(const exptree_node_t* node) {
+  switch (node->kind) {
+    case EXP_INTEGER:
+    case EXP_NUMBER:
+    case EXP_STRING:
+      return true;
+    case EXP_NIL:
+      return false;
+    case EXP_ID:
+      return codegen_licm_proven(node->value.str);
+    default:
+      return !codegen_licm_may_fail(node) && codegen_licm_safe(node->left) &&
+             (!node->right || codegen_licm_safe(node->right));
+  }
+}
+
+void codegen_licm_prove(const exptree_node_t* node, bool deep) {
+  if (exptree_is_leaf(node)) {
+    return;
+  }
+  if (deep) {
+    codegen_licm_prove(node->left, deep);
+    if (node->right) {
+      codegen_licm_prove(node->right, deep);
+    }
+  }
+  // equality is the only operation accepting nil
+  if (node->kind == EXP_EQ || node->kind == EXP_NEQ) {
+    return;
+  }
+  const exptree_node_t* operands[] = {node->left, node->right};
+  for (int i = 0; i < 2; i++) {
+    if (operands[i] && operands[i]->kind == EXP_ID &&
+        licm_proven_count < CODEGEN_LICM_MAX_PROVEN &&
+        !codegen_licm_proven(operands[i]->value.str)) {
+      licm_proven[licm_proven_count++] = operands[i]->value.str;
+    }
+  }
+}
+
+bool codegen_licm_proven(const char* id) {
+  for (int i = 0; i < licm_proven_count; i++) {
+    if (!strcmp(licm_proven[i], id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool codegen_operand(const exptree_node_t* node) {
+  return exptree_is_leaf(node) || codegen_licm_find(node) != -1;
+}
+
+void codegen_expression_plus() { dynstr_append_str(active_buffer, "ADDS\n"); }
+void codegen_expression_minus() { dynstr_append_str(active_buffer, "SUBS\n"); }
+void codegen_expression_mul() { dynstr_append_str(active_buffer, "MULS\n"); }
+void codegen_expression_div() { dynstr_append_str(active_buffer, "DIVS\n"); }
+void codegen_expression_divint() {
+  dynstr_append_str(active_buffer, "IDIVS\n");
+}
+void codegen_expression_eq() { dynstr_append_str(active_buffer, "EQS\n"); }
+void codegen_expression_neq() {
+  dynstr_append_str(active_buffer, "EQS\nNOTS\n");
+}
+void codegen_expression_lt() { dynstr_append_str(active_buffer, "LTS\n"); }
+void codegen_expression_gt() { dynstr_append_str(active_buffer, "GTS\n"); }
+
+void codegen_expression_concat() {
+  codegen_get_temp_vars(3);
+  dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
+  dynstr_append_str(active_buffer, "POPS LF@$tmp2\n");
+  dynstr_append_str(active_buffer, "CONCAT LF@$tmp3 LF@$tmp2 LF@$tmp1\n");
+  dynstr_append_str(active_buffer, "PUSHS LF@$tmp3\n");
+}
+void codegen_expression_concat_chain(const exptree_node_t* node) {
+  concat_first = NULL;
+  concat_started = false;
+  codegen_get_temp_vars(1);
+  codegen_concat_operand(node);
+  dynstr_append_str(active_buffer, "PUSHS LF@$tmp1\n");
+}
+
+bool codegen_concat_flat(const exptree_node_t* node) {
+  if (node->kind != EXP_CONCAT) {
+    return exptree_is_leaf(node);
+  }
+  return codegen_concat_flat(node->left) && codegen_concat_flat(node->right);
+}
+
+void codegen_concat_operand(const exptree_node_t* node) {
+  if (node->kind == EXP_CONCAT) {
+    codegen_concat_operand(node->left);
+    codegen_concat_operand(node->right);
+    return;
+  }
+  if (!concat_first) {
+    concat_first = node;
+    return;
+  }
+
+  dynstr_append_str(active_buffer, "CONCAT LF@$tmp1 ");
+  if (concat_started) {
+    dynstr_append_str(active_buffer, "LF@$tmp1");
+  } else {
+    codegen_expression_symbol(concat_first);
+    concat_started = true;
+  }
+  dynstr_append_str(active_buffer, " ");
+  codegen_expression_symbol(node);
+  dynstr_append_str(active_buffer, "\n");
+}
+
+void codegen_expression_strlen() {
+  codegen_get_temp_vars(2);
+  dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
+  dynstr_append_str(active_buffer, "STRLEN LF@$tmp2 LF@$tmp1\n");
+  dynstr_append_str(active_buffer, "PUSHS LF@$tmp2\n");
+}
+void codegen_expression_lte() {
+  codegen_get_temp_vars(3);
+  dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
+  dynstr_append_str(active_buffer, "POPS LF@$tmp2\n");
+  dynstr_append_str(active_buffer, "EQ LF@$tmp3 LF@$tmp2 LF@$tmp1\n");
+  dynstr_append_str(active_buffer, "PUSHS LF@$tmp3\n");
+  dynstr_append_str(active_buffer, "LT LF@$tmp3 LF@$tmp2 LF@$tmp1\n");
+  dynstr_append_str(active_buffer, "PUSHS LF@$tmp3\n");
+  dynstr_append_str(active_buffer, "ORS\n");
+}
+void codegen_expression_gte() {
+  codegen_get_temp_vars(3);
+  dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
+  dynstr_append_str(active_buffer, "POPS LF@$tmp2\n");
+  dynstr_append_str(active_buffer, "EQ LF@$tmp3 LF@$tmp2 LF@$tmp1\n");
+  dynstr_append_str(active_buffer, "PUSHS LF@$tmp3\n");
+  dynstr_append_str(active_buffer, "GT LF@$tmp3 LF@$tmp2 LF@$tmp1\n");
+  dynstr_append_str(active_buffer, "PUSHS LF@$tmp3\n");
+  dynstr_append_str(active_buffer, "ORS\n");
+}
+
+void codegen_cast_int_to_float1() {
+  // integer literal on the top of the stack is converted now
+  size_t start = active_buffer->len;
+  if (start > 0 && active_buffer->str[start - 1] == '\n') {
+    start--;
+    while (start > 0 && active_buffer->str[start - 1] != '\n') {
+      start--;
+    }
+    if (strncmp(active_buffer->str + start, "PUSHS int@", 10) == 0) {
+      double value = strtol(active_buffer->str + start + 10, NULL, 10);
+      active_buffer->len = start;
+      active_buffer->str[start] = '\0';
+      dynstr_append_str(active_buffer, "PUSHS float@");
+      dynstr_append_double(active_buffer, value);
+      dynstr_append_str(active_buffer, "\n");
+      return;
+    }
+  }
+  dynstr_append_str(active_buffer, "INT2FLOATS\n");
+}
+
+void codegen_cast_int_to_float2() {
+  codegen_get_temp_vars(1);
+  dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
+  dynstr_append_str(active_buffer, "INT2FLOATS\n");
+  dynstr_append_str(active_buffer, "PUSHS LF@$tmp1\n");
+}
+
+void codegen_cast_float_to_int1() {
+  dynstr_append_str(active_buffer, "FLOAT2INTS\n");
+}
+
+void codegen_cast_float_to_int2() {
+  codegen_get_temp_vars(1);
+  dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
+  dynstr_append_str(active_buffer, "FLOAT2INTS\n");
+  dynstr_append_str(active_buffer, "PUSHS LF@$tmp1\n");
+}
+
+void codegen_define_var(char* old_id, int lvl) {
+  char* id = scope_get_correct_id(old_id, lvl);
+
+  // defined once in the header, even if the declaration runs in a loop
+  dynstr_append_str(&frame_buffer, "DEFVAR LF@");
+  dynstr_append_str(&frame_buffer, id);
+  dynstr_append_str(&frame_buffer, "\n");
+}
+
+codegen_access_t codegen_first_access(const ast_node_t* node,
+                                      const char* name) {
+  for (; node; node = node->next) {
+    codegen_access_t access = codegen_statement_access(node, name);
+    if (access != CODEGEN_ACCESS_NONE) {
+      return access;
+    }
+  }
+  return CODEGEN_ACCESS_NONE;
+}
+
+codegen_access_t codegen_statement_access(const ast_node_t* node,
+                                          const char* name) {
+  // values are evaluated before any of the variables is assigned
+  if (codegen_tree_reads(node->cond, name) ||
+      codegen_exprs_read(node->values, name) ||
+      (node->kind == AST_CALL && codegen_exprs_read(node->ids, name)) ||
+      (node->call && codegen_exprs_read(node->call->ids, name)) ||
+      (node->kind == AST_LOCAL && !strcmp(node->name, name))) {
+    return CODEGEN_ACCESS_READ;
+  }
+
+  codegen_access_t body, else_body;
+  switch (node->kind) {
+    case AST_ASSIGN:
+      for (ast_expr_t* id = node->ids; id; id = id->next) {
+        if (!strcmp(id->tree->value.str, name)) {
+          return CODEGEN_ACCESS_ASSIGNED;
+        }
+      }
+      return CODEGEN_ACCESS_NONE;
+    case AST_RETURN:
+      return CODEGEN_ACCESS_ASSIGNED;
+    case AST_IF:
+      body = codegen_first_access(node->body, name);
+      else_body = codegen_first_access(node->else_body, name);
+      if (body == CODEGEN_ACCESS_READ || else_body == CODEGEN_ACCESS_READ) {
+        return CODEGEN_ACCESS_READ;
+      }
+      return body == CODEGEN_ACCESS_ASSIGNED &&
+                     else_body == CODEGEN_ACCESS_ASSIGNED
+                 ? CODEGEN_ACCESS_ASSIGNED
+                 : CODEGEN_ACCESS_NONE;
+    case AST_WHILE:
+      // body does not have to run at all
+      return codegen_first_access(node->body, name) == CODEGEN_ACCESS_READ
+                 ? CODEGEN_ACCESS_READ
+                 : CODEGEN_ACCESS_NONE;
+    default:
+      return CODEGEN_ACCESS_NONE;
+  }
+}
+
+bool codegen_tree_reads(const exptree_node_t* node, const char* name) {
+  if (!node) {
+    return false;
+  }
+  if (node->kind == EXP_ID) {
+    return !strcmp(node->value.str, name);
+  }
+  if (exptree_is_leaf(node)) {
+    return false;
+  }
+  return codegen_tree_reads(node->left, name) ||
+         codegen_tree_reads(node->right, name);
+}
+
+bool codegen_exprs_read(const ast_expr_t* expr, const char* name) {
+  for (; expr; expr = expr->next) {
+    if (codegen_tree_reads(expr->tree, name)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+THREAD_LOCAL int expression_assign_count = 0;
+
+void codegen_assign_expression_add(char* old_id, int lvl) {
+  char* id = scope_get_correct_id(old_id, lvl);
+  dynstr_prepend_str(&expression_assign_buffer, "\n");
+  dynstr_prepend_str(&expression_assign_buffer, id);
+  dynstr_prepend_str(&expression_assign_buffer, "POPS LF@");
+  expression_assign_count++;
+  dynstr_append_str(&cse_assigned, id);
+  dynstr_append_str(&cse_assigned, "\n");
+}
+
+void codegen_assign_expression_finish(int count) {
+  codegen_get_temp_vars(1);
+  for (int i = 0; i < count - expression_assign_count; i++) {
+    dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
   }
   dynstr_append_str(active_buffer, expression_assign_buffer.str);
   dynstr_clear(&expression_assign_buffer);
   expression_assign_count = 0;
+
+  for (char* id = cse_assigned.str; *id;) {
+    char* end = strchr(id, '\n');
+    *end = '\0';
+    codegen_cse_invalidate(id);
+    id = end + 1;
+  }
+  dynstr_clear(&cse_assigned);
 }
 
-void codegen_if_begin() {
-  iddepth++;
-  idmax++;
-  idstack[iddepth] = idmax;
+void codegen_discard_begin() {
+  if (discard_depth++ > 0) return;
+  discard_saved_buffer = active_buffer;
+  discard_saved_tmpmax = tmpmax;
+  active_buffer = &discard_buffer;
+}
+
+void codegen_discard_end() {
+  if (--discard_depth > 0) return;
+  active_buffer = discard_saved_buffer;
+  codegen_cse_clear();
+  // temps used only by discarded code are not defined
+  tmpmax = discard_saved_tmpmax;
+  dynstr_clear(&discard_buffer);
+}
+
+void codegen_label_name(char* label, int id) {
+  dynstr_append_str(active_buffer, label);
+  if (label_namespace > 0) {
+    dynstr_append_int(active_buffer, label_namespace);
+    dynstr_append_str(active_buffer, "_");
+  }
+  dynstr_append_int(active_buffer, id);
+}
+
+void codegen_condition_jump(const exptree_node_t* node, char type, bool value,
+                            char* label, int id) {
+  codegen_expression_begin(node);
+
+  // only nil is false
+  if (type != 'b') {
+    if (exptree_is_leaf(node)) {
+      dynstr_append_str(active_buffer, value ? "JUMPIFNEQ " : "JUMPIFEQ ");
+      codegen_label_name(label, id);
+      dynstr_append_str(active_buffer, " nil@nil ");
+      codegen_expression_symbol(node);
+      dynstr_append_str(active_buffer, "\n");
+    } else {
+      codegen_expression_tree(node);
+      dynstr_append_str(active_buffer, value ? "PUSHS nil@nil\nJUMPIFNEQS "
+                                             : "PUSHS nil@nil\nJUMPIFEQS ");
+      codegen_label_name(label, id);
+      dynstr_append_str(active_buffer, "\n");
+    }
+    return;
+  }
+
+  // a <= b is false when a > b, a >= b when a < b
+  char* op;
+  char* jump;
+  switch (node->kind) {
+    case EXP_EQ:
+      op = NULL;
+      jump = value ? "JUMPIFEQ" : "JUMPIFNEQ";
+      break;
+    case EXP_NEQ:
+      op = NULL;
+      jump = value ? "JUMPIFNEQ" : "JUMPIFEQ";
+      break;
+    case EXP_LT:
+      op = "LT";
+      jump = value ? "bool@true" : "bool@false";
+      break;
+    case EXP_GT:
+      op = "GT";
+      jump = value ? "bool@true" : "bool@false";
+      break;
+    case EXP_LTE:
+      op = "GT";
+      jump = value ? "bool@false" : "bool@true";
+      break;
+    case EXP_GTE:
+      op = "LT";
+      jump = value ? "bool@false" : "bool@true";
+      break;
+    default:
+      codegen_expression_tree(node);
+      dynstr_append_str(active_buffer, value ? "PUSHS bool@true\nJUMPIFEQS "
+                                             : "PUSHS bool@false\nJUMPIFEQS ");
+      codegen_label_name(label, id);
+      dynstr_append_str(active_buffer, "\n");
+      return;
+  }
+
+  bool leaves = codegen_operand(node->left) && codegen_operand(node->right);
+  if (!leaves) {
+    codegen_expression_tree(node->left);
+    codegen_expression_tree(node->right);
+  }
+
+  if (op && leaves) {
+    // LT LF@$tmp1 a b, JUMPIFEQ label LF@$tmp1 bool@false
+    codegen_get_temp_vars(1);
+    dynstr_append_str(active_buffer, op);
+    dynstr_append_str(active_buffer, " LF@$tmp1 ");
+    codegen_expression_symbol(node->left);
+    dynstr_append_str(active_buffer, " ");
+    codegen_expression_symbol(node->right);
+    dynstr_append_str(active_buffer, "\nJUMPIFEQ ");
+    codegen_label_name(label, id);
+    dynstr_append_str(active_buffer, " LF@$tmp1 ");
+    dynstr_append_str(active_buffer, jump);
+    dynstr_append_str(active_buffer, "\n");
+  } else if (op) {
+    // LTS, PUSHS bool@false, JUMPIFEQS label
+    dynstr_append_str(active_buffer, op);
+    dynstr_append_str(active_buffer, "S\nPUSHS ");
+    dynstr_append_str(active_buffer, jump);
+    dynstr_append_str(active_buffer, "\nJUMPIFEQS ");
+    codegen_label_name(label, id);
+    dynstr_append_str(active_buffer, "\n");
+  } else if (leaves) {
+    // JUMPIFNEQ label a b
+    dynstr_append_str(active_buffer, jump);
+    dynstr_append_str(active_buffer, " ");
+    codegen_label_name(label, id);
+    dynstr_append_str(active_buffer, " ");
+    codegen_expression_symbol(node->left);
+    dynstr_append_str(active_buffer, " ");
+    codegen_expression_symbol(node->right);
+    dynstr_append_str(active_buffer, "\n");
+  } else {
+    // JUMPIFNEQS label
+    dynstr_append_str(active_buffer, jump);
+    dynstr_append_str(active_buffer, "S ");
+    codegen_label_name(label, id);
+    dynstr_append_str(active_buffer, "\n");
+  }
+}
+
+exptree_truth_t codegen_if_begin(const exptree_node_t* cond, char type) {
+  exptree_truth_t truth = exptree_truth(cond);
+  if (truth == EXPTREE_FALSE) {
+    codegen_discard_begin();
+  }
+  if (truth != EXPTREE_UNKNOWN) {
+    return truth;
+  }
+
+  codegen_label_push();
+  if (error_get()) return truth;
   dynstr_append_str(active_buffer, "# if_");
   dynstr_append_int(active_buffer, idmax);
   dynstr_append_str(active_buffer, "\n");
-  codegen_get_temp_vars(1);
-  dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
-  dynstr_append_str(active_buffer, "JUMPIFEQ $else_");
-  dynstr_append_int(active_buffer, idmax);
-  dynstr_append_str(active_buffer, " LF@$tmp1 bool@false\n");
+  codegen_condition_jump(cond, type, false, "$else_", idmax);
+  return truth;
 }
 
-void codegen_if_else() {
+void codegen_if_else(exptree_truth_t truth) {
+  if (truth == EXPTREE_TRUE) {
+    codegen_discard_begin();
+    return;
+  }
+  if (truth == EXPTREE_FALSE) {
+    codegen_discard_end();
+    return;
+  }
+
   int id = idstack[iddepth];
-  dynstr_append_str(active_buffer, "JUMP $end_");
-  dynstr_append_int(active_buffer, id);
+  codegen_cse_clear();
+  dynstr_append_str(active_buffer, "JUMP ");
+  codegen_label_name("$end_", id);
   dynstr_append_str(active_buffer, "\n");
-  dynstr_append_str(active_buffer, "LABEL $else_");
-  dynstr_append_int(active_buffer, id);
+  dynstr_append_str(active_buffer, "LABEL ");
+  codegen_label_name("$else_", id);
   dynstr_append_str(active_buffer, "\n");
 }
 
-void codegen_if_end() {
+void codegen_if_end(exptree_truth_t truth) {
+  if (truth == EXPTREE_FALSE) return;
+  if (truth == EXPTREE_TRUE) {
+    codegen_discard_end();
+    return;
+  }
+
   int id = idstack[iddepth];
-  dynstr_append_str(active_buffer, "LABEL $end_");
-  dynstr_append_int(active_buffer, id);
+  codegen_cse_clear();
+  dynstr_append_str(active_buffer, "LABEL ");
+  codegen_label_name("$end_", id);
   dynstr_append_str(active_buffer, "\n");
   iddepth--;
 }
 
-void codegen_while_begin() {
-  iddepth++;
-  idmax++;
-  idstack[iddepth] = idmax;
-  codegen_get_temp_vars(4);
-  dynstr_append_str(active_buffer, "LABEL $while_");
-  dynstr_append_int(active_buffer, idmax);
+exptree_truth_t codegen_while_begin(const exptree_node_t* cond, char type) {
+  exptree_truth_t truth = exptree_truth(cond);
+  if (truth == EXPTREE_FALSE) {
+    codegen_discard_begin();
+    return truth;
+  }
+
+  codegen_label_push();
+  if (error_get()) return truth;
+  // first pass is guarded here, the next ones at the end of the body
+  if (truth == EXPTREE_UNKNOWN) {
+    codegen_condition_jump(cond, type, false, "$while_end_", idmax);
+  }
+  codegen_cse_clear();
+  dynstr_append_str(active_buffer, "LABEL ");
+  codegen_label_name("$while_", idmax);
   dynstr_append_str(active_buffer, "\n");
+  return truth;
 }
 
-void codegen_while_expr() {
-  int id = idstack[iddepth];
-  dynstr_append_str(active_buffer, "POPS LF@$tmp1\n");
-  dynstr_append_str(active_buffer, "JUMPIFEQ $while_end_");
-  dynstr_append_int(active_buffer, id);
-  dynstr_append_str(active_buffer, " LF@$tmp1 bool@false\n");
-}
+void codegen_while_end(const exptree_node_t* cond, char type,
+                       exptree_truth_t truth) {
+  if (truth == EXPTREE_FALSE) {
+    codegen_discard_end();
+    return;
+  }
 
-void codegen_while_end() {
   int id = idstack[iddepth];
-  dynstr_append_str(active_buffer, "JUMP $while_");
-  dynstr_append_int(active_buffer, id);
-  dynstr_append_str(active_buffer, "\n");
-  dynstr_append_str(active_buffer, "LABEL $while_end_");
-  dynstr_append_int(active_buffer, id);
+  codegen_cse_clear();
+  if (truth == EXPTREE_UNKNOWN) {
+    codegen_condition_jump(cond, type, true, "$while_", id);
+  } else {
+    dynstr_append_str(active_buffer, "JUMP ");
+    codegen_label_name("$while_", id);
+    dynstr_append_str(active_buffer, "\n");
+  }
+  codegen_cse_clear();
+  dynstr_append_str(active_buffer, "LABEL ");
+  codegen_label_name("$while_end_", id);
   dynstr_append_str(active_buffer, "\n");
   iddepth--;
 }
@@ -480,41 +1718,41 @@ void codegen_substr_define() {
   if (substr_defined) return;
   substr_defined = true;
 
-  dynstr_append_str(active_buffer, "JUMP $substr_end\n");
-  dynstr_append_str(active_buffer, "LABEL $substr\n");
-  dynstr_append_str(active_buffer, "PUSHFRAME\n");
+  dynstr_append_str(&builtin_buffer, "JUMP $substr_end\n");
+  dynstr_append_str(&builtin_buffer, "LABEL $substr\n");
+  dynstr_append_str(&builtin_buffer, "PUSHFRAME\n");
 
-  dynstr_append_str(active_buffer, "DEFVAR LF@out\n");
-  dynstr_append_str(active_buffer, "MOVE LF@out string@\n");
-  dynstr_append_str(active_buffer, "DEFVAR LF@newchar\n");
+  dynstr_append_str(&builtin_buffer, "DEFVAR LF@out\n");
+  dynstr_append_str(&builtin_buffer, "MOVE LF@out string@\n");
+  dynstr_append_str(&builtin_buffer, "DEFVAR LF@newchar\n");
 
-  dynstr_append_str(active_buffer, "DEFVAR LF@check\n");
-  dynstr_append_str(active_buffer, "LT LF@check int@0 LF@i\n");
-  dynstr_append_str(active_buffer,
+  dynstr_append_str(&builtin_buffer, "DEFVAR LF@check\n");
+  dynstr_append_str(&builtin_buffer, "LT LF@check int@0 LF@i\n");
+  dynstr_append_str(&builtin_buffer,
                     "JUMPIFEQ $substr_ret LF@check bool@false\n");
-  dynstr_append_str(active_buffer, "SUB LF@i LF@i int@1\n");
-  dynstr_append_str(active_buffer, "LT LF@check LF@i LF@j\n");
-  dynstr_append_str(active_buffer,
+  dynstr_append_str(&builtin_buffer, "SUB LF@i LF@i int@1\n");
+  dynstr_append_str(&builtin_buffer, "LT LF@check LF@i LF@j\n");
+  dynstr_append_str(&builtin_buffer,
                     "JUMPIFEQ $substr_ret LF@check bool@false\n");
-  dynstr_append_str(active_buffer, "DEFVAR LF@strlen\n");
-  dynstr_append_str(active_buffer, "STRLEN LF@strlen LF@str\n");
-  dynstr_append_str(active_buffer, "ADD LF@strlen LF@strlen int@1\n");
-  dynstr_append_str(active_buffer, "LT LF@check LF@j LF@strlen\n");
-  dynstr_append_str(active_buffer,
+  dynstr_append_str(&builtin_buffer, "DEFVAR LF@strlen\n");
+  dynstr_append_str(&builtin_buffer, "STRLEN LF@strlen LF@str\n");
+  dynstr_append_str(&builtin_buffer, "ADD LF@strlen LF@strlen int@1\n");
+  dynstr_append_str(&builtin_buffer, "LT LF@check LF@j LF@strlen\n");
+  dynstr_append_str(&builtin_buffer,
                     "JUMPIFEQ $substr_ret LF@check bool@false\n");
 
-  dynstr_append_str(active_buffer, "LABEL $substr_loop\n");
-  dynstr_append_str(active_buffer, "GETCHAR LF@newchar LF@str LF@i\n");
-  dynstr_append_str(active_buffer, "CONCAT LF@out LF@out LF@newchar\n");
-  dynstr_append_str(active_buffer, "ADD LF@i LF@i int@1\n");
-  dynstr_append_str(active_buffer, "JUMPIFNEQ $substr_loop LF@i LF@j\n");
+  dynstr_append_str(&builtin_buffer, "LABEL $substr_loop\n");
+  dynstr_append_str(&builtin_buffer, "GETCHAR LF@newchar LF@str LF@i\n");
+  dynstr_append_str(&builtin_buffer, "CONCAT LF@out LF@out LF@newchar\n");
+  dynstr_append_str(&builtin_buffer, "ADD LF@i LF@i int@1\n");
+  dynstr_append_str(&builtin_buffer, "JUMPIFNEQ $substr_loop LF@i LF@j\n");
 
-  dynstr_append_str(active_buffer, "LABEL $substr_ret\n");
+  dynstr_append_str(&builtin_buffer, "LABEL $substr_ret\n");
 
-  dynstr_append_str(active_buffer, "PUSHS LF@out\n");
-  dynstr_append_str(active_buffer, "POPFRAME\n");
-  dynstr_append_str(active_buffer, "RETURN\n");
-  dynstr_append_str(active_buffer, "LABEL $substr_end\n");
+  dynstr_append_str(&builtin_buffer, "PUSHS LF@out\n");
+  dynstr_append_str(&builtin_buffer, "POPFRAME\n");
+  dynstr_append_str(&builtin_buffer, "RETURN\n");
+  dynstr_append_str(&builtin_buffer, "LABEL $substr_end\n");
 }
 
 bool ord_defined = false;
@@ -523,31 +1761,31 @@ void codegen_ord_define() {
   if (ord_defined) return;
   ord_defined = true;
 
-  dynstr_append_str(active_buffer, "JUMP $ord_end\n");
-  dynstr_append_str(active_buffer, "LABEL $ord\n");
-  dynstr_append_str(active_buffer, "PUSHFRAME\n");
+  dynstr_append_str(&builtin_buffer, "JUMP $ord_end\n");
+  dynstr_append_str(&builtin_buffer, "LABEL $ord\n");
+  dynstr_append_str(&builtin_buffer, "PUSHFRAME\n");
 
-  dynstr_append_str(active_buffer, "DEFVAR LF@out\n");
-  dynstr_append_str(active_buffer, "MOVE LF@out nil@nil\n");
+  dynstr_append_str(&builtin_buffer, "DEFVAR LF@out\n");
+  dynstr_append_str(&builtin_buffer, "MOVE LF@out nil@nil\n");
 
-  dynstr_append_str(active_buffer, "DEFVAR LF@check\n");
-  dynstr_append_str(active_buffer, "LT LF@check int@0 LF@i\n");
-  dynstr_append_str(active_buffer, "JUMPIFEQ $ord_ret LF@check bool@false\n");
-  dynstr_append_str(active_buffer, "DEFVAR LF@strlen\n");
-  dynstr_append_str(active_buffer, "STRLEN LF@strlen LF@str\n");
-  dynstr_append_str(active_buffer, "ADD LF@strlen LF@strlen int@1\n");
-  dynstr_append_str(active_buffer, "LT LF@check LF@i LF@strlen\n");
-  dynstr_append_str(active_buffer, "JUMPIFEQ $ord_ret LF@check bool@false\n");
+  dynstr_append_str(&builtin_buffer, "DEFVAR LF@check\n");
+  dynstr_append_str(&builtin_buffer, "LT LF@check int@0 LF@i\n");
+  dynstr_append_str(&builtin_buffer, "JUMPIFEQ $ord_ret LF@check bool@false\n");
+  dynstr_append_str(&builtin_buffer, "DEFVAR LF@strlen\n");
+  dynstr_append_str(&builtin_buffer, "STRLEN LF@strlen LF@str\n");
+  dynstr_append_str(&builtin_buffer, "ADD LF@strlen LF@strlen int@1\n");
+  dynstr_append_str(&builtin_buffer, "LT LF@check LF@i LF@strlen\n");
+  dynstr_append_str(&builtin_buffer, "JUMPIFEQ $ord_ret LF@check bool@false\n");
 
-  dynstr_append_str(active_buffer, "SUB LF@i LF@i int@1\n");
-  dynstr_append_str(active_buffer, "STRI2INT LF@out LF@str LF@i\n");
+  dynstr_append_str(&builtin_buffer, "SUB LF@i LF@i int@1\n");
+  dynstr_append_str(&builtin_buffer, "STRI2INT LF@out LF@str LF@i\n");
 
-  dynstr_append_str(active_buffer, "LABEL $ord_ret\n");
-  dynstr_append_str(active_buffer, "PUSHS LF@out\n");
+  dynstr_append_str(&builtin_buffer, "LABEL $ord_ret\n");
+  dynstr_append_str(&builtin_buffer, "PUSHS LF@out\n");
 
-  dynstr_append_str(active_buffer, "POPFRAME\n");
-  dynstr_append_str(active_buffer, "RETURN\n");
-  dynstr_append_str(active_buffer, "LABEL $ord_end\n");
+  dynstr_append_str(&builtin_buffer, "POPFRAME\n");
+  dynstr_append_str(&builtin_buffer, "RETURN\n");
+  dynstr_append_str(&builtin_buffer, "LABEL $ord_end\n");
 }
 
 bool chr_defined = false;
@@ -556,27 +1794,27 @@ void codegen_chr_define() {
   if (chr_defined) return;
   chr_defined = true;
 
-  dynstr_append_str(active_buffer, "JUMP $chr_end\n");
-  dynstr_append_str(active_buffer, "LABEL $chr\n");
-  dynstr_append_str(active_buffer, "PUSHFRAME\n");
-
-  dynstr_append_str(active_buffer, "DEFVAR LF@cond\n");
-  dynstr_append_str(active_buffer, "DEFVAR LF@cond2\n");
-  dynstr_append_str(active_buffer, "LT LF@cond LF@i int@0\n");
-  dynstr_append_str(active_buffer, "GT LF@cond2 LF@i int@255\n");
-  dynstr_append_str(active_buffer, "OR LF@cond LF@cond LF@cond2\n");
-
-  dynstr_append_str(active_buffer, "JUMPIFEQ $chr_expr LF@cond bool@false\n");
-  dynstr_append_str(active_buffer, "PUSHS nil@nil\n");
-  dynstr_append_str(active_buffer, "JUMP $chr_ret\n");
-  dynstr_append_str(active_buffer, "LABEL $chr_expr\n");
-  dynstr_append_str(active_buffer, "PUSHS LF@i\n");
-  dynstr_append_str(active_buffer, "INT2CHARS\n");
-  dynstr_append_str(active_buffer, "LABEL $chr_ret\n");
-
-  dynstr_append_str(active_buffer, "POPFRAME\n");
-  dynstr_append_str(active_buffer, "RETURN\n");
-  dynstr_append_str(active_buffer, "LABEL $chr_end\n");
+  dynstr_append_str(&builtin_buffer, "JUMP $chr_end\n");
+  dynstr_append_str(&builtin_buffer, "LABEL $chr\n");
+  dynstr_append_str(&builtin_buffer, "PUSHFRAME\n");
+
+  dynstr_append_str(&builtin_buffer, "DEFVAR LF@cond\n");
+  dynstr_append_str(&builtin_buffer, "DEFVAR LF@cond2\n");
+  dynstr_append_str(&builtin_buffer, "LT LF@cond LF@i int@0\n");
+  dynstr_append_str(&builtin_buffer, "GT LF@cond2 LF@i int@255\n");
+  dynstr_append_str(&builtin_buffer, "OR LF@cond LF@cond LF@cond2\n");
+
+  dynstr_append_str(&builtin_buffer, "JUMPIFEQ $chr_expr LF@cond bool@false\n");
+  dynstr_append_str(&builtin_buffer, "PUSHS nil@nil\n");
+  dynstr_append_str(&builtin_buffer, "JUMP $chr_ret\n");
+  dynstr_append_str(&builtin_buffer, "LABEL $chr_expr\n");
+  dynstr_append_str(&builtin_buffer, "PUSHS LF@i\n");
+  dynstr_append_str(&builtin_buffer, "INT2CHARS\n");
+  dynstr_append_str(&builtin_buffer, "LABEL $chr_ret\n");
+
+  dynstr_append_str(&builtin_buffer, "POPFRAME\n");
+  dynstr_append_str(&builtin_buffer, "RETURN\n");
+  dynstr_append_str(&builtin_buffer, "LABEL $chr_end\n");
 }
 
 bool tointeger_defined = false;
@@ -585,19 +1823,525 @@ void codegen_tointeger_define() {
   if (tointeger_defined) return;
   tointeger_defined = true;
 
-  dynstr_append_str(active_buffer, "JUMP $tointeger_end\n");
-  dynstr_append_str(active_buffer, "LABEL $tointeger\n");
-  dynstr_append_str(active_buffer, "PUSHFRAME\n");
+  dynstr_append_str(&builtin_buffer, "JUMP $tointeger_end\n");
+  dynstr_append_str(&builtin_buffer, "LABEL $tointeger\n");
+  dynstr_append_str(&builtin_buffer, "PUSHFRAME\n");
+
+  dynstr_append_str(&builtin_buffer, "JUMPIFNEQ $tointeger_expr LF@n nil@nil\n");
+  dynstr_append_str(&builtin_buffer, "PUSHS nil@nil\n");
+  dynstr_append_str(&builtin_buffer, "JUMP $tointeger_ret\n");
+  dynstr_append_str(&builtin_buffer, "LABEL $tointeger_expr\n");
+  dynstr_append_str(&builtin_buffer, "PUSHS LF@n\n");
+  dynstr_append_str(&builtin_buffer, "FLOAT2INTS\n");
+  dynstr_append_str(&builtin_buffer, "LABEL $tointeger_ret\n");
+
+  dynstr_append_str(&builtin_buffer, "POPFRAME\n");
+  dynstr_append_str(&builtin_buffer, "RETURN\n");
+  dynstr_append_str(&builtin_buffer, "LABEL $tointeger_end\n");
+}
 
-  dynstr_append_str(active_buffer, "JUMPIFNEQ $tointeger_expr LF@n nil@nil\n");
-  dynstr_append_str(active_buffer, "PUSHS nil@nil\n");
-  dynstr_append_str(active_buffer, "JUMP $tointeger_ret\n");
-  dynstr_append_str(active_buffer, "LABEL $tointeger_expr\n");
-  dynstr_append_str(active_buffer, "PUSHS LF@n\n");
-  dynstr_append_str(active_buffer, "FLOAT2INTS\n");
-  dynstr_append_str(active_buffer, "LABEL $tointeger_ret\n");
+void codegen_program(const ast_node_t* program, int jobs) {
+  codegen_inlined = 0;
+  licm_store_count = 0;
+  codegen_licm_collect(program);
+  if (error_get()) {
+    codegen_licm_stores_free();
+    return;
+  }
+  if (licm_store_count) {
+    qsort(licm_stores, licm_store_count, sizeof(codegen_store_t),
+          codegen_licm_store_compare);
+  }
 
-  dynstr_append_str(active_buffer, "POPFRAME\n");
-  dynstr_append_str(active_buffer, "RETURN\n");
-  dynstr_append_str(active_buffer, "LABEL $tointeger_end\n");
+  int count = 0;
+  for (const ast_node_t* node = program; node; node = node->next) {
+    count += node->kind == AST_FUNCTION;
+  }
+
+  pool_chunks = calloc(count ? count : 1, sizeof(codegen_chunk_t));
+  if (!pool_chunks) {
+    error_set(EXITSTATUS_INTERNAL_ERROR);
+    codegen_licm_stores_free();
+    return;
+  }
+  pool_count = 0;
+  pool_next = 0;
+  for (const ast_node_t* node = program; node; node = node->next) {
+    if (node->kind == AST_FUNCTION) {
+      pool_chunks[pool_count].func = node;
+      pool_chunks[pool_count].index = pool_count + 1;
+      dynstr_init(&pool_chunks[pool_count].code);
+      pool_count++;
+    }
+  }
+
+  if (jobs <= 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = online > 0 ? (int)online : 1;
+  }
+  if (jobs > CODEGEN_MAX_JOBS) {
+    jobs = CODEGEN_MAX_JOBS;
+  }
+  if (jobs > count) {
+    jobs = count;
+  }
+
+  // the calling thread is one of the workers, others are spawned
+  pthread_t threads[CODEGEN_MAX_JOBS];
+  int spawned = 0;
+  while (spawned + 1 < jobs &&
+         !pthread_create(&threads[spawned], NULL, codegen_worker_thread,
+                         NULL)) {
+    spawned++;
+  }
+  codegen_worker();
+  for (int i = 0; i < spawned; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  // join chunks in order of the program, top level code is generated now
+  error_clear();
+  codegen_chunk_begin(0);
+  int next = 0;
+  for (const ast_node_t* node = program; node && !error_get();
+       node = node->next) {
+    if (node->kind != AST_FUNCTION) {
+      codegen_statement(node);
+      codegen_builtin_define(builtin_calls, builtin_call_count);
+      builtin_call_count = 0;
+      continue;
+    }
+
+    codegen_chunk_t* chunk = &pool_chunks[next++];
+    if (chunk->error) {
+      error_set(chunk->error);
+      break;
+    }
+    dynstr_append_str(&main_buffer, chunk->code.str);
+    codegen_builtin_define(chunk->builtins, chunk->builtin_count);
+    codegen_inlined += chunk->inlined;
+  }
+
+  for (int i = 0; i < pool_count; i++) {
+    dynstr_free_buffer(&pool_chunks[i].code);
+  }
+  free(pool_chunks);
+  pool_chunks = NULL;
+  codegen_licm_stores_free();
+}
+
+void codegen_worker() {
+  for (;;) {
+    pthread_mutex_lock(&pool_lock);
+    int next = pool_next < pool_count ? pool_next++ : -1;
+    pthread_mutex_unlock(&pool_lock);
+    if (next < 0) {
+      break;
+    }
+    codegen_chunk_generate(&pool_chunks[next]);
+  }
+}
+
+void* codegen_worker_thread(void* arg) {
+  codegen_thread_init();
+  if (!error_get()) {
+    codegen_worker();
+  }
+  codegen_thread_free();
+  return arg;
+}
+
+void codegen_chunk_begin(int index) {
+  label_namespace = index;
+  idmax = -1;
+  iddepth = -1;
+  writeskip = 0;
+  builtin_call_count = 0;
+  inline_count = 0;
+}
+
+void codegen_chunk_generate(codegen_chunk_t* chunk) {
+  error_clear();
+  scope_info_t* scope = scope_info;
+  scope_init();
+  codegen_chunk_begin(chunk->index);
+
+  // code of the function is what the thread appends to its main buffer
+  dynstr_t code = main_buffer;
+  main_buffer = chunk->code;
+  active_buffer = &main_buffer;
+  codegen_function_definition(chunk->func);
+  chunk->code = main_buffer;
+  main_buffer = code;
+  active_buffer = &main_buffer;
+
+  memcpy(chunk->builtins, builtin_calls, sizeof(builtin_calls));
+  chunk->builtin_count = builtin_call_count;
+  chunk->inlined = inline_count;
+  chunk->error = error_get();
+  scope_destroy();
+  scope_info = scope;
+}
+
+void codegen_builtin_call(symtab_builtin_t builtin) {
+  // builtins called only by discarded code are not defined
+  if (discard_depth > 0) {
+    return;
+  }
+
+  for (int i = 0; i < builtin_call_count; i++) {
+    if (builtin_calls[i] == builtin) {
+      return;
+    }
+  }
+  builtin_calls[builtin_call_count++] = builtin;
+}
+
+void codegen_builtin_define(const symtab_builtin_t* builtins, int count) {
+  for (int i = 0; i < count; i++) {
+    switch (builtins[i]) {
+      case BUILTIN_TOINTEGER:
+        codegen_tointeger_define();
+        break;
+      case BUILTIN_SUBSTR:
+        codegen_substr_define();
+        break;
+      case BUILTIN_ORD:
+        codegen_ord_define();
+        break;
+      case BUILTIN_CHR:
+        codegen_chr_define();
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void codegen_block(const ast_node_t* node) {
+  for (; node && !error_get(); node = node->next) {
+    if (!codegen_tail_call_is(node)) {
+      codegen_statement(node);
+      continue;
+    }
+
+    codegen_tail_call(node->kind == AST_CALL ? node : node->call);
+    // return of the results is replaced by the jump too
+    if (node->next) {
+      node = node->next;
+    }
+  }
+}
+
+void codegen_statement(const ast_node_t* node) {
+  exptree_truth_t truth;
+  int hoisted;
+  switch (node->kind) {
+    case AST_FUNCTION:
+      codegen_function_definition(node);
+      break;
+    case AST_CALL:
+      codegen_call(node);
+      break;
+    case AST_LOCAL:
+      codegen_define_var(node->name, 0);
+      if (node->values || node->call) {
+        codegen_values(node);
+        codegen_assign_expression_add(node->name, 0);
+        codegen_assign_expression_finish(1);
+      } else if (codegen_first_access(node->next, node->name) ==
+                 CODEGEN_ACCESS_READ) {
+        // nil again whenever the declaration runs, in loops too
+        dynstr_append_str(active_buffer, "MOVE LF@");
+        dynstr_append_str(active_buffer, scope_get_correct_id(node->name, 0));
+        dynstr_append_str(active_buffer, " nil@nil\n");
+      }
+      break;
+    case AST_ASSIGN:
+      for (ast_expr_t* id = node->ids; id; id = id->next) {
+        codegen_assign_expression_add(id->tree->value.str, id->tree->lvl);
+      }
+      codegen_values(node);
+      codegen_assign_expression_finish(node->value_count);
+      break;
+    case AST_RETURN:
+      codegen_values(node);
+      if (!inline_func) {
+        codegen_function_return(node->ret_count, node->value_count);
+        break;
+      }
+      for (int i = node->value_count; i < node->ret_count; i++) {
+        dynstr_append_str(active_buffer, "PUSHS nil@nil\n");
+      }
+      // last statement of inlined body continues at its end anyway
+      if (node->next || node->parent != inline_func) {
+        dynstr_append_str(active_buffer, "JUMP ");
+        codegen_label_name("$inline_end_", inline_label);
+        dynstr_append_str(active_buffer, "\n");
+        inline_returned = true;
+      }
+      break;
+    case AST_IF:
+      truth = codegen_if_begin(node->cond, node->type);
+      scope_new_if();
+      codegen_block(node->body);
+      codegen_if_else(truth);
+      scope_pop_item();  // else
+      scope_new_if();
+      codegen_block(node->else_body);
+      codegen_if_end(truth);
+      scope_pop_item();  // end if
+      break;
+    case AST_WHILE:
+      hoisted = codegen_licm_begin(node);
+      truth = codegen_while_begin(node->cond, node->type);
+      scope_new_while();
+      codegen_block(node->body);
+      // condition is tested again in the scope of the loop
+      scope_pop_item();
+      codegen_while_end(node->cond, node->type, truth);
+      codegen_licm_end(hoisted);
+      break;
+  }
+}
+
+void codegen_function_definition(const ast_node_t* node) {
+  codegen_function_definition_begin(node->name);
+  int argpos = 0;
+  for (ast_expr_t* param = node->ids; param; param = param->next) {
+    codegen_function_definition_param(param->tree->value.str, argpos++);
+  }
+  codegen_function_definition_body();
+
+  tail_func = node;
+  if (!codegen_tail_calls(node->body)) {
+    tail_func = NULL;
+  }
+  if (tail_func) {
+    dynstr_append_str(active_buffer, "LABEL $tailfn_");
+    dynstr_append_str(active_buffer, node->name);
+    dynstr_append_str(active_buffer, "\n");
+  }
+  codegen_block(node->body);
+  tail_func = NULL;
+  codegen_function_definition_end(node->name, node->ret_count);
+}
+
+void codegen_call(const ast_node_t* node) {
+  // code outside of functions has no frame for variables of the body
+  if (codegen_inlining && node->def && label_namespace > 0 && !inline_func &&
+      codegen_inline_cost(node->def->body) <= CODEGEN_INLINE_MAX_COST) {
+    codegen_inline(node);
+    return;
+  }
+
+  codegen_function_call_begin(node->func);
+  int argpos = 0;
+  for (ast_expr_t* arg = node->ids; arg; arg = arg->next) {
+    codegen_function_call_argument(arg->tree, argpos++);
+  }
+  codegen_function_call_do(node->func);
+}
+
+void codegen_values(const ast_node_t* node) {
+  if (node->call) {
+    codegen_call(node->call);
+    return;
+  }
+
+  for (ast_expr_t* value = node->values; value; value = value->next) {
+    codegen_expression(value->tree);
+    if (value->to_number) {
+      codegen_cast_int_to_float1();
+    }
+  }
+}
+
+int codegen_inline_cost(const ast_node_t* node) {
+  int cost = 0;
+  for (; node && cost <= CODEGEN_INLINE_MAX_COST; node = node->next) {
+    const ast_node_t* call = node->kind == AST_CALL ? node : node->call;
+    if (call && (!call->func || call->func->builtin == BUILTIN_NONE)) {
+      return CODEGEN_INLINE_MAX_COST + 1;
+    }
+
+    cost += 1 + codegen_tree_cost(node->cond);
+    for (ast_expr_t* expr = node->ids; expr; expr = expr->next) {
+      cost++;
+    }
+    for (ast_expr_t* expr = node->values; expr; expr = expr->next) {
+      cost += codegen_tree_cost(expr->tree);
+    }
+    if (node->call) {
+      cost += codegen_inline_cost(node->call);
+    }
+    cost += codegen_inline_cost(node->body);
+    cost += codegen_inline_cost(node->else_body);
+  }
+  return cost;
+}
+
+int codegen_tree_cost(const exptree_node_t* node) {
+  if (!node) {
+    return 0;
+  }
+  return 1 + codegen_tree_cost(node->left) + codegen_tree_cost(node->right);
+}
+
+void codegen_inline(const ast_node_t* call) {
+  const ast_node_t* func = call->def;
+
+  // arguments are in scope of the caller, parameters pop them
+  for (ast_expr_t* arg = call->ids; arg; arg = arg->next) {
+    codegen_expression_push_value(arg->tree);
+  }
+  codegen_cse_clear();
+  codegen_inline_swap();
+  inline_func = func;
+  inline_label = ++idmax;
+  inline_returned = false;
+  scope_new_inline();
+  codegen_inline_params(func->ids);
+
+  codegen_block(func->body);
+  const ast_node_t* last = func->body;
+  while (last && last->next) {
+    last = last->next;
+  }
+  if (!last || last->kind != AST_RETURN) {
+    for (int i = 0; i < func->ret_count; i++) {
+      dynstr_append_str(active_buffer, "PUSHS nil@nil\n");
+    }
+  }
+  if (inline_returned) {
+    dynstr_append_str(active_buffer, "LABEL ");
+    codegen_label_name("$inline_end_", inline_label);
+    dynstr_append_str(active_buffer, "\n");
+  }
+
+  scope_pop_item();
+  codegen_cse_clear();
+  codegen_inline_swap();
+  inline_func = NULL;
+  inline_count++;
+}
+
+void codegen_inline_swap() {
+  dynstr_t buffer = expression_assign_buffer;
+  expression_assign_buffer = inline_assign_buffer;
+  inline_assign_buffer = buffer;
+
+  dynstr_t assigned = cse_assigned;
+  cse_assigned = inline_assigned;
+  inline_assigned = assigned;
+
+  // statements of the body finish their assignments
+  int count = expression_assign_count;
+  expression_assign_count = inline_assign_count;
+  inline_assign_count = count;
+}
+
+void codegen_inline_params(const ast_expr_t* param) {
+  if (!param) {
+    return;
+  }
+
+  // last argument is on top of the stack
+  codegen_inline_params(param->next);
+  char* name = param->tree->value.str;
+  codegen_define_var(name, 0);
+  dynstr_append_str(active_buffer, "POPS LF@");
+  dynstr_append_str(active_buffer, scope_get_correct_id(name, 0));
+  dynstr_append_str(active_buffer, "\n");
+}
+
+bool codegen_tail_call_is(const ast_node_t* node) {
+  const ast_node_t* call = node->kind == AST_CALL ? node : node->call;
+  if (!tail_func || !call || call->func != tail_func->func || inline_func) {
+    return false;
+  }
+  if (node->kind == AST_CALL) {
+    // results of the call are dropped, not returned
+    return tail_func->ret_count == 0 && codegen_tail_position(node);
+  }
+
+  const ast_node_t* ret = node->next;
+  if (!ret || ret->kind != AST_RETURN ||
+      ret->value_count != tail_func->ret_count) {
+    return false;
+  }
+
+  // returned values are the assigned variables in the same order
+  ast_expr_t local = {NULL, false, NULL};
+  exptree_node_t leaf = {.value.str = node->name, .lvl = 0};
+  const ast_expr_t* ids = node->ids;
+  if (node->kind == AST_LOCAL) {
+    local.tree = &leaf;
+    ids = &local;
+  }
+  const ast_expr_t* id = ids;
+  const ast_expr_t* value = ret->values;
+  for (; id && value; id = id->next, value = value->next) {
+    if (value->to_number || value->tree->kind != EXP_ID ||
+        value->tree->lvl != id->tree->lvl ||
+        strcmp(value->tree->value.str, id->tree->value.str)) {
+      return false;
+    }
+    // variable assigned twice keeps only one of the results
+    for (const ast_expr_t* prev = ids; prev != id; prev = prev->next) {
+      if (prev->tree->lvl == id->tree->lvl &&
+          !strcmp(prev->tree->value.str, id->tree->value.str)) {
+        return false;
+      }
+    }
+  }
+  return !id && !value;
+}
+
+bool codegen_tail_position(const ast_node_t* node) {
+  for (;;) {
+    if (node->next) {
+      return node->next->kind == AST_RETURN && !node->next->value_count;
+    }
+    if (node->parent == tail_func) {
+      return true;
+    }
+    if (!node->parent || node->parent->kind != AST_IF) {
+      return false;
+    }
+    node = node->parent;
+  }
+}
+
+bool codegen_tail_calls(const ast_node_t* node) {
+  for (; node; node = node->next) {
+    if (codegen_tail_call_is(node) || codegen_tail_calls(node->body) ||
+        codegen_tail_calls(node->else_body)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void codegen_tail_call(const ast_node_t* call) {
+  // all arguments are read before any parameter is assigned
+  for (ast_expr_t* arg = call->ids; arg; arg = arg->next) {
+    codegen_expression_push_value(arg->tree);
+  }
+  codegen_tail_params(tail_func->ids);
+  dynstr_append_str(active_buffer, "JUMP $tailfn_");
+  dynstr_append_str(active_buffer, tail_func->name);
+  dynstr_append_str(active_buffer, "\n");
+}
+
+void codegen_tail_params(const ast_expr_t* param) {
+  if (!param) {
+    return;
+  }
+
+  // last argument is on top of the stack
+  codegen_tail_params(param->next);
+  dynstr_append_str(active_buffer, "POPS LF@");
+  dynstr_append_str(active_buffer, param->tree->value.str);
+  dynstr_append_str(active_buffer, "\n");
 }
@@ -12,8 +12,80 @@
 #ifndef __CODEGEN_H
 #define __CODEGEN_H
 
+#include "ast.h"
+#include "dynstr.h"
+#include "errors.h"
+#include "exptree.h"
 #include "parser.h"
 
+/** Maximal number of threads generating code of functions */
+#define CODEGEN_MAX_JOBS 64
+
+/** Number of kinds of builtin functions */
+#define CODEGEN_BUILTIN_COUNT (BUILTIN_CHR + 1)
+
+/** Maximal size of inlined function body, in statements and operands */
+#define CODEGEN_INLINE_MAX_COST 32
+
+/** Maximal number of values remembered in a basic block */
+#define CODEGEN_CSE_MAX_VALUES 256
+
+/** Maximal number of values hoisted out of the loops being generated */
+#define CODEGEN_LICM_MAX_VALUES 64
+
+/** Maximal number of variables known not to be nil before a loop */
+#define CODEGEN_LICM_MAX_PROVEN 32
+
+/**
+ * Value of expression saved in a $cse variable, reused while
+ * the block continues and none of its operands is assigned
+ */
+typedef struct {
+  exptree_node_t* node;  ///< Copy of the computation
+  int var;               ///< Number of the $cse variable
+} codegen_cse_value_t;
+
+/** Slot of table counting occurrences of subtrees in an expression */
+typedef struct {
+  const exptree_node_t* node;  ///< First occurrence
+  int occurs;                  ///< Number of occurrences
+  int gen;                     ///< Expression the slot belongs to
+} codegen_cse_slot_t;
+
+/** Variable declared or assigned by a statement of the program */
+typedef struct {
+  const char* name;  ///< Name of the variable
+  int index;         ///< Position of the statement
+} codegen_store_t;
+
+/**
+ * Code of function definition generated by a worker thread, labels
+ * are numbered in namespace of the function so chunks can be joined
+ */
+typedef struct {
+  const ast_node_t* func;  ///< Function definition
+  int index;               ///< Namespace of labels, from 1
+  dynstr_t code;           ///< Generated code
+  /// Builtin functions called, in order of first call
+  symtab_builtin_t builtins[CODEGEN_BUILTIN_COUNT];
+  int builtin_count;    ///< Number of called builtin functions
+  int inlined;          ///< Number of inlined calls
+  exit_status_t error;  ///< Error of generation, EXITSTATUS_OK if none
+} codegen_chunk_t;
+
+/** First access to a declared variable on the paths through a block */
+typedef enum {
+  CODEGEN_ACCESS_NONE,      ///< Not accessed before the block falls through
+  CODEGEN_ACCESS_READ,      ///< Can be read before it is assigned
+  CODEGEN_ACCESS_ASSIGNED,  ///< Assigned, or out of scope, before any read
+} codegen_access_t;
+
+/** Are calls of small leaf functions inlined? */
+extern bool codegen_inlining;
+
+/** Number of calls inlined by codegen_program */
+extern int codegen_inlined;
+
 /** Init codegen */
 void codegen_init();
 
@@ -21,13 +93,13 @@ void codegen_init();
 void codegen_free();
 
 /** Begin a function call procedure */
-void codegen_function_call_begin(char* name);
+void codegen_function_call_begin(symtab_func_data_t* func);
 
 /** Save function arguments to a variable on TF */
-void codegen_function_call_argument(token_t* token, int argpos, int lvl);
+void codegen_function_call_argument(const exptree_node_t* arg, int argpos);
 
 /** Execute the function call */
-void codegen_function_call_do(char* name);
+void codegen_function_call_do(symtab_func_data_t* func);
 
 /** Begin a function definition */
 void codegen_function_definition_begin(char* name);
@@ -44,7 +116,14 @@ void codegen_function_definition_end(char* name, int ret_count);
 /** Return from a function */
 void codegen_function_return(int ret_count, int exp_count);
 
-void codegen_expression_push_value(token_t* token, int lvl);
+/** Push value of expression tree leaf */
+void codegen_expression_push_value(const exptree_node_t* node);
+
+/** Append symbol of expression tree leaf without newline */
+void codegen_expression_symbol(const exptree_node_t* node);
+
+/** Generate code of whole expression tree, result is left on the stack */
+void codegen_expression(const exptree_node_t* node);
 
 /** Mathematical operations */
 void codegen_expression_plus();
@@ -55,6 +134,8 @@ void codegen_expression_divint();
 
 /** String operations */
 void codegen_expression_concat();
+/** Concatenate chain of literals and variables in one temp var */
+void codegen_expression_concat_chain(const exptree_node_t* node);
 void codegen_expression_strlen();
 
 /** Logical operations */
@@ -70,24 +151,61 @@ void codegen_cast_int_to_float1();
 void codegen_cast_int_to_float2();
 void codegen_cast_float_to_int1();
 void codegen_cast_float_to_int2();
-void codegen_not_nil();
 
-/** Define a variable */
+/** Define a variable in the frame of the function being generated */
 void codegen_define_var(char* old_id, int lvl);
+
+/**
+ * First access to variable by the statements following its declaration.
+ * Declarations of the same name in nested blocks count as reads
+ */
+codegen_access_t codegen_first_access(const ast_node_t* node,
+                                      const char* name);
+
+/** Access to variable by one statement, nested blocks included */
+codegen_access_t codegen_statement_access(const ast_node_t* node,
+                                          const char* name);
+
+/** Does expression read variable of the name? Tree can be NULL */
+bool codegen_tree_reads(const exptree_node_t* node, const char* name);
+
+/** Does any expression of the list read variable of the name? */
+bool codegen_exprs_read(const ast_expr_t* expr, const char* name);
 /** Add a new variable that is being assigned to */
 void codegen_assign_expression_add(char* id, int lvl);
 /** Complete assignment */
 void codegen_assign_expression_finish(int count);
 
-/** If-then-else blocks */
-void codegen_if_begin();
-void codegen_if_else();
-void codegen_if_end();
+/** Push unique label ID of a new nested block, stack grows as needed */
+void codegen_label_push();
+
+/** Drop code generated until matching end, blocks can be nested */
+void codegen_discard_begin();
+void codegen_discard_end();
+
+/**
+ * If-then-else blocks, branch never taken is dropped. Condition is
+ * tested unless its truth is known, the truth is returned for the rest
+ */
+exptree_truth_t codegen_if_begin(const exptree_node_t* cond, char type);
+void codegen_if_else(exptree_truth_t truth);
+void codegen_if_end(exptree_truth_t truth);
 
-/** While */
-void codegen_while_begin();
-void codegen_while_expr();
-void codegen_while_end();
+/**
+ * While, loop never entered is dropped, condition is tested as in if.
+ * Condition is tested before the first pass and again at the end of
+ * the body, which branches back while it holds
+ */
+exptree_truth_t codegen_while_begin(const exptree_node_t* cond, char type);
+void codegen_while_end(const exptree_node_t* cond, char type,
+                       exptree_truth_t truth);
+
+/**
+ * Generate code of the whole program from its tree. Functions are
+ * generated by a pool of threads and joined in order of the program
+ * @param jobs Maximal number of threads, number of processors if 0
+ */
+void codegen_program(const ast_node_t* program, int jobs);
 
 /** Builtin functions */
 void codegen_ord_define();
@@ -93,12 +93,27 @@ dynstr_t* dynstr_append(dynstr_t *dynstr, char c) {
 }
 
 dynstr_t *dynstr_append_str(dynstr_t *dynstr, char *str) {
-  char c;
-  int i = 0;
-  while ((c = str[i])) {
-    dynstr_append(dynstr, c);
-    i++;
+  if (dynstr == NULL || dynstr->str == NULL) {
+    return NULL;
+  }
+
+  // grow the same way as appending char by char, but copy at once
+  size_t len = strlen(str);
+  size_t new_buf_size = dynstr->alloced_bytes;
+  while (dynstr->len + len >= new_buf_size) {
+    new_buf_size *= REALLOC_FAC;
   }
+  if (new_buf_size != dynstr->alloced_bytes) {
+    char *tmp = realloc(dynstr->str, sizeof(char) * new_buf_size);
+    if (tmp == NULL) { // realloc failed
+      return NULL;
+    }
+    dynstr->str = tmp;
+    dynstr->alloced_bytes = new_buf_size;
+  }
+
+  memcpy(dynstr->str + dynstr->len, str, len + 1);
+  dynstr->len += len;
 
   return dynstr;
 }
@@ -132,7 +147,7 @@ dynstr_t* dynstr_append_double(dynstr_t *dynstr, double f) {
 }
 
 dynstr_t* dynstr_append_esc(dynstr_t *dynstr, char c) {
-  char esc_buf[4]; // eg. 032, 092
+  char esc_buf[5]; // eg. 032, 092
 
   sprintf(esc_buf, "%03d", c);
 
@@ -11,9 +11,10 @@
 
 #include <stdio.h>
 #include "errors.h"
+#include "other.h"
 
 
-err_t global_error = {EXITSTATUS_OK, true};
+THREAD_LOCAL err_t global_error = {EXITSTATUS_OK, true};
 
 
 
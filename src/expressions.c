@@ -134,7 +134,8 @@ const expression_precedence_t precedence_table[9][9] = {
     },
 };
 
-bool expression_process(symbol_stack_t *stack, char *exp_type);
+bool expression_process(symbol_stack_t *stack, char *exp_type,
+                        exptree_node_t **tree);
 expression_symbol_t expression_get_input();
 char expression_get_type();
 void expression_next_input();
@@ -191,315 +192,379 @@ bool expression_token_is_zero() {
   return false;
 }
 
+#define SYMBOL_STACK_INIT_SIZE 32
+
+// Symbol stack shared by all expressions
+symbol_stack_t symbol_stack = {NULL, -1, 0};
+
+// Arena of the expression tree being built
+arena_t *tree_arena;
+
+// Arena of trees of expressions compiled by expression_parse
+arena_t expression_arena = {NULL};
+
 /**
  * Push operation on symbol stack
  */
-void symbol_stack_push(symbol_stack_t **stack, expression_symbol_t sym,
-                       char type) {
-  symbol_stack_t *old_stack = *stack;
-  symbol_stack_t *new_stack = (symbol_stack_t *)malloc(sizeof(symbol_stack_t));
-  new_stack->symbol = sym;
-  new_stack->type = type;
-  new_stack->lvl = 0;
-  new_stack->is_zero = false;
-  new_stack->next = old_stack;
-  *stack = new_stack;
+void symbol_stack_push_id(symbol_stack_t *stack, expression_symbol_t sym,
+                          char type, int lvl, bool is_zero) {
+  if (stack->top + 1 >= stack->size) {
+    int new_size = stack->size ? stack->size * 2 : SYMBOL_STACK_INIT_SIZE;
+    symbol_stack_item_t *tmp =
+        realloc(stack->items, sizeof(symbol_stack_item_t) * new_size);
+    if (tmp == NULL) {
+      error_set(EXITSTATUS_INTERNAL_ERROR);
+      return;
+    }
+    stack->items = tmp;
+    stack->size = new_size;
+  }
+
+  symbol_stack_item_t *item = &stack->items[++stack->top];
+  item->symbol = sym;
+  item->type = type;
+  item->lvl = lvl;
+  item->is_zero = is_zero;
+  item->begin = 0;
+  item->node = NULL;
 }
 
 /**
  * Push operation on symbol stack
  */
-void symbol_stack_push_id(symbol_stack_t **stack, expression_symbol_t sym,
-                          char type, int lvl, bool is_zero) {
-  symbol_stack_t *old_stack = *stack;
-  symbol_stack_t *new_stack = (symbol_stack_t *)malloc(sizeof(symbol_stack_t));
-  new_stack->symbol = sym;
-  new_stack->type = type;
-  new_stack->lvl = lvl;
-  new_stack->is_zero = is_zero;
-  new_stack->next = old_stack;
-  *stack = new_stack;
+void symbol_stack_push(symbol_stack_t *stack, expression_symbol_t sym,
+                       char type) {
+  symbol_stack_push_id(stack, sym, type, 0, false);
 }
 
 /**
- * Pop operation on symbol stack
+ * Pop operation on symbol stack, multiple times
  */
-void symbol_stack_pop(symbol_stack_t **stack) {
-  symbol_stack_t *new_stack = (*stack)->next;
-  free(*stack);
-  *stack = new_stack;
+void symbol_stack_pops(symbol_stack_t *stack, int count) {
+  stack->top -= count;
 }
 
 /**
- * Pop operation on symbol stack, multiple times
+ * Get item below top of stack
+ * @param offset Number of items above the wanted one
+ * @return Item, NULL if stack is not that deep
  */
-void symbol_stack_pops(symbol_stack_t **stack, int count) {
-  for (int i = 0; i < count; i++) {
-    symbol_stack_pop(stack);
+symbol_stack_item_t *symbol_stack_peek(symbol_stack_t *stack, int offset) {
+  if (offset > stack->top) {
+    return NULL;
   }
+  return &stack->items[stack->top - offset];
 }
 
 /**
  * Get top symbol from stack (excluding E)
  */
 expression_symbol_t get_top_symbol(symbol_stack_t *stack) {
-  expression_symbol_t a;
-  symbol_stack_t *stack_curr = stack;
-  do {
-    a = stack_curr->symbol;
-    stack_curr = stack_curr->next;
-  } while (a == SYM_E && stack_curr != NULL);
-  return a;
+  int i = stack->top;
+  while (i > 0 && stack->items[i].symbol == SYM_E) {
+    i--;
+  }
+  return stack->items[i].symbol;
 }
 
-void expression_typecheck_set_error(char type1, char type2) {
-  if (type1 == TYPE_NIL || type2 == TYPE_NIL) {
-    error_set(EXITSTATUS_ERROR_UNEXPECTED_NIL);
-  } else {
-    error_set(EXITSTATUS_ERROR_SEMANTIC_TYPE_EXPR);
+#define TYPECHECK_OK(type) \
+  { type, 0, 0, EXITSTATUS_OK }
+#define TYPECHECK_CAST(type, left, right) \
+  { type, left, right, EXITSTATUS_OK }
+#define TYPECHECK_TYPE \
+  { TYPE_NONE, 0, 0, EXITSTATUS_ERROR_SEMANTIC_TYPE_EXPR }
+#define TYPECHECK_NIL \
+  { TYPE_NONE, 0, 0, EXITSTATUS_ERROR_UNEXPECTED_NIL }
+
+/**
+ * Operator classes of the type table
+ */
+typedef enum {
+  TYPECHECK_ARITH,     ///< + - *
+  TYPECHECK_DIV,       ///< /
+  TYPECHECK_DIVINT,    ///< //
+  TYPECHECK_CONCAT,    ///< ..
+  TYPECHECK_EQUALITY,  ///< == ~=
+  TYPECHECK_ORDER,     ///< < <= > >=
+} expression_typecheck_class_t;
+
+const expression_typecheck_class_t typecheck_class[] = {
+    [SYM_PLUS] = TYPECHECK_ARITH,     [SYM_MINUS] = TYPECHECK_ARITH,
+    [SYM_TIMES] = TYPECHECK_ARITH,    [SYM_DIVIDE] = TYPECHECK_DIV,
+    [SYM_DIVIDE2] = TYPECHECK_DIVINT, [SYM_DOTDOT] = TYPECHECK_CONCAT,
+    [SYM_GT] = TYPECHECK_ORDER,       [SYM_GTE] = TYPECHECK_ORDER,
+    [SYM_EQ] = TYPECHECK_EQUALITY,    [SYM_NEQ] = TYPECHECK_EQUALITY,
+    [SYM_LTE] = TYPECHECK_ORDER,      [SYM_LT] = TYPECHECK_ORDER,
+};
+
+const exptree_kind_t expression_op_kind[] = {
+    [SYM_PLUS] = EXP_PLUS,      [SYM_MINUS] = EXP_MINUS,
+    [SYM_TIMES] = EXP_MUL,      [SYM_DIVIDE] = EXP_DIV,
+    [SYM_DIVIDE2] = EXP_DIVINT, [SYM_DOTDOT] = EXP_CONCAT,
+    [SYM_GT] = EXP_GT,          [SYM_GTE] = EXP_GTE,
+    [SYM_EQ] = EXP_EQ,          [SYM_NEQ] = EXP_NEQ,
+    [SYM_LTE] = EXP_LTE,        [SYM_LT] = EXP_LT,
+};
+
+/**
+ * Type table of binary operations, indexed by operator class, type of the
+ * left and type of the right operand in order integer, number, string,
+ * nil and other (result of comparison).
+ * Nil operand of operation which does not allow it is reported as
+ * unexpected nil, other wrong types as type error.
+ */
+const expression_typerule_t typecheck_table[6][5][5] = {
+    [TYPECHECK_ARITH] =
+        {
+            {TYPECHECK_OK(TYPE_INTEGER),
+             TYPECHECK_CAST(TYPE_NUMBER, TYPE_NUMBER, 0), TYPECHECK_TYPE,
+             TYPECHECK_NIL, TYPECHECK_TYPE},
+            {TYPECHECK_CAST(TYPE_NUMBER, 0, TYPE_NUMBER),
+             TYPECHECK_OK(TYPE_NUMBER), TYPECHECK_TYPE, TYPECHECK_NIL,
+             TYPECHECK_TYPE},
+            {TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_NIL,
+             TYPECHECK_TYPE},
+            {TYPECHECK_NIL, TYPECHECK_NIL, TYPECHECK_NIL, TYPECHECK_NIL,
+             TYPECHECK_NIL},
+            {TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_NIL,
+             TYPECHECK_TYPE},
+        },
+    [TYPECHECK_DIV] =
+        {
+            {TYPECHECK_CAST(TYPE_NUMBER, TYPE_NUMBER, TYPE_NUMBER),
+             TYPECHECK_CAST(TYPE_NUMBER, TYPE_NUMBER, 0), TYPECHECK_TYPE,
+             TYPECHECK_NIL, TYPECHECK_TYPE},
+            {TYPECHECK_CAST(TYPE_NUMBER, 0, TYPE_NUMBER),
+             TYPECHECK_OK(TYPE_NUMBER), TYPECHECK_TYPE, TYPECHECK_NIL,
+             TYPECHECK_TYPE},
+            {TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_NIL,
+             TYPECHECK_TYPE},
+            {TYPECHECK_NIL, TYPECHECK_NIL, TYPECHECK_NIL, TYPECHECK_NIL,
+             TYPECHECK_NIL},
+            {TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_NIL,
+             TYPECHECK_TYPE},
+        },
+    [TYPECHECK_DIVINT] =
+        {
+            {TYPECHECK_OK(TYPE_INTEGER),
+             TYPECHECK_CAST(TYPE_INTEGER, 0, TYPE_INTEGER), TYPECHECK_TYPE,
+             TYPECHECK_NIL, TYPECHECK_TYPE},
+            {TYPECHECK_CAST(TYPE_INTEGER, TYPE_INTEGER, 0),
+             TYPECHECK_CAST(TYPE_INTEGER, TYPE_INTEGER, TYPE_INTEGER),
+             TYPECHECK_TYPE, TYPECHECK_NIL, TYPECHECK_TYPE},
+            {TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_NIL,
+             TYPECHECK_TYPE},
+            {TYPECHECK_NIL, TYPECHECK_NIL, TYPECHECK_NIL, TYPECHECK_NIL,
+             TYPECHECK_NIL},
+            {TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_NIL,
+             TYPECHECK_TYPE},
+        },
+    [TYPECHECK_CONCAT] =
+        {
+            {TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_NIL,
+             TYPECHECK_TYPE},
+            {TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_NIL,
+             TYPECHECK_TYPE},
+            {TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_OK(TYPE_STRING),
+             TYPECHECK_NIL, TYPECHECK_TYPE},
+            {TYPECHECK_NIL, TYPECHECK_NIL, TYPECHECK_NIL, TYPECHECK_NIL,
+             TYPECHECK_NIL},
+            {TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_NIL,
+             TYPECHECK_TYPE},
+        },
+    [TYPECHECK_EQUALITY] =
+        {
+            {TYPECHECK_OK(TYPE_BOOL),
+             TYPECHECK_CAST(TYPE_BOOL, TYPE_NUMBER, 0), TYPECHECK_TYPE,
+             TYPECHECK_OK(TYPE_BOOL), TYPECHECK_TYPE},
+            {TYPECHECK_CAST(TYPE_BOOL, 0, TYPE_NUMBER),
+             TYPECHECK_OK(TYPE_BOOL), TYPECHECK_TYPE, TYPECHECK_OK(TYPE_BOOL),
+             TYPECHECK_TYPE},
+            {TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_OK(TYPE_BOOL),
+             TYPECHECK_OK(TYPE_BOOL), TYPECHECK_TYPE},
+            {TYPECHECK_OK(TYPE_BOOL), TYPECHECK_OK(TYPE_BOOL),
+             TYPECHECK_OK(TYPE_BOOL), TYPECHECK_OK(TYPE_BOOL),
+             TYPECHECK_OK(TYPE_BOOL)},
+            {TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_TYPE,
+             TYPECHECK_OK(TYPE_BOOL), TYPECHECK_TYPE},
+        },
+    [TYPECHECK_ORDER] =
+        {
+            {TYPECHECK_OK(TYPE_BOOL),
+             TYPECHECK_CAST(TYPE_BOOL, TYPE_NUMBER, 0), TYPECHECK_TYPE,
+             TYPECHECK_NIL, TYPECHECK_TYPE},
+            {TYPECHECK_CAST(TYPE_BOOL, 0, TYPE_NUMBER),
+             TYPECHECK_OK(TYPE_BOOL), TYPECHECK_TYPE, TYPECHECK_NIL,
+             TYPECHECK_TYPE},
+            {TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_NIL,
+             TYPECHECK_TYPE},
+            {TYPECHECK_NIL, TYPECHECK_NIL, TYPECHECK_NIL, TYPECHECK_NIL,
+             TYPECHECK_NIL},
+            {TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_TYPE, TYPECHECK_NIL,
+             TYPECHECK_TYPE},
+        },
+};
+
+/**
+ * Get the index of type in the type table
+ * @param type Type of operand
+ * @return Index of the type in the type table
+ */
+int typecheck_table_index(char type) {
+  switch (type) {
+    case TYPE_INTEGER:
+      return 0;
+    case TYPE_NUMBER:
+      return 1;
+    case TYPE_STRING:
+      return 2;
+    case TYPE_NIL:
+      return 3;
+    default:
+      return 4;
+  }
+}
+
+const expression_typerule_t *expression_typecheck(expression_symbol_t op,
+                                                  char left, char right) {
+  return &typecheck_table[typecheck_class[op]][typecheck_table_index(left)]
+                         [typecheck_table_index(right)];
+}
+
+/**
+ * Convert operand on the stack to another type
+ */
+bool expression_cast(symbol_stack_item_t *item, char type) {
+  exptree_kind_t kind = type == TYPE_NUMBER ? EXP_INT2FLOAT : EXP_FLOAT2INT;
+  item->node = exptree_op(tree_arena, kind, type, item->node, NULL);
+  if (item->node) {
+    item->node = exptree_simplify(tree_arena, item->node);
   }
+  item->type = type;
+  return item->node != NULL;
 }
 
 /**
- * Check types for expressions with basic arithmetic operations.
+ * Build node of operation from operands, string literals are concatenated
+ * and the node is simplified
  */
-bool expression_typecheck_basic_arithmetics(char *out, char type1, char type2) {
-  if ((type1 != TYPE_NUMBER && type1 != TYPE_INTEGER) ||
-      (type2 != TYPE_NUMBER && type2 != TYPE_INTEGER)) {
-    expression_typecheck_set_error(type1, type2);
+bool expression_make_op(symbol_stack_item_t *out, exptree_kind_t kind,
+                        char type, exptree_node_t *left,
+                        exptree_node_t *right) {
+  out->node = kind == EXP_CONCAT
+                  ? exptree_concat(tree_arena, type, left, right)
+                  : exptree_op(tree_arena, kind, type, left, right);
+  if (out->node) {
+    out->node = exptree_simplify(tree_arena, out->node);
+  }
+  out->symbol = SYM_E;
+  out->type = type;
+  out->lvl = 0;
+  out->is_zero = false;
+  return out->node != NULL;
+}
+
+/**
+ * Check type of E -> #E and build its node
+ */
+bool expression_strlen(symbol_stack_item_t *out, symbol_stack_item_t *operand,
+                       size_t begin) {
+  if (operand->type != TYPE_STRING) {
+    error_set(EXITSTATUS_ERROR_SEMANTIC_TYPE_EXPR);
     return false;
   }
-  if (type1 == TYPE_INTEGER && type2 == TYPE_INTEGER) {
-    *out = TYPE_INTEGER;
-  } else {
-    *out = TYPE_NUMBER;
-    if (type1 == TYPE_INTEGER && type2 == TYPE_NUMBER) {
-      codegen_cast_int_to_float1();
-    } else if (type1 == TYPE_NUMBER && type2 == TYPE_INTEGER) {
-      codegen_cast_int_to_float2();
-    }
+  if (!expression_make_op(out, EXP_STRLEN, TYPE_INTEGER, operand->node,
+                          NULL)) {
+    return false;
   }
+  out->node->begin = begin;
   return true;
 }
 
 /**
- * Check types for expressions with basic logic operations that are nullable and
- * support strings.
+ * Check types of E -> E op E and build its node
+ * @param out Resulting E
+ * @param op Operator symbol
+ * @param s3 Left operand
+ * @param s1 Right operand
  */
-bool expression_typecheck_basic_logic_nullable(char *out, char type1,
-                                               char type2) {
-  if ((type1 == TYPE_NUMBER || type1 == TYPE_INTEGER || type1 == TYPE_NIL) &&
-      (type2 == TYPE_NUMBER || type2 == TYPE_INTEGER || type1 == TYPE_NIL)) {
-    *out = TYPE_BOOL;
-    if (type1 == TYPE_INTEGER && type2 == TYPE_NUMBER) {
-      codegen_cast_int_to_float1();
-    } else if (type1 == TYPE_NUMBER && type2 == TYPE_INTEGER) {
-      codegen_cast_int_to_float2();
-    }
-    return true;
-  } else if ((type1 == TYPE_STRING || type1 == TYPE_NIL) &&
-             (type2 == TYPE_STRING || type2 == TYPE_NIL)) {
-    *out = TYPE_BOOL;
-    return true;
-  } else {
-    expression_typecheck_set_error(type1, type2);
+bool expression_binary(symbol_stack_item_t *out, expression_symbol_t op,
+                       symbol_stack_item_t *s3, symbol_stack_item_t *s1) {
+  if (op < SYM_PLUS || op > SYM_LT || op == SYM_STRLEN) {
+    // not a binary operator, eg. E # E
+    return false;
+  }
+  const expression_typerule_t *rule =
+      expression_typecheck(op, s3->type, s1->type);
+  if (rule->type == TYPE_NONE) {
+    error_set(rule->error);
     return false;
   }
+  if (rule->cast_left && !expression_cast(s3, rule->cast_left)) {
+    return false;
+  }
+  if (rule->cast_right && !expression_cast(s1, rule->cast_right)) {
+    return false;
+  }
+  if ((op == SYM_DIVIDE || op == SYM_DIVIDE2) && s1->is_zero) {
+    error_set(EXITSTATUS_ERROR_DIVIDE_ZERO);
+    return false;
+  }
+  return expression_make_op(out, expression_op_kind[op], rule->type,
+                            s3->node, s1->node);
 }
 
 /**
- * Check types for expressions with basic logic operation.
+ * Replace handle on top of the stack with E
  */
-bool expression_typecheck_basic_logic(char *out, char type1, char type2) {
-  if ((type1 == TYPE_NUMBER || type1 == TYPE_INTEGER) &&
-      (type2 == TYPE_NUMBER || type2 == TYPE_INTEGER)) {
-    *out = TYPE_BOOL;
-    if (type1 == TYPE_INTEGER && type2 == TYPE_NUMBER) {
-      codegen_cast_int_to_float1();
-    } else if (type1 == TYPE_NUMBER && type2 == TYPE_INTEGER) {
-      codegen_cast_int_to_float2();
-    }
-    return true;
-  } else {
-    expression_typecheck_set_error(type1, type2);
-    return false;
+void expression_reduce(symbol_stack_t *stack, int count,
+                       const symbol_stack_item_t *e) {
+  symbol_stack_item_t item = *e;
+  symbol_stack_pops(stack, count);
+  symbol_stack_push_id(stack, SYM_E, item.type, item.lvl, item.is_zero);
+  if (!error_get()) {
+    symbol_stack_peek(stack, 0)->node = item.node;
   }
 }
 
 /**
  * Test rules of the grammar
  */
-bool expression_test_rules(symbol_stack_t **stack, symbol_stack_t *s2,
-                           symbol_stack_t *s3, symbol_stack_t *s4) {
-  symbol_stack_t *s1 = *stack;
+bool expression_test_rules(symbol_stack_t *stack, symbol_stack_item_t *s2,
+                           symbol_stack_item_t *s3, symbol_stack_item_t *s4) {
+  symbol_stack_item_t *s1 = symbol_stack_peek(stack, 0);
   if (s1->symbol == SYM_I) {
     if (s2->symbol == SYM_PREC_LT) {
       // E -> i
-      char type = s1->type;
-      int lvl = s1->lvl;
-      bool is_zero = s1->is_zero;
-      symbol_stack_pops(stack, 2);
-      symbol_stack_push_id(stack, SYM_E, type, lvl, is_zero);
+      expression_reduce(stack, 2, s1);
       return true;
     }
   } else if (s1->symbol == SYM_RBRACKET && s2->symbol == SYM_E &&
              s3->symbol == SYM_LBRACKET && s4->symbol == SYM_PREC_LT) {
     // E -> (E)
-    char type = s2->type;
-    int lvl = s1->lvl;
-    bool is_zero = s1->is_zero;
-    symbol_stack_pops(stack, 4);
-    symbol_stack_push_id(stack, SYM_E, type, lvl, is_zero);
+    symbol_stack_item_t e = *s2;
+    e.lvl = s1->lvl;
+    e.is_zero = s1->is_zero;
+    expression_reduce(stack, 4, &e);
     return true;
   } else if (s1->symbol == SYM_E && s2->symbol == SYM_STRLEN &&
              s3->symbol == SYM_PREC_LT) {
     // E -> #E
-    if (s1->type != TYPE_STRING) {
-      error_set(EXITSTATUS_ERROR_SEMANTIC_TYPE_EXPR);
+    symbol_stack_item_t e;
+    if (!expression_strlen(&e, s1, s2->begin)) {
       return false;
     }
-    symbol_stack_pops(stack, 3);
-    symbol_stack_push(stack, SYM_E, TYPE_INTEGER);
-    codegen_expression_strlen();
+    expression_reduce(stack, 3, &e);
     return true;
   } else if (s1->symbol == SYM_E && s3->symbol == SYM_E &&
              s4->symbol == SYM_PREC_LT) {
-    if (s2->symbol == SYM_PLUS) {
-      // E -> E+E
-      char type;
-      if (!expression_typecheck_basic_arithmetics(&type, s1->type, s3->type))
-        return false;
-      symbol_stack_pops(stack, 4);
-      symbol_stack_push(stack, SYM_E, type);
-      codegen_expression_plus();
-      return true;
-    } else if (s2->symbol == SYM_MINUS) {
-      // E -> E-E
-      char type;
-      if (!expression_typecheck_basic_arithmetics(&type, s1->type, s3->type))
-        return false;
-      symbol_stack_pops(stack, 4);
-      symbol_stack_push(stack, SYM_E, type);
-      codegen_expression_minus();
-      return true;
-    } else if (s2->symbol == SYM_TIMES) {
-      // E -> E*E
-      char type;
-      if (!expression_typecheck_basic_arithmetics(&type, s1->type, s3->type))
-        return false;
-      symbol_stack_pops(stack, 4);
-      symbol_stack_push(stack, SYM_E, type);
-      codegen_expression_mul();
-      return true;
-    } else if (s2->symbol == SYM_DIVIDE) {
-      // E -> E/E
-      if (s1->type == TYPE_INTEGER) {
-        s1->type = TYPE_NUMBER;
-        codegen_cast_int_to_float1();
-      }
-      if (s3->type == TYPE_INTEGER) {
-        s3->type = TYPE_NUMBER;
-        codegen_cast_int_to_float2();
-      }
-      if (s1->type != TYPE_NUMBER && s3->type != TYPE_NUMBER) {
-        expression_typecheck_set_error(s1->type, s3->type);
-        return false;
-      }
-      if (s1->is_zero) {
-        error_set(EXITSTATUS_ERROR_DIVIDE_ZERO);
-        return false;
-      }
-      symbol_stack_pops(stack, 4);
-      symbol_stack_push(stack, SYM_E, TYPE_NUMBER);
-      codegen_expression_div();
-      return true;
-    } else if (s2->symbol == SYM_DIVIDE2) {
-      // E -> E//E
-      if (s1->type == TYPE_NUMBER) {
-        s1->type = TYPE_INTEGER;
-        codegen_cast_float_to_int1();
-      }
-      if (s3->type == TYPE_NUMBER) {
-        s3->type = TYPE_INTEGER;
-        codegen_cast_float_to_int2();
-      }
-      if (s1->type != TYPE_INTEGER && s3->type != TYPE_INTEGER) {
-        expression_typecheck_set_error(s1->type, s3->type);
-        return false;
-      }
-      if (s1->is_zero) {
-        error_set(EXITSTATUS_ERROR_DIVIDE_ZERO);
-        return false;
-      }
-      symbol_stack_pops(stack, 4);
-      symbol_stack_push(stack, SYM_E, TYPE_INTEGER);
-      codegen_expression_divint();
-      return true;
-    } else if (s2->symbol == SYM_DOTDOT) {
-      // E -> E..E
-      if (s1->type != TYPE_STRING && s3->type != TYPE_STRING) {
-        expression_typecheck_set_error(s1->type, s3->type);
-        return false;
-      }
-      symbol_stack_pops(stack, 4);
-      symbol_stack_push(stack, SYM_E, TYPE_STRING);
-      codegen_expression_concat();
-      return true;
-    } else if (s2->symbol == SYM_EQ) {
-      // E -> E==E
-      char type;
-      if (!expression_typecheck_basic_logic_nullable(&type, s1->type, s3->type))
-        return false;
-      symbol_stack_pops(stack, 4);
-      symbol_stack_push(stack, SYM_E, type);
-      codegen_expression_eq();
-      return true;
-    } else if (s2->symbol == SYM_NEQ) {
-      // E -> E~=E
-      char type;
-      if (!expression_typecheck_basic_logic_nullable(&type, s1->type, s3->type))
-        return false;
-      symbol_stack_pops(stack, 4);
-      symbol_stack_push(stack, SYM_E, type);
-      codegen_expression_neq();
-      return true;
-    } else if (s2->symbol == SYM_LT) {
-      // E -> E<E
-      char type;
-      if (!expression_typecheck_basic_logic(&type, s1->type, s3->type))
-        return false;
-      symbol_stack_pops(stack, 4);
-      symbol_stack_push(stack, SYM_E, type);
-      codegen_expression_lt();
-      return true;
-    } else if (s2->symbol == SYM_GT) {
-      // E -> E>E
-      char type;
-      if (!expression_typecheck_basic_logic(&type, s1->type, s3->type))
-        return false;
-      symbol_stack_pops(stack, 4);
-      symbol_stack_push(stack, SYM_E, type);
-      codegen_expression_gt();
-      return true;
-    } else if (s2->symbol == SYM_LTE) {
-      // E -> E<=E
-      char type;
-      if (!expression_typecheck_basic_logic(&type, s1->type, s3->type))
-        return false;
-      symbol_stack_pops(stack, 4);
-      symbol_stack_push(stack, SYM_E, type);
-      codegen_expression_lte();
-      return true;
-    } else if (s2->symbol == SYM_GTE) {
-      // E -> E>=E
-      char type;
-      if (!expression_typecheck_basic_logic(&type, s1->type, s3->type))
-        return false;
-      symbol_stack_pops(stack, 4);
-      symbol_stack_push(stack, SYM_E, type);
-      codegen_expression_gte();
-      return true;
+    // E -> E op E
+    symbol_stack_item_t e;
+    if (!expression_binary(&e, s2->symbol, s3, s1)) {
+      return false;
     }
+    expression_reduce(stack, 4, &e);
+    return true;
   }
   return false;
 }
@@ -508,14 +573,10 @@ bool expression_test_rules(symbol_stack_t **stack, symbol_stack_t *s2,
  * Print stack - for debugging
  */
 void print_stack(symbol_stack_t *stack) {
-  expression_symbol_t a;
-  symbol_stack_t *stack_curr = stack;
   printf("# [");
-  while (stack_curr != NULL) {
-    a = stack_curr->symbol;
-    if (stack_curr->is_zero) printf("0");
-    printf("%s ", expression_symbol_t_names[a]);
-    stack_curr = stack_curr->next;
+  for (int i = stack->top; i >= 0; i--) {
+    if (stack->items[i].is_zero) printf("0");
+    printf("%s ", expression_symbol_t_names[stack->items[i].symbol]);
   }
   printf("]\n");
 }
@@ -523,7 +584,8 @@ void print_stack(symbol_stack_t *stack) {
 /**
  * Process expression
  */
-bool expression_process(symbol_stack_t *stack, char *exp_type) {
+bool expression_process(symbol_stack_t *stack, char *exp_type,
+                        exptree_node_t **tree) {
   expression_symbol_t a, b = SYM_NONE;
   do {
     a = get_top_symbol(stack);
@@ -547,7 +609,7 @@ bool expression_process(symbol_stack_t *stack, char *exp_type) {
       case PREC_EQ:
         if (true) {
           char tmp = expression_get_type(&lvl);
-          symbol_stack_push_id(&stack, b, tmp, lvl, expression_token_is_zero());
+          symbol_stack_push_id(stack, b, tmp, lvl, expression_token_is_zero());
         }
         expression_next_input();
         if (error_get()) {
@@ -559,41 +621,49 @@ bool expression_process(symbol_stack_t *stack, char *exp_type) {
           token_t *token = token_buff(TOKEN_THIS);
           int lvl = 0;
           if (token->type == TT_ID) {
-            symtab_var_data_t *find_var =
-                symtab_find_var(symtab, token->attr.str, &lvl);
+            symtab_var_data_t *find_var = symtab_find_var_hashed(
+                symtab, token->attr.str, token->hash, &lvl);
             if (find_var == NULL) {
               error_set(EXITSTATUS_ERROR_SEMANTIC_IDENTIFIER);
               return false;
             }
           }
-          codegen_expression_push_value(token, lvl);
         }
-        if (stack->symbol == SYM_E) {
-          char type = stack->type;
-          int lvl = stack->lvl;
-          bool is_zero = stack->is_zero;
-          symbol_stack_pop(&stack);
-          symbol_stack_push(&stack, SYM_PREC_LT, TYPE_NONE);
-          symbol_stack_push_id(&stack, SYM_E, type, lvl, is_zero);
+        if (symbol_stack_peek(stack, 0)->symbol == SYM_E) {
+          // insert marker below E
+          symbol_stack_item_t top = *symbol_stack_peek(stack, 0);
+          symbol_stack_pops(stack, 1);
+          symbol_stack_push(stack, SYM_PREC_LT, TYPE_NONE);
+          symbol_stack_push_id(stack, SYM_E, top.type, top.lvl, top.is_zero);
+          symbol_stack_peek(stack, 0)->node = top.node;
         } else {
-          symbol_stack_push(&stack, SYM_PREC_LT, TYPE_NONE);
+          symbol_stack_push(stack, SYM_PREC_LT, TYPE_NONE);
         }
         char type = expression_get_type(&lvl);
-        symbol_stack_push_id(&stack, b, type, lvl, expression_token_is_zero());
+        symbol_stack_push_id(stack, b, type, lvl, expression_token_is_zero());
+        if (error_get()) {
+          return false;
+        }
+        token_t *token = token_buff(TOKEN_THIS);
+        symbol_stack_item_t *item = symbol_stack_peek(stack, 0);
+        item->begin = token->begin;
+        if (b == SYM_I) {
+          item->node = exptree_leaf(tree_arena, token, type, lvl);
+          if (item->node == NULL) {
+            return false;
+          }
+        }
         expression_next_input();
         if (error_get()) {
           return false;
         }
         break;
       case PREC_GT: {
-        symbol_stack_t *s2 = NULL;
-        symbol_stack_t *s3 = NULL;
-        symbol_stack_t *s4 = NULL;
-        if (stack != NULL) s2 = stack->next;
-        if (s2 != NULL) s3 = s2->next;
-        if (s3 != NULL) s4 = s3->next;
-
-        if (!expression_test_rules(&stack, s2, s3, s4)) {
+        symbol_stack_item_t *s2 = symbol_stack_peek(stack, 1);
+        symbol_stack_item_t *s3 = symbol_stack_peek(stack, 2);
+        symbol_stack_item_t *s4 = symbol_stack_peek(stack, 3);
+
+        if (!expression_test_rules(stack, s2, s3, s4)) {
           return false;
         }
         break;
@@ -602,11 +672,11 @@ bool expression_process(symbol_stack_t *stack, char *exp_type) {
         // Error
         return false;
     }
-  } while (b != SYM_S ||
-           !(stack->symbol == SYM_E && stack->next->symbol == SYM_S));
-  *exp_type = stack->type;
-  symbol_stack_pop(&stack);
-  symbol_stack_pop(&stack);
+  } while (b != SYM_S || !(symbol_stack_peek(stack, 0)->symbol == SYM_E &&
+                           symbol_stack_peek(stack, 1)->symbol == SYM_S));
+  *exp_type = symbol_stack_peek(stack, 0)->type;
+  *tree = symbol_stack_peek(stack, 0)->node;
+  symbol_stack_pops(stack, 2);
   return true;
 }
 
@@ -629,7 +699,8 @@ char expression_get_type(int *lvl) {
     case TT_K_NIL:
       return TYPE_NIL;
     case TT_ID: {
-      symtab_var_data_t *record = symtab_find_var(symtab, token->attr.str, lvl);
+      symtab_var_data_t *record =
+          symtab_find_var_hashed(symtab, token->attr.str, token->hash, lvl);
       if (record == NULL) {
         error_set(EXITSTATUS_ERROR_SEMANTIC_IDENTIFIER);
         return TYPE_NONE;
@@ -697,7 +768,201 @@ expression_symbol_t expression_get_input() {
  */
 void expression_next_input() { token_buff(TOKEN_NEW); }
 
+#if EXPRESSION_PARSER == EXPRESSION_PRATT
+
+// Binding power of binary operators, 0 if not binary operator
+#define PRATT_PREC_REL 1
+#define PRATT_PREC_CONCAT 2
+#define PRATT_PREC_ADD 3
+#define PRATT_PREC_MUL 4
+#define PRATT_PREC_STRLEN 6  // above right operand of MUL
+
+/**
+ * Get binding power of binary operator
+ */
+int expression_pratt_prec(expression_symbol_t symbol) {
+  switch (symbol) {
+    case SYM_TIMES:
+    case SYM_DIVIDE:
+    case SYM_DIVIDE2:
+      return PRATT_PREC_MUL;
+    case SYM_PLUS:
+    case SYM_MINUS:
+      return PRATT_PREC_ADD;
+    case SYM_DOTDOT:
+      return PRATT_PREC_CONCAT;
+    case SYM_GT:
+    case SYM_GTE:
+    case SYM_EQ:
+    case SYM_NEQ:
+    case SYM_LTE:
+    case SYM_LT:
+      return PRATT_PREC_REL;
+    default:
+      return 0;
+  }
+}
+
+bool expression_pratt(int min_prec, symbol_stack_item_t *out);
+
+/**
+ * Parse operand: i, (E) or #E
+ * @param prev_prec Binding power of preceding operator, 0 if none
+ */
+bool expression_pratt_operand(symbol_stack_item_t *out, int prev_prec) {
+  expression_symbol_t symbol = expression_get_input();
+  if (error_get()) {
+    return false;
+  }
+
+  if (symbol == SYM_I) {
+    token_t *token = token_buff(TOKEN_THIS);
+    int lvl = 0;
+    out->symbol = SYM_E;
+    out->type = expression_get_type(&lvl);
+    if (error_get()) {
+      return false;
+    }
+    out->lvl = lvl;
+    out->is_zero = expression_token_is_zero();
+    out->node = exptree_leaf(tree_arena, token, out->type, lvl);
+    if (out->node == NULL) {
+      return false;
+    }
+    expression_next_input();
+    return !error_get();
+  } else if (symbol == SYM_LBRACKET) {
+    expression_next_input();
+    if (error_get() || !expression_pratt(PRATT_PREC_REL, out)) {
+      return false;
+    }
+    if (expression_get_input() != SYM_RBRACKET) {
+      return false;
+    }
+    out->lvl = 0;
+    out->is_zero = false;
+    expression_next_input();
+    return !error_get();
+  } else if (symbol == SYM_STRLEN && prev_prec < PRATT_PREC_STRLEN) {
+    size_t begin = token_buff(TOKEN_THIS)->begin;
+    expression_next_input();
+    // ## is not reduced by precedence parser
+    if (error_get() || expression_get_input() == SYM_STRLEN) {
+      return false;
+    }
+    symbol_stack_item_t operand;
+    if (!expression_pratt(PRATT_PREC_STRLEN, &operand)) {
+      return false;
+    }
+    return expression_strlen(out, &operand, begin);
+  } else if (expression_pratt_prec(symbol) > prev_prec) {
+    // missing operand, precedence parser shifts tighter operator
+    // and reports errors in its right operand first
+    expression_next_input();
+    if (!error_get()) {
+      symbol_stack_item_t ignored;
+      expression_pratt(expression_pratt_prec(symbol) + 1, &ignored);
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Parse expression with binary operators binding at least min_prec
+ */
+bool expression_pratt(int min_prec, symbol_stack_item_t *out) {
+  if (!expression_pratt_operand(out, min_prec - 1)) {
+    return false;
+  }
+
+  for (;;) {
+    expression_symbol_t op = expression_get_input();
+    if (error_get()) {
+      return false;
+    }
+    // operand cannot be followed by (
+    if (op == SYM_LBRACKET) {
+      return false;
+    }
+    // operand cannot be followed by #, precedence parser reduces
+    // pending # and then shifts it, reporting errors in its operand first
+    if (op == SYM_STRLEN) {
+      if (min_prec == PRATT_PREC_STRLEN) {
+        return true;
+      }
+      expression_next_input();
+      if (!error_get() && expression_get_input() != SYM_STRLEN) {
+        symbol_stack_item_t ignored;
+        expression_pratt(PRATT_PREC_STRLEN, &ignored);
+      }
+      return false;
+    }
+    // anything else than binary operator ends the expression
+    int prec = expression_pratt_prec(op);
+    if (prec < min_prec || prec == 0) {
+      return true;
+    }
+    expression_next_input();
+    if (error_get()) {
+      return false;
+    }
+
+    symbol_stack_item_t right;
+    if (!expression_pratt(prec + 1, &right)) {
+      return false;
+    }
+    // relational operators are not associative
+    if (prec == PRATT_PREC_REL &&
+        expression_pratt_prec(expression_get_input()) == PRATT_PREC_REL) {
+      return false;
+    }
+
+    symbol_stack_item_t left = *out;
+    if (!expression_binary(out, op, &left, &right)) {
+      return false;
+    }
+  }
+}
+
+/**
+ * Parse whole expression with Pratt parser
+ */
+bool expression_pratt_start(char *exp_type, exptree_node_t **tree) {
+  symbol_stack_item_t e;
+  if (!expression_pratt(PRATT_PREC_REL, &e)) {
+    return false;
+  }
+  // unmatched )
+  if (expression_get_input() == SYM_RBRACKET) {
+    return false;
+  }
+  *exp_type = e.type;
+  *tree = e.node;
+  return true;
+}
+
+#elif EXPRESSION_PARSER != EXPRESSION_PRECEDENCE
+#error "Unknown EXPRESSION_PARSER"
+#endif
+
 bool expression_parse(char *exp_type) {
+  exptree_node_t *tree;
+  arena_reset(&expression_arena);
+  if (!expression_parse_tree(exp_type, &tree, &expression_arena)) {
+    return false;
+  }
+  codegen_expression(tree);
+  return true;
+}
+
+bool expression_parse_condition(char *exp_type, exptree_node_t **tree) {
+  arena_reset(&expression_arena);
+  return expression_parse_tree(exp_type, tree, &expression_arena);
+}
+
+bool expression_parse_tree(char *exp_type, exptree_node_t **tree,
+                           arena_t *arena) {
   token_t *token = token_buff(TOKEN_THIS);
   if (error_get() || token == NULL) {
     return false;
@@ -710,11 +975,27 @@ bool expression_parse(char *exp_type) {
     case TT_K_NIL:
     case TT_SOP_LENGTH:
     case TT_ID: {
-      symbol_stack_t *stack = NULL;
-      symbol_stack_push(&stack, SYM_S, TYPE_NONE);
-      return expression_process(stack, exp_type);
+      tree_arena = arena;
+#if EXPRESSION_PARSER == EXPRESSION_PRATT
+      return expression_pratt_start(exp_type, tree);
+#else
+      symbol_stack.top = -1;
+      symbol_stack_push(&symbol_stack, SYM_S, TYPE_NONE);
+      if (error_get()) {
+        return false;
+      }
+      return expression_process(&symbol_stack, exp_type, tree);
+#endif
     }
     default:
       return false;
   }
 }
+
+void expression_destroy() {
+  arena_free(&expression_arena);
+  free(symbol_stack.items);
+  symbol_stack.items = NULL;
+  symbol_stack.top = -1;
+  symbol_stack.size = 0;
+}
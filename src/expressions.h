@@ -7,6 +7,14 @@
  *
  * FIT VUT IFJ Project:
  * Compiler of IFJ21 Language
+ *
+ * @section IMPLEMENTATION
+ *  Parser is selected at build time by defining EXPRESSION_PARSER
+ *  to one of the EXPRESSION_* values, eg.
+ *  -DEXPRESSION_PARSER=EXPRESSION_PRATT.
+ *  EXPRESSION_PRECEDENCE - operator precedence table and symbol stack.
+ *  EXPRESSION_PRATT - recursive precedence climbing with the same
+ *  precedences, produces the same trees and errors.
  */
 
 #ifndef __EXPRESSIONS_H__
@@ -14,11 +22,20 @@
 
 #include <stdbool.h>
 
+#include "arena.h"
 #include "codegen.h"
 #include "errors.h"
+#include "exptree.h"
 #include "parser.h"
 #include "scanner.h"
 
+#define EXPRESSION_PRECEDENCE 1 /**< Precedence table parser. */
+#define EXPRESSION_PRATT 2      /**< Pratt parser. */
+
+#ifndef EXPRESSION_PARSER
+#define EXPRESSION_PARSER EXPRESSION_PRECEDENCE /**< Selected parser. */
+#endif
+
 typedef enum {
   PREC_UNDEF,
   PREC_EQ,
@@ -52,20 +69,78 @@ typedef enum {
   SYM_PREC_LT,
 } expression_symbol_t;
 
-typedef struct symbol_stack_t symbol_stack_t;
-struct symbol_stack_t {
+/**
+ * Result of type check of binary operation, one entry of the
+ * operator x type x type table.
+ */
+typedef struct {
+  char type;        ///< Type of the result, '-' if types are not allowed
+  char cast_left;   ///< Type the left operand is converted to, 0 if none
+  char cast_right;  ///< Type the right operand is converted to, 0 if none
+  int error;        ///< Exit status if types are not allowed
+} expression_typerule_t;
+
+typedef struct {
   expression_symbol_t symbol;
   char type;
   int lvl;
   bool is_zero;
-  symbol_stack_t *next;
-};
+  size_t begin;          ///< Offset of the symbol in the input
+  exptree_node_t *node;  ///< Tree of E or operand i, NULL otherwise
+} symbol_stack_item_t;
+
+/**
+ * Symbol stack of precedence parser.
+ * Contiguous array reused by all expressions, grows as needed.
+ */
+typedef struct {
+  symbol_stack_item_t *items;
+  int top;   ///< Index of the top item, -1 if empty
+  int size;  ///< Allocated capacity
+} symbol_stack_t;
 
 /**
  * Start parsing expression, beginning with the current token.
+ * Code of the expression is generated from its tree.
  * @param exp_type Returns the type of the expression result.
  * @return True if correct. False otherwise.
  */
 bool expression_parse(char *exp_type);
 
+/**
+ * Parse condition of if or while statement, beginning with the current
+ * token. Code is not generated, the tree is valid until the next
+ * expression is parsed.
+ * @param exp_type Returns the type of the expression result.
+ * @param tree Returns the expression tree.
+ * @return True if correct. False otherwise.
+ */
+bool expression_parse_condition(char *exp_type, exptree_node_t **tree);
+
+/**
+ * Parse expression beginning with the current token into a tree,
+ * without generating any code.
+ * @param exp_type Returns the type of the expression result.
+ * @param tree Returns the expression tree.
+ * @param arena Arena to allocate the tree from.
+ * @return True if correct. False otherwise.
+ */
+bool expression_parse_tree(char *exp_type, exptree_node_t **tree,
+                           arena_t *arena);
+
+/**
+ * Look up type rule of binary operation in the type table.
+ * @param op Operator symbol, SYM_PLUS to SYM_LT except SYM_STRLEN.
+ * @param left Type of the left operand.
+ * @param right Type of the right operand.
+ * @return Result type, conversions of operands and error code.
+ */
+const expression_typerule_t *expression_typecheck(expression_symbol_t op,
+                                                  char left, char right);
+
+/**
+ * Free symbol stack shared by expressions.
+ */
+void expression_destroy();
+
 #endif
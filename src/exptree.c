@@ -0,0 +1,637 @@
+/**
+ * @file
+ * @brief Expression tree implementation
+ * @author Tomas Martykan (xmarty07)
+ * @author Filip Stolfa (xstolf00)
+ * @author Patrik Korytar (xkoryt04)
+ *
+ * FIT VUT IFJ Project:
+ * Compiler of IFJ21 Language
+ */
+
+#include "exptree.h"
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+#include "errors.h"
+#include "hash.h"
+
+// PRIVATE FUNCTION FORWARD DECLARATIONS
+
+/**
+ * Combines hash with another value.
+ * @param hash Hash to combine.
+ * @param value Value to add.
+ * @return Combined hash.
+ */
+uint32_t exptree_hash_combine(uint32_t hash, uint32_t value);
+
+/**
+ * Computes hash of leaf node from its value.
+ * @param node Leaf node.
+ * @return Hash of the leaf.
+ */
+uint32_t exptree_hash_leaf(const exptree_node_t* node);
+
+/**
+ * Decodes next character of string literal in output format.
+ * @param str Pointer to the string, moved past the character.
+ * @return Code of the character, -1 at the end of the string.
+ */
+int exptree_string_char(const char** str);
+
+/**
+ * Compares two string literals in output format.
+ * @param a First string.
+ * @param b Second string.
+ * @param result Returns negative, zero or positive number as strcmp.
+ * @return True if compared. False if a string is not ASCII.
+ */
+bool exptree_string_compare(const char* a, const char* b, int* result);
+
+/**
+ * Evaluates arithmetic operation on two constant values.
+ * @param kind Kind of the operation.
+ * @param a Left operand.
+ * @param b Right operand.
+ * @param value Returns the result.
+ * @return True if result is known. False otherwise.
+ */
+bool exptree_eval_arith(exptree_kind_t kind, const exptree_value_t* a,
+                        const exptree_value_t* b, exptree_value_t* value);
+
+/**
+ * Evaluates comparison of two constant values.
+ * @param kind Kind of the comparison.
+ * @param a Left operand.
+ * @param b Right operand.
+ * @param value Returns the result.
+ * @return True if result is known. False otherwise.
+ */
+bool exptree_eval_compare(exptree_kind_t kind, const exptree_value_t* a,
+                          const exptree_value_t* b, exptree_value_t* value);
+
+/**
+ * Can operation be replaced by its operand?
+ * @param node Operation node.
+ * @param operand Operand of the operation.
+ * @return True if operand has the same type as the result and it is not
+ *  a variable or nil.
+ */
+bool exptree_same_value(const exptree_node_t* node,
+                        const exptree_node_t* operand);
+
+/**
+ * Is node a literal with given value? Negative zero is not zero.
+ * @param node Node to check.
+ * @param value Value to compare with.
+ * @return True if node is integer or number literal equal to value.
+ */
+bool exptree_is_const(const exptree_node_t* node, double value);
+
+/**
+ * Computes reciprocal of a number if it is exact.
+ * @param value Number to invert.
+ * @param result Returns reciprocal of the number.
+ * @return True if value is power of two with normal reciprocal.
+ */
+bool exptree_reciprocal(double value, double* result);
+
+/**
+ * Creates literal node with value of constant expression.
+ * Sets global error flag on failure.
+ * @param arena Arena to allocate from.
+ * @param node Expression replaced by the literal.
+ * @param value Integer or number value of the expression.
+ * @return Created node. NULL if failed.
+ */
+exptree_node_t* exptree_fold(arena_t* arena, const exptree_node_t* node,
+                             const exptree_value_t* value);
+
+// FUNCTION DEFINITIONS
+
+exptree_node_t* exptree_leaf(arena_t* arena, const token_t* token, char type,
+                             int lvl) {
+  exptree_node_t* node = arena_alloc(arena, sizeof(exptree_node_t));
+  if (!node) {
+    return NULL;
+  }
+
+  node->type = type;
+  node->lvl = lvl;
+  node->begin = token->begin;
+  node->end = token->end;
+  node->left = NULL;
+  node->right = NULL;
+  node->value = token->attr;
+
+  switch (token->type) {
+    case TT_INTEGER:
+      node->kind = EXP_INTEGER;
+      break;
+    case TT_NUMBER:
+      node->kind = EXP_NUMBER;
+      break;
+    case TT_STRING:
+    case TT_ID:
+      node->kind = token->type == TT_ID ? EXP_ID : EXP_STRING;
+      // token is freed before the tree
+      node->value.str = arena_strdup(arena, token->attr.str);
+      if (!node->value.str) {
+        return NULL;
+      }
+      break;
+    default:
+      node->kind = EXP_NIL;
+      break;
+  }
+  node->hash = exptree_hash_leaf(node);
+
+  return node;
+}
+
+exptree_node_t* exptree_op(arena_t* arena, exptree_kind_t kind, char type,
+                           exptree_node_t* left, exptree_node_t* right) {
+  exptree_node_t* node = arena_alloc(arena, sizeof(exptree_node_t));
+  if (!node) {
+    return NULL;
+  }
+
+  node->kind = kind;
+  node->type = type;
+  node->lvl = 0;
+  node->value.str = NULL;
+  node->begin = left->begin;
+  node->end = right ? right->end : left->end;
+  node->left = left;
+  node->right = right;
+  node->hash = exptree_hash_combine(
+      exptree_hash_combine(kind, left->hash), right ? right->hash : 0);
+
+  return node;
+}
+
+exptree_node_t* exptree_concat(arena_t* arena, char type, exptree_node_t* left,
+                               exptree_node_t* right) {
+  // operand of inner concatenation which stays unchanged
+  exptree_node_t* rest = NULL;
+  bool rest_left = false;
+  if (right->kind == EXP_STRING && left->kind == EXP_CONCAT &&
+      left->right->kind == EXP_STRING) {
+    rest = left->left;
+    rest_left = true;
+    left = left->right;
+  } else if (left->kind == EXP_STRING && right->kind == EXP_CONCAT &&
+             right->left->kind == EXP_STRING) {
+    rest = right->right;
+    right = right->left;
+  }
+
+  if (left->kind != EXP_STRING || right->kind != EXP_STRING) {
+    return exptree_op(arena, EXP_CONCAT, type, left, right);
+  }
+
+  // literals are in output format, escapes of characters can be joined
+  exptree_node_t* node = arena_alloc(arena, sizeof(exptree_node_t));
+  if (!node) {
+    return NULL;
+  }
+  *node = *left;
+  size_t left_len = strlen(left->value.str);
+  size_t right_len = strlen(right->value.str);
+  node->value.str = arena_alloc(arena, left_len + right_len + 1);
+  if (!node->value.str) {
+    return NULL;
+  }
+  memcpy(node->value.str, left->value.str, left_len);
+  memcpy(node->value.str + left_len, right->value.str, right_len + 1);
+  node->end = right->end;
+  node->hash = exptree_hash_leaf(node);
+
+  if (!rest) {
+    return node;
+  }
+  return rest_left ? exptree_op(arena, EXP_CONCAT, type, rest, node)
+                   : exptree_op(arena, EXP_CONCAT, type, node, rest);
+}
+
+bool exptree_is_leaf(const exptree_node_t* node) { return node->left == NULL; }
+
+exptree_node_t* exptree_simplify(arena_t* arena, exptree_node_t* node) {
+  if (exptree_is_leaf(node)) {
+    return node;
+  }
+  exptree_node_t* left = node->left;
+  exptree_node_t* right = node->right;
+
+  // constant operands are already folded to literals
+  exptree_value_t value;
+  if (exptree_is_leaf(left) && (!right || exptree_is_leaf(right)) &&
+      exptree_eval(node, &value) &&
+      (value.type == 'i' || (value.type == 'n' && isfinite(value.num_val)))) {
+    return exptree_fold(arena, node, &value);
+  }
+  if (!right) {
+    return node;
+  }
+
+  // operation on nil or wrong type is runtime error, it is kept
+  switch (node->kind) {
+    case EXP_PLUS:
+      // -0.0 + 0.0 is 0.0, only integers
+      if (node->type == 'i' && exptree_is_const(left, 0) &&
+          exptree_same_value(node, right)) {
+        return right;
+      }
+      if (node->type == 'i' && exptree_is_const(right, 0) &&
+          exptree_same_value(node, left)) {
+        return left;
+      }
+      break;
+    case EXP_MINUS:
+      if (exptree_is_const(right, 0) && exptree_same_value(node, left)) {
+        return left;
+      }
+      break;
+    case EXP_MUL:
+      if (exptree_is_const(left, 1) && exptree_same_value(node, right)) {
+        return right;
+      }
+      if (exptree_is_const(right, 1) && exptree_same_value(node, left)) {
+        return left;
+      }
+      if (exptree_is_const(left, 2) && right->kind == EXP_ID) {
+        return exptree_op(arena, EXP_PLUS, node->type, right, right);
+      }
+      if (exptree_is_const(right, 2) && left->kind == EXP_ID) {
+        return exptree_op(arena, EXP_PLUS, node->type, left, left);
+      }
+      break;
+    case EXP_DIV:
+      if (exptree_is_const(right, 1) && exptree_same_value(node, left)) {
+        return left;
+      }
+      if (right->kind == EXP_NUMBER &&
+          exptree_reciprocal(right->value.num_val, &value.num_val)) {
+        value.type = 'n';
+        exptree_node_t* factor = exptree_fold(arena, right, &value);
+        return factor ? exptree_op(arena, EXP_MUL, node->type, left, factor)
+                      : NULL;
+      }
+      break;
+    case EXP_DIVINT:
+      if (exptree_is_const(right, 1) && exptree_same_value(node, left)) {
+        return left;
+      }
+      break;
+    default:
+      break;
+  }
+  return node;
+}
+
+bool exptree_same_value(const exptree_node_t* node,
+                        const exptree_node_t* operand) {
+  return operand->type == node->type && operand->kind != EXP_ID &&
+         operand->kind != EXP_NIL;
+}
+
+bool exptree_is_const(const exptree_node_t* node, double value) {
+  if (node->kind == EXP_INTEGER) {
+    return node->value.int_val == value;
+  }
+  // E - (-0.0) is not E for E = -0.0
+  return node->kind == EXP_NUMBER && node->value.num_val == value &&
+         !signbit(node->value.num_val);
+}
+
+bool exptree_reciprocal(double value, double* result) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint64_t exponent = (bits >> 52) & 0x7ff;
+  // mantissa of power of two is zero, exponent is not special
+  if ((bits & 0xfffffffffffffULL) != 0 || exponent == 0 || exponent == 0x7ff) {
+    return false;
+  }
+  *result = 1 / value;
+  memcpy(&bits, result, sizeof(bits));
+  exponent = (bits >> 52) & 0x7ff;
+  return exponent != 0 && exponent != 0x7ff;
+}
+
+exptree_node_t* exptree_fold(arena_t* arena, const exptree_node_t* node,
+                             const exptree_value_t* value) {
+  exptree_node_t* leaf = arena_alloc(arena, sizeof(exptree_node_t));
+  if (!leaf) {
+    return NULL;
+  }
+
+  leaf->type = value->type == 'i' ? 'i' : 'n';
+  leaf->lvl = 0;
+  if (value->type == 'i') {
+    leaf->kind = EXP_INTEGER;
+    leaf->value.int_val = value->int_val;
+  } else {
+    leaf->kind = EXP_NUMBER;
+    leaf->value.num_val = value->num_val;
+  }
+  leaf->begin = node->begin;
+  leaf->end = node->end;
+  leaf->left = NULL;
+  leaf->right = NULL;
+  leaf->hash = exptree_hash_leaf(leaf);
+
+  return leaf;
+}
+
+uint32_t exptree_hash_combine(uint32_t hash, uint32_t value) {
+  return (hash ^ value) * 0x01000193u + (hash >> 15);
+}
+
+uint32_t exptree_hash_leaf(const exptree_node_t* node) {
+  uint32_t hash = exptree_hash_combine(node->kind, node->lvl);
+  switch (node->kind) {
+    case EXP_INTEGER:
+      return exptree_hash_combine(hash, node->value.int_val);
+    case EXP_NUMBER: {
+      uint64_t bits;
+      memcpy(&bits, &node->value.num_val, sizeof(bits));
+      return exptree_hash_combine(hash, bits ^ (bits >> 32));
+    }
+    case EXP_STRING:
+    case EXP_ID:
+      return exptree_hash_combine(
+          hash, hash_key(node->value.str, strlen(node->value.str)));
+    default:
+      return hash;
+  }
+}
+
+bool exptree_equal(const exptree_node_t* a, const exptree_node_t* b) {
+  if (a == b) {
+    return true;
+  }
+  if (a->hash != b->hash || a->kind != b->kind || a->type != b->type) {
+    return false;
+  }
+  switch (a->kind) {
+    case EXP_INTEGER:
+      return a->value.int_val == b->value.int_val;
+    case EXP_NUMBER:
+      return a->value.num_val == b->value.num_val;
+    case EXP_STRING:
+      return !strcmp(a->value.str, b->value.str);
+    case EXP_ID:
+      return a->lvl == b->lvl && !strcmp(a->value.str, b->value.str);
+    case EXP_NIL:
+      return true;
+    default:
+      break;
+  }
+  return exptree_equal(a->left, b->left) &&
+         (!a->right || exptree_equal(a->right, b->right));
+}
+
+exptree_node_t* exptree_copy(arena_t* arena, const exptree_node_t* node) {
+  exptree_node_t* copy = arena_alloc(arena, sizeof(exptree_node_t));
+  if (!copy) {
+    return NULL;
+  }
+  *copy = *node;
+
+  if (node->kind == EXP_STRING || node->kind == EXP_ID) {
+    copy->value.str = arena_strdup(arena, node->value.str);
+    if (!copy->value.str) {
+      return NULL;
+    }
+  }
+  if (node->left) {
+    copy->left = exptree_copy(arena, node->left);
+    if (!copy->left) {
+      return NULL;
+    }
+  }
+  if (node->right) {
+    copy->right = exptree_copy(arena, node->right);
+    if (!copy->right) {
+      return NULL;
+    }
+  }
+  return copy;
+}
+
+int exptree_string_char(const char** str) {
+  const char* s = *str;
+  if (*s == '\0') {
+    return -1;
+  }
+  if (*s == '\\') {
+    *str = s + 4;
+    return (s[1] - '0') * 100 + (s[2] - '0') * 10 + (s[3] - '0');
+  }
+  *str = s + 1;
+  return (unsigned char)*s;
+}
+
+bool exptree_string_compare(const char* a, const char* b, int* result) {
+  int ca, cb;
+  do {
+    ca = exptree_string_char(&a);
+    cb = exptree_string_char(&b);
+    // interpreter may compare other characters differently
+    if (ca > 127 || cb > 127) {
+      return false;
+    }
+  } while (ca == cb && ca != -1);
+  *result = ca - cb;
+  return true;
+}
+
+bool exptree_eval_arith(exptree_kind_t kind, const exptree_value_t* a,
+                        const exptree_value_t* b, exptree_value_t* value) {
+  if (a->type != b->type) {
+    return false;
+  }
+  value->type = a->type;
+
+  if (a->type == 'n') {
+    switch (kind) {
+      case EXP_PLUS:
+        value->num_val = a->num_val + b->num_val;
+        return true;
+      case EXP_MINUS:
+        value->num_val = a->num_val - b->num_val;
+        return true;
+      case EXP_MUL:
+        value->num_val = a->num_val * b->num_val;
+        return true;
+      case EXP_DIV:
+        if (b->num_val == 0) {
+          return false;
+        }
+        value->num_val = a->num_val / b->num_val;
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  if (a->type != 'i') {
+    return false;
+  }
+  switch (kind) {
+    case EXP_PLUS:
+      value->int_val = a->int_val + b->int_val;
+      break;
+    case EXP_MINUS:
+      value->int_val = a->int_val - b->int_val;
+      break;
+    case EXP_MUL:
+      value->int_val = a->int_val * b->int_val;
+      break;
+    case EXP_DIVINT:
+      // rounding of negative operands is left to the interpreter
+      if (a->int_val < 0 || b->int_val <= 0) {
+        return false;
+      }
+      value->int_val = a->int_val / b->int_val;
+      break;
+    default:
+      return false;
+  }
+  return value->int_val >= INT_MIN && value->int_val <= INT_MAX;
+}
+
+bool exptree_eval_compare(exptree_kind_t kind, const exptree_value_t* a,
+                          const exptree_value_t* b, exptree_value_t* value) {
+  int cmp;
+  if (a->type == 'x' || b->type == 'x') {
+    // only equality is defined for nil
+    if (kind != EXP_EQ && kind != EXP_NEQ) {
+      return false;
+    }
+    cmp = a->type != b->type;
+  } else if (a->type != b->type) {
+    return false;
+  } else if (a->type == 'i') {
+    cmp = (a->int_val > b->int_val) - (a->int_val < b->int_val);
+  } else if (a->type == 'n') {
+    cmp = (a->num_val > b->num_val) - (a->num_val < b->num_val);
+  } else if (a->type == 's') {
+    if (!exptree_string_compare(a->str, b->str, &cmp)) {
+      return false;
+    }
+  } else {
+    return false;
+  }
+
+  value->type = 'b';
+  switch (kind) {
+    case EXP_EQ:
+      value->bool_val = cmp == 0;
+      break;
+    case EXP_NEQ:
+      value->bool_val = cmp != 0;
+      break;
+    case EXP_LT:
+      value->bool_val = cmp < 0;
+      break;
+    case EXP_LTE:
+      value->bool_val = cmp <= 0;
+      break;
+    case EXP_GT:
+      value->bool_val = cmp > 0;
+      break;
+    default:
+      value->bool_val = cmp >= 0;
+      break;
+  }
+  return true;
+}
+
+bool exptree_eval(const exptree_node_t* node, exptree_value_t* value) {
+  exptree_value_t a, b;
+
+  switch (node->kind) {
+    case EXP_INTEGER:
+      value->type = 'i';
+      value->int_val = node->value.int_val;
+      return true;
+    case EXP_NUMBER:
+      value->type = 'n';
+      value->num_val = node->value.num_val;
+      return true;
+    case EXP_STRING:
+      value->type = 's';
+      value->str = node->value.str;
+      return true;
+    case EXP_NIL:
+      value->type = 'x';
+      return true;
+    case EXP_ID:
+    case EXP_CONCAT:
+      return false;
+    case EXP_INT2FLOAT:
+      if (!exptree_eval(node->left, &a) || a.type != 'i') {
+        return false;
+      }
+      value->type = 'n';
+      value->num_val = a.int_val;
+      return true;
+    case EXP_FLOAT2INT:
+      // conversion truncates towards zero
+      if (!exptree_eval(node->left, &a) || a.type != 'n' ||
+          !(a.num_val > INT_MIN - 1.0 && a.num_val < INT_MAX + 1.0)) {
+        return false;
+      }
+      value->type = 'i';
+      value->int_val = (long long)a.num_val;
+      return true;
+    case EXP_STRLEN: {
+      if (!exptree_eval(node->left, &a) || a.type != 's') {
+        return false;
+      }
+      const char* str = a.str;
+      int c;
+      value->type = 'i';
+      value->int_val = 0;
+      while ((c = exptree_string_char(&str)) != -1) {
+        if (c > 127) {
+          return false;
+        }
+        value->int_val++;
+      }
+      return true;
+    }
+    default:
+      break;
+  }
+
+  // binary operations
+  if (!exptree_eval(node->left, &a) || !exptree_eval(node->right, &b)) {
+    return false;
+  }
+  switch (node->kind) {
+    case EXP_PLUS:
+    case EXP_MINUS:
+    case EXP_MUL:
+    case EXP_DIV:
+    case EXP_DIVINT:
+      return exptree_eval_arith(node->kind, &a, &b, value);
+    default:
+      return exptree_eval_compare(node->kind, &a, &b, value);
+  }
+}
+
+exptree_truth_t exptree_truth(const exptree_node_t* node) {
+  exptree_value_t value;
+  if (!exptree_eval(node, &value)) {
+    return EXPTREE_UNKNOWN;
+  }
+  if (value.type == 'x' || (value.type == 'b' && !value.bool_val)) {
+    return EXPTREE_FALSE;
+  }
+  return EXPTREE_TRUE;
+}
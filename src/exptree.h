@@ -0,0 +1,222 @@
+/**
+ * @file
+ * @brief Expression tree API
+ * @author Tomas Martykan (xmarty07)
+ * @author Filip Stolfa (xstolf00)
+ * @author Patrik Korytar (xkoryt04)
+ *
+ * FIT VUT IFJ Project:
+ * Compiler of IFJ21 Language
+ *
+ * @section DESCRIPTION
+ *  Tree representation of a type checked expression.
+ *  Built by expression parser, walked by code generator.
+ *
+ * @section IMPLEMENTATION
+ *  Nodes are allocated from an arena and freed with it.
+ *  Implicit type conversions are explicit conversion nodes.
+ */
+
+#ifndef __EXPTREE_H__
+#define __EXPTREE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "scanner.h"
+
+// DATA STRUCTURES
+
+/**
+ * @brief Kind of expression tree node.
+ */
+typedef enum {
+  // leaves
+  EXP_INTEGER,  ///< Integer literal
+  EXP_NUMBER,   ///< Number literal
+  EXP_STRING,   ///< String literal
+  EXP_NIL,      ///< nil
+  EXP_ID,       ///< Variable
+
+  // unary
+  EXP_INT2FLOAT,  ///< Conversion integer -> number
+  EXP_FLOAT2INT,  ///< Conversion number -> integer
+  EXP_STRLEN,     ///< #E
+
+  // binary
+  EXP_PLUS,    ///< E + E
+  EXP_MINUS,   ///< E - E
+  EXP_MUL,     ///< E * E
+  EXP_DIV,     ///< E / E
+  EXP_DIVINT,  ///< E // E
+  EXP_CONCAT,  ///< E .. E
+  EXP_EQ,      ///< E == E
+  EXP_NEQ,     ///< E ~= E
+  EXP_LT,      ///< E < E
+  EXP_LTE,     ///< E <= E
+  EXP_GT,      ///< E > E
+  EXP_GTE,     ///< E >= E
+} exptree_kind_t;
+
+/**
+ * @struct exptree_node_t
+ * @brief Node of expression tree.
+ * @var exptree_node_t::kind
+ *  Kind of the node.
+ * @var exptree_node_t::type
+ *  Static type of the value, same characters as in symbol table.
+ * @var exptree_node_t::lvl
+ *  Level of scope of the variable for EXP_ID.
+ * @var exptree_node_t::value
+ *  Constant value of literal, name of the variable for EXP_ID.
+ * @var exptree_node_t::begin
+ *  Offset of the first character of the expression in the input.
+ * @var exptree_node_t::end
+ *  Offset just past the last character of the expression in the input.
+ * @var exptree_node_t::hash
+ *  Hash of the subtree, equal subtrees have equal hashes.
+ * @var exptree_node_t::left
+ *  Operand of unary node, left operand of binary node.
+ * @var exptree_node_t::right
+ *  Right operand of binary node.
+ */
+typedef struct exptree_node {
+  exptree_kind_t kind;
+  char type;
+  int lvl;
+  attr_t value;
+  size_t begin;
+  size_t end;
+  uint32_t hash;
+  struct exptree_node* left;
+  struct exptree_node* right;
+} exptree_node_t;
+
+/**
+ * @struct exptree_value_t
+ * @brief Value of constant expression.
+ * @var exptree_value_t::type
+ *  Type of the value, 'b' for result of comparison.
+ * @var exptree_value_t::bool_val
+ *  Value of comparison.
+ * @var exptree_value_t::int_val
+ *  Value of integer.
+ * @var exptree_value_t::num_val
+ *  Value of number.
+ * @var exptree_value_t::str
+ *  String literal in output format.
+ */
+typedef struct {
+  char type;
+  bool bool_val;
+  long long int_val;
+  double num_val;
+  const char* str;
+} exptree_value_t;
+
+/**
+ * @brief Truth of condition known at compile time.
+ */
+typedef enum {
+  EXPTREE_UNKNOWN,  ///< Depends on values of variables
+  EXPTREE_TRUE,     ///< Always true
+  EXPTREE_FALSE,    ///< Always false
+} exptree_truth_t;
+
+// PUBLIC FUNCTION FORWARD DECLARATIONS
+
+/**
+ * Creates leaf node from literal or identifier token.
+ * Sets global error flag on failure.
+ * @param arena Arena to allocate from.
+ * @param token Token of the operand.
+ * @param type Static type of the operand.
+ * @param lvl Level of scope of the variable.
+ * @return Created node. NULL if failed.
+ */
+exptree_node_t* exptree_leaf(arena_t* arena, const token_t* token, char type,
+                             int lvl);
+
+/**
+ * Creates unary or binary operation node.
+ * Sets global error flag on failure.
+ * @param arena Arena to allocate from.
+ * @param kind Kind of the operation.
+ * @param type Static type of the result.
+ * @param left Operand of unary, left operand of binary operation.
+ * @param right Right operand of binary operation, NULL for unary.
+ * @return Created node. NULL if failed.
+ */
+exptree_node_t* exptree_op(arena_t* arena, exptree_kind_t kind, char type,
+                           exptree_node_t* left, exptree_node_t* right);
+
+/**
+ * Creates concatenation node, adjacent string literals are joined
+ * into one literal, eg. (E .. "a") .. "b" is E .. "ab".
+ * Sets global error flag on failure.
+ * @param arena Arena to allocate from.
+ * @param type Static type of the result.
+ * @param left Left operand.
+ * @param right Right operand.
+ * @return Created node. NULL if failed.
+ */
+exptree_node_t* exptree_concat(arena_t* arena, char type, exptree_node_t* left,
+                               exptree_node_t* right);
+
+/**
+ * Simplifies operation node whose operands are already simplified.
+ * Operations on literals are computed, identities (E * 1, E + 0,
+ * E // 1, ...) are removed if E cannot be nil and operations are
+ * replaced by cheaper ones (x * 2 is x + x, E / 4.0 is E * 0.25).
+ * Sets global error flag on failure.
+ * @param arena Arena to allocate from.
+ * @param node Node to simplify.
+ * @return Simplified node, equal to node if unchanged. NULL if failed.
+ */
+exptree_node_t* exptree_simplify(arena_t* arena, exptree_node_t* node);
+
+/**
+ * Is node a leaf?
+ * @param node Node to check.
+ * @return True if node has no operands.
+ */
+bool exptree_is_leaf(const exptree_node_t* node);
+
+/**
+ * Compares two subtrees.
+ * @param a First subtree.
+ * @param b Second subtree.
+ * @return True if both compute the same value from the same operands.
+ */
+bool exptree_equal(const exptree_node_t* a, const exptree_node_t* b);
+
+/**
+ * Copies subtree to another arena.
+ * Sets global error flag on failure.
+ * @param arena Arena to allocate from.
+ * @param node Root of the subtree.
+ * @return Copied subtree. NULL if failed.
+ */
+exptree_node_t* exptree_copy(arena_t* arena, const exptree_node_t* node);
+
+/**
+ * Evaluates expression containing only literals.
+ * Fails for variables and operations whose result could differ
+ * at runtime (runtime errors, integer overflow, non-ASCII strings).
+ * @param node Root of the expression.
+ * @param value Returns value of the expression.
+ * @return True if value is known. False otherwise.
+ */
+bool exptree_eval(const exptree_node_t* node, exptree_value_t* value);
+
+/**
+ * Evaluates expression as condition of if or while statement,
+ * nil and false are false, other values are true.
+ * @param node Root of the condition.
+ * @return Truth of the condition.
+ */
+exptree_truth_t exptree_truth(const exptree_node_t* node);
+
+#endif  // __EXPTREE_H__
@@ -0,0 +1,211 @@
+/**
+ * @file
+ * @brief Hash function implementation
+ * @author Tomas Martykan (xmarty07)
+ * @author Filip Stolfa (xstolf00)
+ * @author Patrik Korytar (xkoryt04)
+ *
+ * FIT VUT IFJ Project:
+ * Compiler of IFJ21 Language
+ */
+
+#include "hash.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if HASH_FUNCTION == HASH_SUPERFAST
+
+// PRIVATE FUNCTION FORWARD DECLARATIONS
+
+/**
+ * Hash function.
+ * @param data Key to hash.
+ * @param len Length of the key.
+ * @return Index created from key.
+ */
+uint32_t SuperFastHash(const char* data, int len);
+//--------------------------------------------------------------------------------------
+// APPLIES TO SINGLE FUNCTION DECLARATION ABOVE
+// TAKEN FROM: http://www.azillionmonkeys.com/qed/hash.html
+// COPYRIGHT: © Copyright 2004-2008 by Paul Hsieh
+// LICENSE: GNU Lesser General Public License v2.1
+// LICENSE TEXT: https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt
+// CHANGES MADE: 01.10.2021 - changed parameter type
+//--------------------------------------------------------------------------------------
+
+// FUNCTION DEFINITIONS
+
+uint32_t hash_key(const char* key, size_t len) {
+  return SuperFastHash(key, (int)len);
+}
+
+const char* hash_name() { return "SuperFastHash"; }
+
+//--------------------------------------------------------------------------------------
+// TAKEN CODE
+// TAKEN FROM: http://www.azillionmonkeys.com/qed/hash.html
+// COPYRIGHT: © Copyright 2004-2008 by Paul Hsieh
+// LICENSE: GNU Lesser General Public License v2.1
+// LICENSE TEXT: https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt
+// CHANGES MADE: 01.10.2021 - changed parameter type
+
+#undef get16bits
+#if (defined(__GNUC__) && defined(__i386__)) || defined(__WATCOMC__) || \
+    defined(_MSC_VER) || defined(__BORLANDC__) || defined(__TURBOC__)
+#define get16bits(d) (*((const uint16_t*)(d)))
+#endif
+
+#if !defined(get16bits)
+#define get16bits(d)                               \
+  ((((uint32_t)(((const uint8_t*)(d))[1])) << 8) + \
+   (uint32_t)(((const uint8_t*)(d))[0]))
+#endif
+
+uint32_t SuperFastHash(const char* data, int len) {
+  uint32_t hash = len, tmp;
+  int rem;
+
+  if (len <= 0 || data == NULL) return 0;
+
+  rem = len & 3;
+  len >>= 2;
+
+  /* Main loop */
+  for (; len > 0; len--) {
+    hash += get16bits(data);
+    tmp = (get16bits(data + 2) << 11) ^ hash;
+    hash = (hash << 16) ^ tmp;
+    data += 2 * sizeof(uint16_t);
+    hash += hash >> 11;
+  }
+
+  /* Handle end cases */
+  switch (rem) {
+    case 3:
+      hash += get16bits(data);
+      hash ^= hash << 16;
+      hash ^= ((signed char)data[sizeof(uint16_t)]) << 18;
+      hash += hash >> 11;
+      break;
+    case 2:
+      hash += get16bits(data);
+      hash ^= hash << 11;
+      hash += hash >> 17;
+      break;
+    case 1:
+      hash += (signed char)*data;
+      hash ^= hash << 10;
+      hash += hash >> 1;
+  }
+
+  /* Force "avalanching" of final 127 bits */
+  hash ^= hash << 3;
+  hash += hash >> 5;
+  hash ^= hash << 4;
+  hash += hash >> 17;
+  hash ^= hash << 25;
+  hash += hash >> 6;
+
+  return hash;
+}
+
+// END OF TAKEN CODE
+//--------------------------------------------------------------------------------------
+
+#elif HASH_FUNCTION == HASH_WY
+
+// COMPILE-TIME CONSTANTS
+
+#define WY_SECRET0 0xa0761d6478bd642full /**< Mixing constant. */
+#define WY_SECRET1 0xe7037ed1a0b428dbull /**< Mixing constant. */
+
+// PRIVATE FUNCTION FORWARD DECLARATIONS
+
+/**
+ * Multiplies two 64 bit numbers and folds the 128 bit product.
+ * Computed from 32 bit halves, so no 128 bit type is needed.
+ * @param a First operand.
+ * @param b Second operand.
+ * @return Xor of the upper and lower half of the product.
+ */
+uint64_t wy_mix(uint64_t a, uint64_t b);
+
+/**
+ * Reads 8 bytes of key.
+ * @param p Pointer to the key.
+ * @return Read bytes.
+ */
+uint64_t wy_read8(const uint8_t* p);
+
+/**
+ * Reads 4 bytes of key.
+ * @param p Pointer to the key.
+ * @return Read bytes.
+ */
+uint64_t wy_read4(const uint8_t* p);
+
+// FUNCTION DEFINITIONS
+
+uint32_t hash_key(const char* key, size_t len) {
+  const uint8_t* p = (const uint8_t*)key;
+  uint64_t seed = WY_SECRET0;
+  uint64_t a, b;
+
+  if (len <= 16) {
+    if (len >= 4) {
+      // two overlapping loads from both ends cover keys of 4 to 16 bytes
+      size_t off = (len >> 3) << 2;
+      a = (wy_read4(p) << 32) | wy_read4(p + off);
+      b = (wy_read4(p + len - 4) << 32) | wy_read4(p + len - 4 - off);
+    } else if (len > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+    for (; i > 16; i -= 16, p += 16) {
+      seed = wy_mix(wy_read8(p) ^ WY_SECRET1, wy_read8(p + 8) ^ seed);
+    }
+    a = wy_read8(p + i - 16);
+    b = wy_read8(p + i - 8);
+  }
+
+  uint64_t hash = wy_mix(WY_SECRET1 ^ len, wy_mix(a ^ WY_SECRET1, b ^ seed));
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+const char* hash_name() { return "wyhash"; }
+
+uint64_t wy_mix(uint64_t a, uint64_t b) {
+  uint64_t ha = a >> 32, la = (uint32_t)a;
+  uint64_t hb = b >> 32, lb = (uint32_t)b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+
+  uint64_t t = rl + (rm0 << 32);
+  uint64_t carry = t < rl;
+  uint64_t lo = t + (rm1 << 32);
+  carry += lo < t;
+  uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+
+  return lo ^ hi;
+}
+
+uint64_t wy_read8(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint64_t wy_read4(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+#else
+#error "Unknown HASH_FUNCTION"
+#endif
@@ -0,0 +1,50 @@
+/**
+ * @file
+ * @brief Hash function API
+ * @author Tomas Martykan (xmarty07)
+ * @author Filip Stolfa (xstolf00)
+ * @author Patrik Korytar (xkoryt04)
+ *
+ * FIT VUT IFJ Project:
+ * Compiler of IFJ21 Language
+ *
+ * @section DESCRIPTION
+ *  Hash function used for identifiers. Scanner hashes identifiers
+ *  once and symbol table reuses the hash for all lookups.
+ *
+ * @section IMPLEMENTATION
+ *  Hash function is selected at build time by defining HASH_FUNCTION
+ *  to one of the HASH_* values, eg. -DHASH_FUNCTION=HASH_WY.
+ *  HASH_SUPERFAST - Paul Hsieh's SuperFastHash, 4 bytes per step.
+ *  HASH_WY - wyhash-style hash, reads short keys in at most two
+ *  overlapping 8 byte loads and mixes them with one multiplication.
+ */
+
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HASH_SUPERFAST 1 /**< SuperFastHash. */
+#define HASH_WY 2        /**< wyhash-style short key hash. */
+
+#ifndef HASH_FUNCTION
+#define HASH_FUNCTION HASH_SUPERFAST /**< Selected hash function. */
+#endif
+
+/**
+ * Hashes key with hash function selected at build time.
+ * @param key Key to hash.
+ * @param len Length of the key in bytes.
+ * @return Hash of the key.
+ */
+uint32_t hash_key(const char* key, size_t len);
+
+/**
+ * Name of hash function selected at build time.
+ * @return Name of the hash function.
+ */
+const char* hash_name();
+
+#endif  // __HASH_H__
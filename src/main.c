@@ -1,24 +1,76 @@
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
+#include "ast.h"
 #include "codegen.h"
 #include "errors.h"
+#include "expressions.h"
 #include "parser.h"
 #include "scanner.h"
 #include "scope.h"
 #include "syntax.h"
 
 int main(int argc, char **argv) {
-  (void)argc;
-  (void)argv;
+  // print symtable statistics to stderr
+  bool print_stats = false;
+  // print time spent parsing and generating code to stderr
+  bool print_time = false;
+  // number of threads generating code, number of processors if 0
+  int jobs = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--stats")) {
+      print_stats = true;
+    } else if (!strcmp(argv[i], "--time")) {
+      print_time = true;
+    } else if (!strcmp(argv[i], "-O2")) {
+      // calls of small leaf functions are replaced by their bodies
+      codegen_inlining = true;
+    } else if (!strcmp(argv[i], "--jobs") && i + 1 < argc) {
+      jobs = atoi(argv[++i]);
+    }
+  }
 
   scanner_init();
   parser_init_symtab();
   codegen_init();
   scope_init();
+  ast_init();
+
+  if (print_stats) {
+    symtab_stats_enable(symtab);
+  }
 
+  clock_t parse_start = clock();
   parser_start();
+  clock_t codegen_start = clock();
+  if (!error_get()) {
+    // functions not called from the top level are not generated
+    ast_prune();
+  }
+  if (!error_get()) {
+    codegen_program(ast_program, jobs);
+  }
+  clock_t codegen_stop = clock();
+
+  if (print_time) {
+    fprintf(stderr, "parse: %.3f ms\ncodegen: %.3f ms\n",
+            (codegen_start - parse_start) * 1000.0 / CLOCKS_PER_SEC,
+            (codegen_stop - codegen_start) * 1000.0 / CLOCKS_PER_SEC);
+  }
+
+  if (print_stats) {
+    symtab_stats_print(symtab, stderr);
+    if (codegen_inlining) {
+      fprintf(stderr, "inlined calls: %d\n", codegen_inlined);
+    }
+  }
 
+  ast_free();
   scope_destroy();
+  expression_destroy();
   codegen_free();
   scanner_destroy();
   parser_destroy_symtab();
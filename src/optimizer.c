@@ -0,0 +1,1418 @@
+/**
+ * @file
+ * @brief Optimizer of generated code implementation
+ * @author Tomas Martykan (xmarty07)
+ * @author Filip Stolfa (xstolf00)
+ * @author Patrik Korytar (xkoryt04)
+ *
+ * FIT VUT IFJ Project:
+ * Compiler of IFJ21 Language
+ */
+
+#include "optimizer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errors.h"
+#include "hash.h"
+
+// COMPILE-TIME CONSTANTS
+
+#define OPTIMIZER_STACK_DEPTH 64 /**< Number of tracked data stack values. */
+
+// DATA STRUCTURES
+
+/**
+ * @struct optimizer_null_t
+ * @brief State of nullability analysis at a point of code.
+ * @var optimizer_null_t::vars
+ *  Bit i is set if LF variable i cannot be nil.
+ * @var optimizer_null_t::stack
+ *  Bit i is set if i-th value from the top of data stack cannot be nil.
+ * @var optimizer_null_t::depth
+ *  Number of known values on the top of data stack.
+ */
+typedef struct {
+  uint64_t* vars;
+  uint64_t stack;
+  int depth;
+} optimizer_null_t;
+
+/**
+ * @brief Opcode and its effect.
+ */
+typedef struct {
+  const char* op;
+  optimizer_effect_t effect;
+} optimizer_opcode_t;
+
+/**
+ * Effects of IFJcode21 instructions, missing ones are OPT_OTHER.
+ */
+const optimizer_opcode_t optimizer_opcodes[] = {
+    {"MOVE", OPT_MOVE},           {"DEFVAR", OPT_UNDEF},
+    {"READ", OPT_UNDEF},          {"PUSHS", OPT_PUSH},
+    {"POPS", OPT_POP},            {"CLEARS", OPT_CLEARS},
+    {"CALL", OPT_CALL},           {"CREATEFRAME", OPT_NONE},
+    {"RETURN", OPT_NONE},         {"LABEL", OPT_NONE},
+    {"JUMP", OPT_NONE},           {"JUMPIFEQ", OPT_NONE},
+    {"JUMPIFNEQ", OPT_NONE},      {"EXIT", OPT_NONE},
+    {"WRITE", OPT_NONE},          {"DPRINT", OPT_NONE},
+    {"BREAK", OPT_NONE},          {"ADD", OPT_DEST},
+    {"SUB", OPT_DEST},            {"MUL", OPT_DEST},
+    {"DIV", OPT_DEST},            {"IDIV", OPT_DEST},
+    {"LT", OPT_DEST},             {"GT", OPT_DEST},
+    {"EQ", OPT_DEST},             {"AND", OPT_DEST},
+    {"OR", OPT_DEST},             {"NOT", OPT_DEST},
+    {"INT2FLOAT", OPT_DEST},      {"FLOAT2INT", OPT_DEST},
+    {"INT2CHAR", OPT_DEST},       {"STRI2INT", OPT_DEST},
+    {"CONCAT", OPT_DEST},         {"STRLEN", OPT_DEST},
+    {"GETCHAR", OPT_DEST},        {"SETCHAR", OPT_DEST},
+    {"TYPE", OPT_DEST},           {"ADDS", OPT_STACK_BINARY},
+    {"SUBS", OPT_STACK_BINARY},   {"MULS", OPT_STACK_BINARY},
+    {"DIVS", OPT_STACK_BINARY},   {"IDIVS", OPT_STACK_BINARY},
+    {"LTS", OPT_STACK_BINARY},    {"GTS", OPT_STACK_BINARY},
+    {"EQS", OPT_STACK_BINARY},    {"ANDS", OPT_STACK_BINARY},
+    {"ORS", OPT_STACK_BINARY},    {"STRI2INTS", OPT_STACK_BINARY},
+    {"NOTS", OPT_STACK_UNARY},    {"INT2FLOATS", OPT_STACK_UNARY},
+    {"FLOAT2INTS", OPT_STACK_UNARY}, {"INT2CHARS", OPT_STACK_UNARY},
+    {"JUMPIFEQS", OPT_STACK_BRANCH}, {"JUMPIFNEQS", OPT_STACK_BRANCH},
+};
+
+// PRIVATE FUNCTION FORWARD DECLARATIONS
+
+/**
+ * Allocates empty table.
+ * Sets global error flag on failure.
+ * @return True if successful. False otherwise.
+ */
+bool optimizer_table_init(optimizer_table_t* table);
+
+/**
+ * Frees table.
+ */
+void optimizer_table_free(optimizer_table_t* table);
+
+/**
+ * Finds slot of name, or empty slot where it belongs.
+ */
+int optimizer_table_slot(const optimizer_table_t* table, const char* key);
+
+/**
+ * Finds index of name.
+ * @return Index of the name, -1 if not found.
+ */
+int optimizer_table_find(const optimizer_table_t* table, const char* key);
+
+/**
+ * Adds name if it is not in the table yet, grows the table as needed.
+ * Sets global error flag on failure.
+ * @param value Index of the name if it is added.
+ * @return Index of the name, -1 if failed.
+ */
+int optimizer_table_add(optimizer_table_t* table, const char* key, int value);
+
+/**
+ * Splits line into opcode and operands.
+ * @return True if successful. False if line format is not supported.
+ */
+bool optimizer_parse_instr(optimizer_instr_t* instr, char* line);
+
+/**
+ * Does instruction end basic block?
+ */
+bool optimizer_is_terminator(const optimizer_instr_t* instr);
+
+/**
+ * Is instruction a jump to label (conditional or not)?
+ */
+bool optimizer_is_jump(const optimizer_instr_t* instr);
+
+/**
+ * Does execution continue after instruction?
+ */
+bool optimizer_falls(const optimizer_instr_t* instr);
+
+/**
+ * Finds next instruction which was not removed, skipping comments.
+ * @param from Index to start searching after.
+ * @param last Last index to search.
+ * @return Index of the instruction, -1 if none.
+ */
+int optimizer_next(const optimizer_func_t* func, int from, int last);
+
+/**
+ * Finds successors of block, skipping removed instructions.
+ * @param succ Array of two indices of blocks to fill.
+ * @return Number of successors.
+ */
+int optimizer_successors(const optimizer_func_t* func, int b, int* succ);
+
+/**
+ * Marks blocks reachable from the function entry,
+ * skipping removed instructions.
+ * @param reached Array of block count flags to fill.
+ */
+void optimizer_reach(const optimizer_func_t* func, bool* reached);
+
+/**
+ * Can operand of instruction be nil?
+ */
+bool optimizer_null_operand(const optimizer_instr_t* instr, int i,
+                            const optimizer_null_t* state);
+
+/**
+ * Applies effect of instruction to nullability state.
+ */
+void optimizer_null_transfer(optimizer_null_t* state,
+                             const optimizer_instr_t* instr, int words);
+
+/**
+ * Applies knowledge from comparison with nil of branch
+ * at the end of block to nullability state.
+ * @param taken Is state for the jump target, or the next block?
+ */
+void optimizer_null_branch(optimizer_null_t* state,
+                           const optimizer_instr_t* instr, bool taken);
+
+/**
+ * Sets whether variable cannot be nil.
+ */
+void optimizer_null_set(optimizer_null_t* state, int var, bool not_nil);
+
+/**
+ * Pushes value to the data stack.
+ */
+void optimizer_null_push(optimizer_null_t* state, bool not_nil);
+
+/**
+ * Pops value from the data stack.
+ * @return True if popped value cannot be nil.
+ */
+bool optimizer_null_pop(optimizer_null_t* state);
+
+/**
+ * Merges state into the state at the beginning of block.
+ * @param seen Was the block reached already? Set to true.
+ * @return True if the state of the block changed.
+ */
+bool optimizer_null_merge(optimizer_null_t* into, bool* seen,
+                          const optimizer_null_t* state, int words);
+
+/**
+ * Is operand a literal (int@, float@, string@, bool@, nil@)?
+ */
+bool optimizer_is_const(const char* arg);
+
+/**
+ * Does code CALL a label of the function, sharing its frame?
+ */
+bool optimizer_calls_inside(const optimizer_func_t* func);
+
+/**
+ * Is the first operand assigned by instruction, not used?
+ * SETCHAR changes its destination in place.
+ */
+bool optimizer_defines(const optimizer_instr_t* instr);
+
+/**
+ * Forgets copies into and from variable assigned by instruction.
+ * @param copies Source of the value of each LF variable, NULL if unknown.
+ */
+void optimizer_copy_kill(const char** copies, int vars,
+                         const optimizer_instr_t* instr);
+
+/**
+ * Applies instruction to known copies.
+ * @param rewrite Are used variables replaced by their sources?
+ */
+void optimizer_copy_transfer(const optimizer_func_t* func, const char** copies,
+                             optimizer_instr_t* instr, bool rewrite);
+
+/**
+ * Merges copies into the copies at the beginning of block,
+ * only copies known on all paths are kept.
+ * @param seen Was the block reached already? Set to true.
+ * @return True if the copies of the block changed.
+ */
+bool optimizer_copy_merge(const char** into, bool* seen, const char** copies,
+                          int vars);
+
+/**
+ * Finds live variables after the last instruction of block.
+ * @param in Live variables at the beginning of each block.
+ */
+void optimizer_live_out(const optimizer_func_t* func, int b,
+                        const uint64_t* in, uint64_t* live, int words);
+
+/**
+ * Is operand a temporary of generated code?
+ */
+bool optimizer_is_temp(const char* arg);
+
+/**
+ * Finds temporaries among operands of instruction.
+ * @param temp Indices of temporaries by indices of LF variables,
+ *  NULL to take all LF variables.
+ * @param operands Array of three indices of temporaries to fill,
+ *  -1 for other operands.
+ * @return Is the first operand defined by instruction, not used?
+ */
+bool optimizer_temp_operands(const optimizer_instr_t* instr, const int* temp,
+                             int* operands);
+
+/**
+ * Applies instruction to set of temporaries live after it, backwards.
+ */
+void optimizer_live_transfer(uint64_t* live, const optimizer_instr_t* instr,
+                             const int* temp);
+
+/**
+ * Removes condition nil check starting at instruction i if value is not nil:
+ * PUSHS nil@nil, EQS, NOTS, POPS var, JUMPIFEQ label var bool@false
+ * Value is still popped, but the branch is never taken.
+ */
+void optimizer_null_condition(optimizer_func_t* func, int i, int last);
+
+// FUNCTION DEFINITIONS
+
+// NAME TABLES
+
+bool optimizer_table_init(optimizer_table_t* table) {
+  table->size = 64;
+  table->count = 0;
+  table->keys = calloc(table->size, sizeof(char*));
+  table->values = malloc(sizeof(int) * table->size);
+  if (!table->keys || !table->values) {
+    error_set(EXITSTATUS_INTERNAL_ERROR);
+    return false;
+  }
+  return true;
+}
+
+void optimizer_table_free(optimizer_table_t* table) {
+  free(table->keys);
+  free(table->values);
+  table->keys = NULL;
+  table->values = NULL;
+  table->size = 0;
+  table->count = 0;
+}
+
+int optimizer_table_slot(const optimizer_table_t* table, const char* key) {
+  int i = hash_key(key, strlen(key)) & (table->size - 1);
+  while (table->keys[i] && strcmp(table->keys[i], key)) {
+    i = (i + 1) & (table->size - 1);
+  }
+  return i;
+}
+
+int optimizer_table_find(const optimizer_table_t* table, const char* key) {
+  int i = optimizer_table_slot(table, key);
+  return table->keys[i] ? table->values[i] : -1;
+}
+
+int optimizer_table_add(optimizer_table_t* table, const char* key, int value) {
+  int i = optimizer_table_slot(table, key);
+  if (table->keys[i]) {
+    return table->values[i];
+  }
+
+  // keep at most half of slots used
+  if (2 * (table->count + 1) > table->size) {
+    optimizer_table_t bigger = {NULL, NULL, table->size * 2, 0};
+    bigger.keys = calloc(bigger.size, sizeof(char*));
+    bigger.values = malloc(sizeof(int) * bigger.size);
+    if (!bigger.keys || !bigger.values) {
+      optimizer_table_free(&bigger);
+      error_set(EXITSTATUS_INTERNAL_ERROR);
+      return -1;
+    }
+    for (int j = 0; j < table->size; j++) {
+      if (table->keys[j]) {
+        int slot = optimizer_table_slot(&bigger, table->keys[j]);
+        bigger.keys[slot] = table->keys[j];
+        bigger.values[slot] = table->values[j];
+      }
+    }
+    bigger.count = table->count;
+    optimizer_table_free(table);
+    *table = bigger;
+    i = optimizer_table_slot(table, key);
+  }
+
+  table->keys[i] = key;
+  table->values[i] = value;
+  table->count++;
+  return value;
+}
+
+// PARSING
+
+bool optimizer_parse_instr(optimizer_instr_t* instr, char* line) {
+  instr->op = NULL;
+  instr->argc = 0;
+  instr->effect = OPT_NONE;
+  instr->removed = false;
+  for (int i = 0; i < 3; i++) {
+    instr->args[i] = NULL;
+    instr->var[i] = -1;
+  }
+
+  if (line[0] == '\0' || line[0] == '#') {
+    instr->args[0] = line;
+    return true;
+  }
+
+  instr->op = line;
+  char* p = strchr(line, ' ');
+  while (p) {
+    *p++ = '\0';
+    // only single spaces between operands are printed back the same
+    if (instr->argc == 3 || *p == '\0' || *p == ' ') {
+      return false;
+    }
+    instr->args[instr->argc++] = p;
+    p = strchr(p, ' ');
+  }
+
+  instr->effect = OPT_OTHER;
+  for (size_t i = 0; i < sizeof(optimizer_opcodes) / sizeof(*optimizer_opcodes);
+       i++) {
+    if (optimizer_opcodes[i].op[0] == instr->op[0] &&
+        !strcmp(optimizer_opcodes[i].op, instr->op)) {
+      instr->effect = optimizer_opcodes[i].effect;
+      break;
+    }
+  }
+  return true;
+}
+
+bool optimizer_is_jump(const optimizer_instr_t* instr) {
+  // JUMP, JUMPIFEQ, JUMPIFNEQ, JUMPIFEQS, JUMPIFNEQS
+  return instr->op && !strncmp(instr->op, "JUMP", 4);
+}
+
+bool optimizer_falls(const optimizer_instr_t* instr) {
+  return !instr->op ||
+         (strcmp(instr->op, "JUMP") && strcmp(instr->op, "RETURN") &&
+          strcmp(instr->op, "EXIT"));
+}
+
+bool optimizer_is_terminator(const optimizer_instr_t* instr) {
+  return optimizer_is_jump(instr) || !optimizer_falls(instr);
+}
+
+bool optimizer_parse(optimizer_func_t* func, const char* code) {
+  arena_init(&func->arena);
+  func->instrs = NULL;
+  func->count = 0;
+  func->blocks = NULL;
+  func->block_count = 0;
+  func->labels.keys = func->vars.keys = NULL;
+  func->labels.values = func->vars.values = NULL;
+  if (!optimizer_table_init(&func->labels) ||
+      !optimizer_table_init(&func->vars)) {
+    return false;
+  }
+
+  char* text = arena_strdup(&func->arena, code);
+  if (!text) {
+    return false;
+  }
+
+  int lines = 1;
+  for (char* p = strchr(text, '\n'); p; p = strchr(p + 1, '\n')) {
+    lines++;
+  }
+  func->instrs = arena_alloc(&func->arena, sizeof(optimizer_instr_t) * lines);
+  func->blocks = arena_alloc(&func->arena, sizeof(optimizer_block_t) * lines);
+  if (!func->instrs || !func->blocks) {
+    return false;
+  }
+
+  // instructions, text after the last new line is ignored if empty
+  char* line = text;
+  while (*line) {
+    char* end = strchr(line, '\n');
+    if (end) {
+      *end = '\0';
+    }
+    if (!optimizer_parse_instr(&func->instrs[func->count], line)) {
+      return false;
+    }
+    func->count++;
+    if (!end) {
+      break;
+    }
+    line = end + 1;
+  }
+
+  // basic blocks and labels
+  for (int i = 0; i < func->count; i++) {
+    optimizer_instr_t* instr = &func->instrs[i];
+    bool label = instr->op && !strcmp(instr->op, "LABEL");
+    if (i == 0 || label || optimizer_is_terminator(&func->instrs[i - 1])) {
+      optimizer_block_t* block = &func->blocks[func->block_count++];
+      block->first = i;
+      block->target = -1;
+      block->falls = true;
+      block->reachable = false;
+    }
+    func->blocks[func->block_count - 1].last = i;
+
+    if (label) {
+      if (instr->argc != 1 ||
+          optimizer_table_add(&func->labels, instr->args[0],
+                              func->block_count - 1) != func->block_count - 1) {
+        return false;
+      }
+    }
+
+    // LF variables
+    for (int j = 0; j < instr->argc; j++) {
+      if (!strncmp(instr->args[j], "LF@", 3)) {
+        instr->var[j] = optimizer_table_add(&func->vars, instr->args[j],
+                                            func->vars.count);
+        if (instr->var[j] < 0) {
+          return false;
+        }
+      }
+    }
+  }
+
+  // control flow
+  for (int b = 0; b < func->block_count; b++) {
+    optimizer_block_t* block = &func->blocks[b];
+    optimizer_instr_t* last = &func->instrs[block->last];
+    block->falls = optimizer_falls(last) && b + 1 < func->block_count;
+    if (optimizer_is_jump(last)) {
+      block->target =
+          last->argc ? optimizer_table_find(&func->labels, last->args[0]) : -1;
+      if (block->target < 0) {
+        return false;
+      }
+    }
+  }
+
+  bool* reached = arena_alloc(&func->arena, sizeof(bool) * func->block_count);
+  if (func->block_count && !reached) {
+    return false;
+  }
+  optimizer_reach(func, reached);
+  for (int b = 0; b < func->block_count; b++) {
+    func->blocks[b].reachable = reached[b];
+  }
+
+  return true;
+}
+
+void optimizer_print(const optimizer_func_t* func, dynstr_t* out) {
+  for (int i = 0; i < func->count; i++) {
+    const optimizer_instr_t* instr = &func->instrs[i];
+    if (instr->removed) {
+      continue;
+    }
+    if (!instr->op) {
+      dynstr_append_str(out, instr->args[0]);
+    } else {
+      dynstr_append_str(out, instr->op);
+      for (int j = 0; j < instr->argc; j++) {
+        dynstr_append(out, ' ');
+        dynstr_append_str(out, instr->args[j]);
+      }
+    }
+    dynstr_append(out, '\n');
+  }
+}
+
+void optimizer_free(optimizer_func_t* func) {
+  optimizer_table_free(&func->labels);
+  optimizer_table_free(&func->vars);
+  arena_free(&func->arena);
+}
+
+// CONTROL FLOW
+
+int optimizer_next(const optimizer_func_t* func, int from, int last) {
+  for (int i = from + 1; i <= last; i++) {
+    if (func->instrs[i].op && !func->instrs[i].removed) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int optimizer_successors(const optimizer_func_t* func, int b, int* succ) {
+  const optimizer_block_t* block = &func->blocks[b];
+
+  // last instruction which was not removed decides successors
+  const optimizer_instr_t* last = NULL;
+  for (int i = block->last; i >= block->first; i--) {
+    if (func->instrs[i].op && !func->instrs[i].removed) {
+      last = &func->instrs[i];
+      break;
+    }
+  }
+  int count = 0;
+  if (last && optimizer_is_jump(last)) {
+    succ[count++] = block->target;
+  }
+  if ((!last || optimizer_falls(last)) && b + 1 < func->block_count) {
+    succ[count++] = b + 1;
+  }
+  return count;
+}
+
+void optimizer_reach(const optimizer_func_t* func, bool* reached) {
+  if (!func->block_count) {
+    return;
+  }
+  memset(reached, 0, sizeof(bool) * func->block_count);
+
+  // blocks are pushed once, stack of block count is enough
+  int* stack = malloc(sizeof(int) * func->block_count);
+  if (!stack) {
+    error_set(EXITSTATUS_INTERNAL_ERROR);
+    return;
+  }
+  int top = 0;
+  stack[top++] = 0;
+  reached[0] = true;
+
+  while (top) {
+    int b = stack[--top];
+    int succ[2];
+    int count = optimizer_successors(func, b, succ);
+    for (int i = 0; i < count; i++) {
+      if (!reached[succ[i]]) {
+        reached[succ[i]] = true;
+        stack[top++] = succ[i];
+      }
+    }
+  }
+
+  free(stack);
+}
+
+// NULLABILITY ANALYSIS
+
+bool optimizer_null_operand(const optimizer_instr_t* instr, int i,
+                            const optimizer_null_t* state) {
+  int var = instr->var[i];
+  if (var >= 0) {
+    return !(state->vars[var / 64] >> (var % 64) & 1);
+  }
+  const char* arg = instr->args[i];
+  return strncmp(arg, "int@", 4) && strncmp(arg, "float@", 6) &&
+         strncmp(arg, "string@", 7) && strncmp(arg, "bool@", 5);
+}
+
+void optimizer_null_set(optimizer_null_t* state, int var, bool not_nil) {
+  if (var < 0) {
+    return;
+  }
+  if (not_nil) {
+    state->vars[var / 64] |= (uint64_t)1 << (var % 64);
+  } else {
+    state->vars[var / 64] &= ~((uint64_t)1 << (var % 64));
+  }
+}
+
+void optimizer_null_push(optimizer_null_t* state, bool not_nil) {
+  state->stack = state->stack << 1 | not_nil;
+  if (state->depth < OPTIMIZER_STACK_DEPTH) {
+    state->depth++;
+  }
+}
+
+bool optimizer_null_pop(optimizer_null_t* state) {
+  if (!state->depth) {
+    return false;
+  }
+  bool not_nil = state->stack & 1;
+  state->stack >>= 1;
+  state->depth--;
+  return not_nil;
+}
+
+void optimizer_null_transfer(optimizer_null_t* state,
+                             const optimizer_instr_t* instr, int words) {
+  if (!instr->op || instr->removed) {
+    return;
+  }
+  switch (instr->effect) {
+    case OPT_NONE:
+      return;
+    case OPT_PUSH:
+      optimizer_null_push(state, !optimizer_null_operand(instr, 0, state));
+      return;
+    case OPT_POP:
+      optimizer_null_set(state, instr->var[0], optimizer_null_pop(state));
+      return;
+    case OPT_MOVE:
+      optimizer_null_set(state, instr->var[0],
+                         !optimizer_null_operand(instr, 1, state));
+      return;
+    case OPT_UNDEF:
+      optimizer_null_set(state, instr->var[0], false);
+      return;
+    case OPT_DEST:
+      // interpreter fails on nil operands, result is never nil
+      optimizer_null_set(state, instr->var[0], true);
+      return;
+    case OPT_STACK_UNARY:
+      optimizer_null_pop(state);
+      optimizer_null_push(state, true);
+      return;
+    case OPT_STACK_BINARY:
+      optimizer_null_pop(state);
+      optimizer_null_pop(state);
+      optimizer_null_push(state, true);
+      return;
+    case OPT_STACK_BRANCH:
+      optimizer_null_pop(state);
+      optimizer_null_pop(state);
+      return;
+    case OPT_CALL:
+    case OPT_CLEARS:
+      state->depth = 0;
+      return;
+    case OPT_OTHER:
+      memset(state->vars, 0, sizeof(uint64_t) * words);
+      state->depth = 0;
+      return;
+  }
+}
+
+void optimizer_null_branch(optimizer_null_t* state,
+                           const optimizer_instr_t* instr, bool taken) {
+  if (!instr->op || instr->argc != 3) {
+    return;
+  }
+  // JUMPIFEQ is not taken and JUMPIFNEQ is taken if operand is not nil
+  bool eq = !strcmp(instr->op, "JUMPIFEQ");
+  if (!(eq && !taken) && !(!eq && taken && !strcmp(instr->op, "JUMPIFNEQ"))) {
+    return;
+  }
+  if (!strcmp(instr->args[1], "nil@nil")) {
+    optimizer_null_set(state, instr->var[2], true);
+  } else if (!strcmp(instr->args[2], "nil@nil")) {
+    optimizer_null_set(state, instr->var[1], true);
+  }
+}
+
+bool optimizer_null_merge(optimizer_null_t* into, bool* seen,
+                          const optimizer_null_t* state, int words) {
+  if (!*seen) {
+    *seen = true;
+    memcpy(into->vars, state->vars, sizeof(uint64_t) * words);
+    into->stack = state->stack;
+    into->depth = state->depth;
+    return true;
+  }
+
+  bool changed = false;
+  for (int i = 0; i < words; i++) {
+    uint64_t merged = into->vars[i] & state->vars[i];
+    changed |= merged != into->vars[i];
+    into->vars[i] = merged;
+  }
+  int depth = into->depth < state->depth ? into->depth : state->depth;
+  uint64_t mask = depth == 64 ? ~(uint64_t)0 : ((uint64_t)1 << depth) - 1;
+  uint64_t stack = into->stack & state->stack & mask;
+  changed |= depth != into->depth || stack != into->stack;
+  into->depth = depth;
+  into->stack = stack;
+  return changed;
+}
+
+void optimizer_null_condition(optimizer_func_t* func, int i, int last) {
+  int seq[5] = {i};
+  for (int j = 1; j < 5; j++) {
+    seq[j] = optimizer_next(func, seq[j - 1], last);
+    if (seq[j] < 0) {
+      return;
+    }
+  }
+  optimizer_instr_t* pop = &func->instrs[seq[3]];
+  optimizer_instr_t* jump = &func->instrs[seq[4]];
+  if (strcmp(func->instrs[seq[1]].op, "EQS") ||
+      strcmp(func->instrs[seq[2]].op, "NOTS") || strcmp(pop->op, "POPS") ||
+      strcmp(jump->op, "JUMPIFEQ") || jump->argc != 3 ||
+      strcmp(jump->args[1], pop->args[0]) ||
+      strcmp(jump->args[2], "bool@false")) {
+    return;
+  }
+  func->instrs[seq[0]].removed = true;
+  func->instrs[seq[1]].removed = true;
+  func->instrs[seq[2]].removed = true;
+  jump->removed = true;
+}
+
+void optimizer_nullability(optimizer_func_t* func) {
+  int words = (func->vars.count + 63) / 64;
+  if (!func->block_count ||
+      (long)func->block_count * (words + 1) > OPTIMIZER_MAX_STATE_WORDS) {
+    return;
+  }
+
+  int count = func->block_count;
+  optimizer_null_t* in = malloc(sizeof(optimizer_null_t) * count);
+  uint64_t* bits = calloc((size_t)count * words + 2 * words + 1,
+                          sizeof(uint64_t));
+  bool* seen = calloc(count, sizeof(bool));
+  bool* queued = calloc(count, sizeof(bool));
+  int* queue = malloc(sizeof(int) * count);
+  if (!in || !bits || !seen || !queued || !queue) {
+    error_set(EXITSTATUS_INTERNAL_ERROR);
+    goto FREE;
+  }
+  for (int b = 0; b < count; b++) {
+    in[b].vars = bits + (size_t)b * words;
+  }
+  optimizer_null_t state = {bits + (size_t)count * words, 0, 0};
+  optimizer_null_t edge = {bits + (size_t)count * words + words, 0, 0};
+
+  // entry: nothing is known
+  optimizer_null_merge(&in[0], &seen[0], &state, words);
+  int head = 0, tail = 0;
+  queue[tail++] = 0;
+  queued[0] = true;
+
+  // forward must analysis, circular queue of blocks with changed input
+  while (head != tail) {
+    int b = queue[head];
+    head = (head + 1) % count;
+    queued[b] = false;
+
+    const optimizer_block_t* block = &func->blocks[b];
+    memcpy(state.vars, in[b].vars, sizeof(uint64_t) * words);
+    state.stack = in[b].stack;
+    state.depth = in[b].depth;
+    for (int i = block->first; i <= block->last; i++) {
+      optimizer_null_transfer(&state, &func->instrs[i], words);
+    }
+
+    const optimizer_instr_t* last = &func->instrs[block->last];
+    for (int taken = 0; taken < 2; taken++) {
+      int succ = taken ? block->target : (block->falls ? b + 1 : -1);
+      if (succ < 0) {
+        continue;
+      }
+      memcpy(edge.vars, state.vars, sizeof(uint64_t) * words);
+      edge.stack = state.stack;
+      edge.depth = state.depth;
+      optimizer_null_branch(&edge, last, taken);
+      if (optimizer_null_merge(&in[succ], &seen[succ], &edge, words) &&
+          !queued[succ]) {
+        queued[succ] = true;
+        queue[tail] = succ;
+        tail = (tail + 1) % count;
+      }
+    }
+  }
+
+  // remove checks of values which cannot be nil
+  for (int b = 0; b < count; b++) {
+    if (!seen[b]) {
+      continue;
+    }
+    const optimizer_block_t* block = &func->blocks[b];
+    memcpy(state.vars, in[b].vars, sizeof(uint64_t) * words);
+    state.stack = in[b].stack;
+    state.depth = in[b].depth;
+    for (int i = block->first; i <= block->last; i++) {
+      optimizer_instr_t* instr = &func->instrs[i];
+      if (instr->op && !instr->removed) {
+        // write: JUMPIFEQ label nil@nil symb
+        if (!strcmp(instr->op, "JUMPIFEQ") && instr->argc == 3) {
+          if ((!strcmp(instr->args[1], "nil@nil") &&
+               !optimizer_null_operand(instr, 2, &state)) ||
+              (!strcmp(instr->args[2], "nil@nil") &&
+               !optimizer_null_operand(instr, 1, &state))) {
+            instr->removed = true;
+          }
+        } else if (!strcmp(instr->op, "PUSHS") && state.depth &&
+                   (state.stack & 1) && !strcmp(instr->args[0], "nil@nil")) {
+          optimizer_null_condition(func, i, block->last);
+        }
+      }
+      optimizer_null_transfer(&state, instr, words);
+    }
+  }
+
+FREE:
+  free(in);
+  free(bits);
+  free(seen);
+  free(queued);
+  free(queue);
+}
+
+// DEAD CODE
+
+void optimizer_remove_dead(optimizer_func_t* func) {
+  int count = func->block_count;
+  if (!count) {
+    return;
+  }
+  bool* reached = malloc(sizeof(bool) * count);
+  int* refs = calloc(count, sizeof(int));
+  if (!reached || !refs) {
+    error_set(EXITSTATUS_INTERNAL_ERROR);
+    free(reached);
+    free(refs);
+    return;
+  }
+
+  // blocks reachable only through removed branches
+  optimizer_reach(func, reached);
+  for (int b = 0; b < count; b++) {
+    if (func->blocks[b].reachable && !reached[b]) {
+      for (int i = func->blocks[b].first; i <= func->blocks[b].last; i++) {
+        optimizer_instr_t* instr = &func->instrs[i];
+        if (!instr->op || strcmp(instr->op, "LABEL")) {
+          instr->removed = true;
+        }
+      }
+    }
+  }
+
+  // jumps to the next instruction
+  for (int i = 0; i < func->count; i++) {
+    optimizer_instr_t* instr = &func->instrs[i];
+    if (!instr->op || instr->removed || strcmp(instr->op, "JUMP")) {
+      continue;
+    }
+    for (int j = optimizer_next(func, i, func->count - 1);
+         j >= 0 && !strcmp(func->instrs[j].op, "LABEL");
+         j = optimizer_next(func, j, func->count - 1)) {
+      if (!strcmp(func->instrs[j].args[0], instr->args[0])) {
+        instr->removed = true;
+        break;
+      }
+    }
+  }
+
+  // labels nothing jumps to, code not reachable from entry may be called
+  for (int i = 0; i < func->count; i++) {
+    optimizer_instr_t* instr = &func->instrs[i];
+    if (instr->op && !instr->removed &&
+        (optimizer_is_jump(instr) || instr->effect == OPT_CALL)) {
+      int b = optimizer_table_find(&func->labels, instr->args[0]);
+      if (b >= 0) {
+        refs[b]++;
+      }
+    }
+  }
+  for (int b = 0; b < count; b++) {
+    optimizer_instr_t* first = &func->instrs[func->blocks[b].first];
+    if (func->blocks[b].reachable && !refs[b] && first->op &&
+        !strcmp(first->op, "LABEL")) {
+      first->removed = true;
+    }
+  }
+
+  free(reached);
+  free(refs);
+}
+
+// COPIES
+
+bool optimizer_is_const(const char* arg) {
+  return !strncmp(arg, "int@", 4) || !strncmp(arg, "float@", 6) ||
+         !strncmp(arg, "string@", 7) || !strncmp(arg, "bool@", 5) ||
+         !strncmp(arg, "nil@", 4);
+}
+
+bool optimizer_calls_inside(const optimizer_func_t* func) {
+  for (int i = 0; i < func->count; i++) {
+    const optimizer_instr_t* instr = &func->instrs[i];
+    if (instr->effect == OPT_CALL && instr->argc &&
+        optimizer_table_find(&func->labels, instr->args[0]) >= 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool optimizer_defines(const optimizer_instr_t* instr) {
+  return (instr->effect == OPT_MOVE || instr->effect == OPT_POP ||
+          instr->effect == OPT_UNDEF || instr->effect == OPT_DEST) &&
+         strcmp(instr->op, "SETCHAR");
+}
+
+void optimizer_copy_kill(const char** copies, int vars,
+                         const optimizer_instr_t* instr) {
+  if (instr->var[0] < 0) {
+    return;
+  }
+  copies[instr->var[0]] = NULL;
+  for (int v = 0; v < vars; v++) {
+    if (copies[v] && !strcmp(copies[v], instr->args[0])) {
+      copies[v] = NULL;
+    }
+  }
+}
+
+void optimizer_copy_transfer(const optimizer_func_t* func, const char** copies,
+                             optimizer_instr_t* instr, bool rewrite) {
+  if (!instr->op || instr->removed) {
+    return;
+  }
+  int vars = func->vars.count;
+  if (instr->effect == OPT_OTHER) {
+    memset(copies, 0, sizeof(char*) * vars);
+    return;
+  }
+
+  // destination of SETCHAR has to stay a variable
+  if (rewrite) {
+    for (int j = instr->effect == OPT_DEST || optimizer_defines(instr);
+         j < instr->argc; j++) {
+      const char* source = instr->var[j] >= 0 ? copies[instr->var[j]] : NULL;
+      if (source) {
+        instr->args[j] = (char*)source;
+        instr->var[j] = optimizer_is_const(source)
+                            ? -1
+                            : optimizer_table_find(&func->vars, source);
+      }
+    }
+  }
+
+  if (instr->effect == OPT_MOVE && instr->var[0] >= 0) {
+    const char* source = instr->args[1];
+    if (instr->var[1] >= 0 && copies[instr->var[1]]) {
+      source = copies[instr->var[1]];
+    }
+    if (!strcmp(source, instr->args[0])) {
+      // variable keeps its value
+      instr->removed = rewrite;
+      return;
+    }
+    optimizer_copy_kill(copies, vars, instr);
+    if (optimizer_is_const(source) || !strncmp(source, "LF@", 3)) {
+      copies[instr->var[0]] = source;
+    }
+  } else if (optimizer_defines(instr) || instr->effect == OPT_DEST) {
+    optimizer_copy_kill(copies, vars, instr);
+  }
+}
+
+bool optimizer_copy_merge(const char** into, bool* seen, const char** copies,
+                          int vars) {
+  if (!*seen) {
+    *seen = true;
+    memcpy(into, copies, sizeof(char*) * vars);
+    return true;
+  }
+
+  bool changed = false;
+  for (int v = 0; v < vars; v++) {
+    if (into[v] && (!copies[v] || strcmp(into[v], copies[v]))) {
+      into[v] = NULL;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+void optimizer_copies(optimizer_func_t* func) {
+  int vars = func->vars.count;
+  int count = func->block_count;
+  if (!count || !vars || (long)count * (vars + 1) > OPTIMIZER_MAX_STATE_WORDS ||
+      optimizer_calls_inside(func)) {
+    return;
+  }
+
+  // stored value pushed right before: PUSHS symb, POPS var
+  char* move = arena_strdup(&func->arena, "MOVE");
+  if (!move) {
+    return;
+  }
+  for (int b = 0; b < count; b++) {
+    const optimizer_block_t* block = &func->blocks[b];
+    if (!block->reachable) {
+      continue;
+    }
+    for (int i = block->first; i <= block->last; i++) {
+      optimizer_instr_t* push = &func->instrs[i];
+      int next = optimizer_next(func, i, block->last);
+      if (!push->op || push->removed || push->effect != OPT_PUSH || next < 0) {
+        continue;
+      }
+      optimizer_instr_t* pop = &func->instrs[next];
+      if (pop->effect == OPT_POP && pop->var[0] >= 0) {
+        pop->op = move;
+        pop->effect = OPT_MOVE;
+        pop->argc = 2;
+        pop->args[1] = push->args[0];
+        pop->var[1] = push->var[0];
+        push->removed = true;
+      }
+    }
+  }
+
+  const char** in = calloc((size_t)count * vars, sizeof(char*));
+  const char** copies = malloc(sizeof(char*) * vars);
+  bool* seen = calloc(count, sizeof(bool));
+  bool* queued = calloc(count, sizeof(bool));
+  int* queue = malloc(sizeof(int) * count);
+  if (!in || !copies || !seen || !queued || !queue) {
+    error_set(EXITSTATUS_INTERNAL_ERROR);
+    goto FREE;
+  }
+
+  // entry: no copies
+  memset(copies, 0, sizeof(char*) * vars);
+  optimizer_copy_merge(in, &seen[0], copies, vars);
+  int head = 0, tail = 0;
+  queue[tail++] = 0;
+  queued[0] = true;
+
+  // forward must analysis, circular queue of blocks with changed input
+  while (head != tail) {
+    int b = queue[head];
+    head = (head + 1) % count;
+    queued[b] = false;
+
+    const optimizer_block_t* block = &func->blocks[b];
+    memcpy(copies, &in[(size_t)b * vars], sizeof(char*) * vars);
+    for (int i = block->first; i <= block->last; i++) {
+      optimizer_copy_transfer(func, copies, &func->instrs[i], false);
+    }
+
+    int succ[2];
+    int succ_count = optimizer_successors(func, b, succ);
+    for (int k = 0; k < succ_count; k++) {
+      if (optimizer_copy_merge(&in[(size_t)succ[k] * vars], &seen[succ[k]],
+                               copies, vars) &&
+          !queued[succ[k]]) {
+        queued[succ[k]] = true;
+        queue[tail] = succ[k];
+        tail = (tail + 1) % count;
+      }
+    }
+  }
+
+  // use sources of copies, stores left unused are removed later
+  for (int b = 0; b < count; b++) {
+    if (!seen[b]) {
+      continue;
+    }
+    const optimizer_block_t* block = &func->blocks[b];
+    memcpy(copies, &in[(size_t)b * vars], sizeof(char*) * vars);
+    for (int i = block->first; i <= block->last; i++) {
+      optimizer_copy_transfer(func, copies, &func->instrs[i], true);
+    }
+  }
+
+FREE:
+  free(in);
+  free(copies);
+  free(seen);
+  free(queued);
+  free(queue);
+}
+
+// DEAD STORES
+
+void optimizer_live_out(const optimizer_func_t* func, int b,
+                        const uint64_t* in, uint64_t* live, int words) {
+  int succ[2];
+  int succ_count = optimizer_successors(func, b, succ);
+  memset(live, 0, sizeof(uint64_t) * words);
+  for (int k = 0; k < succ_count; k++) {
+    for (int w = 0; w < words; w++) {
+      live[w] |= in[(size_t)succ[k] * words + w];
+    }
+  }
+}
+
+void optimizer_dead_stores(optimizer_func_t* func) {
+  int vars = func->vars.count;
+  int count = func->block_count;
+  int words = (vars + 63) / 64;
+  if (!count || !vars || (long)count * words > OPTIMIZER_MAX_STATE_WORDS ||
+      optimizer_calls_inside(func)) {
+    return;
+  }
+
+  uint64_t* in = malloc(sizeof(uint64_t) * count * words);
+  uint64_t* live = malloc(sizeof(uint64_t) * words);
+  if (!in || !live) {
+    error_set(EXITSTATUS_INTERNAL_ERROR);
+    goto FREE;
+  }
+
+  // removed stores can make the stores of their sources dead too
+  bool removed = true;
+  while (removed) {
+    removed = false;
+
+    // backward may analysis, blocks in reverse order until nothing changes
+    memset(in, 0, sizeof(uint64_t) * count * words);
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (int b = count - 1; b >= 0; b--) {
+        optimizer_live_out(func, b, in, live, words);
+        for (int i = func->blocks[b].last; i >= func->blocks[b].first; i--) {
+          optimizer_live_transfer(live, &func->instrs[i], NULL);
+        }
+        uint64_t* block_in = &in[(size_t)b * words];
+        if (memcmp(block_in, live, sizeof(uint64_t) * words)) {
+          memcpy(block_in, live, sizeof(uint64_t) * words);
+          changed = true;
+        }
+      }
+    }
+
+    for (int b = 0; b < count; b++) {
+      const optimizer_block_t* block = &func->blocks[b];
+      if (!block->reachable) {
+        continue;
+      }
+      optimizer_live_out(func, b, in, live, words);
+      for (int i = block->last; i >= block->first; i--) {
+        optimizer_instr_t* instr = &func->instrs[i];
+        if (!instr->op || instr->removed) {
+          continue;
+        }
+        int dest = instr->var[0];
+        int source = instr->var[1];
+        if (instr->effect == OPT_MOVE && dest >= 0 &&
+            !(live[dest / 64] >> (dest % 64) & 1)) {
+          // other stores can fail at run time and are kept
+          instr->removed = removed = true;
+          continue;
+        }
+
+        // value stored right before is moved: op tmp ..., MOVE var tmp
+        if (instr->effect == OPT_MOVE && dest >= 0 && source >= 0 &&
+            source != dest && !(live[source / 64] >> (source % 64) & 1)) {
+          int prev = i - 1;
+          while (prev >= block->first &&
+                 (!func->instrs[prev].op || func->instrs[prev].removed)) {
+            prev--;
+          }
+          optimizer_instr_t* def = prev >= block->first ? &func->instrs[prev]
+                                                         : NULL;
+          if (def && optimizer_defines(def) && def->var[0] == source &&
+              strcmp(def->op, "DEFVAR")) {
+            def->args[0] = instr->args[0];
+            def->var[0] = dest;
+            instr->removed = removed = true;
+            continue;
+          }
+        }
+        optimizer_live_transfer(live, instr, NULL);
+      }
+    }
+  }
+
+FREE:
+  free(in);
+  free(live);
+}
+
+// TEMPORARIES
+
+bool optimizer_is_temp(const char* arg) { return !strncmp(arg, "LF@$", 4); }
+
+bool optimizer_temp_operands(const optimizer_instr_t* instr, const int* temp,
+                             int* operands) {
+  for (int j = 0; j < 3; j++) {
+    int var = j < instr->argc ? instr->var[j] : -1;
+    operands[j] = var >= 0 && temp ? temp[var] : var;
+  }
+  return optimizer_defines(instr);
+}
+
+void optimizer_live_transfer(uint64_t* live, const optimizer_instr_t* instr,
+                             const int* temp) {
+  if (!instr->op || instr->removed) {
+    return;
+  }
+  int operands[3];
+  bool dest = optimizer_temp_operands(instr, temp, operands);
+  if (dest && operands[0] >= 0) {
+    live[operands[0] / 64] &= ~((uint64_t)1 << (operands[0] % 64));
+  }
+  for (int j = dest; j < 3; j++) {
+    if (operands[j] >= 0) {
+      live[operands[j] / 64] |= (uint64_t)1 << (operands[j] % 64);
+    }
+  }
+}
+
+int optimizer_temps(optimizer_func_t* func) {
+  int* temp = malloc(sizeof(int) * (func->vars.count + 1));
+  if (!temp) {
+    error_set(EXITSTATUS_INTERNAL_ERROR);
+    return -1;
+  }
+  for (int v = 0; v < func->vars.count; v++) {
+    temp[v] = -1;
+  }
+
+  if (optimizer_calls_inside(func)) {
+    free(temp);
+    return -1;
+  }
+
+  // temporaries in order of first appearance
+  int temps = 0;
+  for (int i = 0; i < func->count; i++) {
+    optimizer_instr_t* instr = &func->instrs[i];
+    for (int j = 0; j < instr->argc; j++) {
+      if (instr->var[j] >= 0 && temp[instr->var[j]] < 0 &&
+          optimizer_is_temp(instr->args[j])) {
+        temp[instr->var[j]] = temps++;
+      }
+    }
+  }
+  if (!temps) {
+    free(temp);
+    return 0;
+  }
+
+  int words = (temps + 63) / 64;
+  int count = func->block_count;
+  uint64_t* in = calloc((size_t)count * words, sizeof(uint64_t));
+  uint64_t* adj = calloc((size_t)temps * words, sizeof(uint64_t));
+  uint64_t* live = malloc(sizeof(uint64_t) * words);
+  int* color = malloc(sizeof(int) * temps);
+  char** names = arena_alloc(&func->arena, sizeof(char*) * temps);
+  if (!in || !adj || !live || !color || !names) {
+    error_set(EXITSTATUS_INTERNAL_ERROR);
+    temps = -1;
+    goto FREE;
+  }
+
+  // backward may analysis, blocks in reverse order until nothing changes
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int b = count - 1; b >= 0; b--) {
+      int succ[2];
+      int succ_count = optimizer_successors(func, b, succ);
+      memset(live, 0, sizeof(uint64_t) * words);
+      for (int k = 0; k < succ_count; k++) {
+        for (int w = 0; w < words; w++) {
+          live[w] |= in[(size_t)succ[k] * words + w];
+        }
+      }
+      for (int i = func->blocks[b].last; i >= func->blocks[b].first; i--) {
+        optimizer_live_transfer(live, &func->instrs[i], temp);
+      }
+      uint64_t* block_in = &in[(size_t)b * words];
+      if (memcmp(block_in, live, sizeof(uint64_t) * words)) {
+        memcpy(block_in, live, sizeof(uint64_t) * words);
+        changed = true;
+      }
+    }
+  }
+
+  // temporaries live at the same point, or defined while the other lives
+  for (int b = 0; b < count; b++) {
+    int succ[2];
+    int succ_count = optimizer_successors(func, b, succ);
+    memset(live, 0, sizeof(uint64_t) * words);
+    for (int k = 0; k < succ_count; k++) {
+      for (int w = 0; w < words; w++) {
+        live[w] |= in[(size_t)succ[k] * words + w];
+      }
+    }
+    for (int i = func->blocks[b].last; i >= func->blocks[b].first; i--) {
+      optimizer_instr_t* instr = &func->instrs[i];
+      if (!instr->op || instr->removed) {
+        continue;
+      }
+      int operands[3];
+      if (optimizer_temp_operands(instr, temp, operands) && operands[0] >= 0) {
+        for (int w = 0; w < words; w++) {
+          adj[(size_t)operands[0] * words + w] |= live[w];
+        }
+      }
+      optimizer_live_transfer(live, instr, temp);
+      for (int t = 0; t < temps; t++) {
+        if (live[t / 64] >> (t % 64) & 1) {
+          for (int w = 0; w < words; w++) {
+            adj[(size_t)t * words + w] |= live[w];
+          }
+        }
+      }
+    }
+  }
+
+  // least color not taken by neighbors colored before, edges are made
+  // symmetric as they are checked
+  int colors = 0;
+  for (int t = 0; t < temps; t++) {
+    color[t] = 0;
+    bool taken = true;
+    while (taken) {
+      taken = false;
+      for (int u = 0; u < t && !taken; u++) {
+        bool edge = (adj[(size_t)t * words + u / 64] >> (u % 64) & 1) ||
+                    (adj[(size_t)u * words + t / 64] >> (t % 64) & 1);
+        taken = edge && color[u] == color[t];
+      }
+      color[t] += taken;
+    }
+    if (color[t] >= colors) {
+      names[colors] = arena_alloc(&func->arena, 32);
+      if (!names[colors]) {
+        temps = -1;
+        goto FREE;
+      }
+      sprintf(names[colors], "LF@$tmp%d", colors + 1);
+      colors++;
+    }
+  }
+
+  for (int i = 0; i < func->count; i++) {
+    optimizer_instr_t* instr = &func->instrs[i];
+    for (int j = 0; j < instr->argc; j++) {
+      int t = instr->var[j] >= 0 ? temp[instr->var[j]] : -1;
+      if (t >= 0) {
+        instr->args[j] = names[color[t]];
+      }
+    }
+    if (instr->effect == OPT_UNDEF && !strcmp(instr->op, "DEFVAR") &&
+        instr->var[0] >= 0 && temp[instr->var[0]] >= 0) {
+      instr->removed = true;
+    }
+  }
+  temps = colors;
+
+FREE:
+  free(temp);
+  free(in);
+  free(adj);
+  free(live);
+  free(color);
+  return temps;
+}
+
+int optimizer_function(dynstr_t* code) {
+  optimizer_func_t func;
+  int temps = -1;
+  if (optimizer_parse(&func, code->str)) {
+    optimizer_copies(&func);
+    optimizer_nullability(&func);
+    optimizer_remove_dead(&func);
+    optimizer_dead_stores(&func);
+    temps = optimizer_temps(&func);
+    if (!error_get()) {
+      dynstr_clear(code);
+      optimizer_print(&func, code);
+    }
+  }
+  optimizer_free(&func);
+  return error_get() ? -1 : temps;
+}
@@ -0,0 +1,246 @@
+/**
+ * @file
+ * @brief Optimizer of generated code API
+ * @author Tomas Martykan (xmarty07)
+ * @author Filip Stolfa (xstolf00)
+ * @author Patrik Korytar (xkoryt04)
+ *
+ * FIT VUT IFJ Project:
+ * Compiler of IFJ21 Language
+ *
+ * @section DESCRIPTION
+ *  Rewrites generated IFJcode21 of a function body before it is
+ *  appended to the output.
+ *
+ * @section IMPLEMENTATION
+ *  Code is split into instructions and basic blocks. Nullability
+ *  analysis is a forward must analysis over the control flow graph,
+ *  it finds LF variables and values on the top of data stack which
+ *  cannot be nil. Nil checks of such values are removed, blocks only
+ *  reachable through removed branches are removed as well.
+ *  Code which is not reachable from the function entry (builtin
+ *  helpers entered by CALL) is never changed.
+ *  Copies (MOVE, or PUSHS right before POPS) are propagated first by
+ *  a forward must analysis, uses of copied variables read their
+ *  sources. Stores left unused are then found by liveness analysis
+ *  of all LF variables, only MOVE instructions are removed as other
+ *  stores can fail at run time.
+ *  Temporaries (LF variables whose names start with $) are allocated
+ *  last. Liveness analysis is a backward may analysis over the same
+ *  graph, temporaries live at the same time interfere and the others
+ *  share variables $tmp1 to $tmpN, colored greedily in order of first
+ *  appearance.
+ */
+
+#ifndef __OPTIMIZER_H__
+#define __OPTIMIZER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "dynstr.h"
+
+// COMPILE-TIME CONSTANTS
+
+/**
+ * Maximal size of analysis state of all blocks in 64-bit words.
+ * Larger functions are left unoptimized, the state grows with product
+ * of blocks and variables and each pass over it must stay cheap.
+ */
+#define OPTIMIZER_MAX_STATE_WORDS (1 << 18)
+
+// DATA STRUCTURES
+
+/**
+ * @brief Effect of instruction on LF variables and data stack.
+ */
+typedef enum {
+  OPT_OTHER,         ///< Unknown effect
+  OPT_NONE,          ///< No effect, eg. WRITE, LABEL, jumps
+  OPT_PUSH,          ///< PUSHS symb
+  OPT_POP,           ///< POPS var
+  OPT_MOVE,          ///< MOVE var symb
+  OPT_UNDEF,         ///< Any value is stored to var, eg. READ
+  OPT_DEST,          ///< Result of operation is stored to var, eg. ADD
+  OPT_STACK_UNARY,   ///< Operation on the top of data stack, eg. NOTS
+  OPT_STACK_BINARY,  ///< Operation on two values on data stack, eg. ADDS
+  OPT_STACK_BRANCH,  ///< Branch popping two values, eg. JUMPIFEQS
+  OPT_CALL,          ///< CALL label
+  OPT_CLEARS,        ///< CLEARS
+} optimizer_effect_t;
+
+/**
+ * @struct optimizer_instr_t
+ * @brief Instruction of generated code.
+ * @var optimizer_instr_t::op
+ *  Opcode, NULL for comments and empty lines.
+ * @var optimizer_instr_t::args
+ *  Operands, whole line for comments and empty lines.
+ * @var optimizer_instr_t::argc
+ *  Number of operands.
+ * @var optimizer_instr_t::var
+ *  Indices of LF variable operands, -1 for other operands.
+ * @var optimizer_instr_t::effect
+ *  Effect of the instruction.
+ * @var optimizer_instr_t::removed
+ *  Is instruction left out of the output?
+ */
+typedef struct {
+  char* op;
+  char* args[3];
+  int argc;
+  int var[3];
+  optimizer_effect_t effect;
+  bool removed;
+} optimizer_instr_t;
+
+/**
+ * @struct optimizer_block_t
+ * @brief Basic block of instructions.
+ * @var optimizer_block_t::first
+ *  Index of the first instruction.
+ * @var optimizer_block_t::last
+ *  Index of the last instruction.
+ * @var optimizer_block_t::target
+ *  Block jumped to by the last instruction, -1 if none.
+ * @var optimizer_block_t::falls
+ *  Does execution continue with the next block?
+ * @var optimizer_block_t::reachable
+ *  Is block reachable from the function entry?
+ */
+typedef struct {
+  int first;
+  int last;
+  int target;
+  bool falls;
+  bool reachable;
+} optimizer_block_t;
+
+/**
+ * @struct optimizer_table_t
+ * @brief Hash table of names (labels, variables) to indices.
+ * @var optimizer_table_t::keys
+ *  Names, NULL for empty slots.
+ * @var optimizer_table_t::values
+ *  Indices of the names.
+ * @var optimizer_table_t::size
+ *  Number of slots, power of two.
+ * @var optimizer_table_t::count
+ *  Number of names in the table.
+ */
+typedef struct {
+  const char** keys;
+  int* values;
+  int size;
+  int count;
+} optimizer_table_t;
+
+/**
+ * @struct optimizer_func_t
+ * @brief Function body being optimized.
+ * @var optimizer_func_t::arena
+ *  Arena for all data of the function.
+ * @var optimizer_func_t::instrs
+ *  Instructions in order.
+ * @var optimizer_func_t::count
+ *  Number of instructions.
+ * @var optimizer_func_t::blocks
+ *  Basic blocks in order.
+ * @var optimizer_func_t::block_count
+ *  Number of basic blocks.
+ * @var optimizer_func_t::labels
+ *  Labels to indices of blocks.
+ * @var optimizer_func_t::vars
+ *  Names of LF variables to their indices.
+ */
+typedef struct {
+  arena_t arena;
+  optimizer_instr_t* instrs;
+  int count;
+  optimizer_block_t* blocks;
+  int block_count;
+  optimizer_table_t labels;
+  optimizer_table_t vars;
+} optimizer_func_t;
+
+// PUBLIC FUNCTION FORWARD DECLARATIONS
+
+/**
+ * Splits code into instructions and basic blocks.
+ * Sets global error flag on allocation failure.
+ * Function has to be freed even if parsing fails.
+ * @param func Function to initialize.
+ * @param code Code of the function body.
+ * @return True if successful. False if failed or code is not supported
+ *  (unknown line format, jump out of the function).
+ */
+bool optimizer_parse(optimizer_func_t* func, const char* code);
+
+/**
+ * Appends instructions which were not removed to string.
+ * @param func Function to print.
+ * @param out String to append to.
+ */
+void optimizer_print(const optimizer_func_t* func, dynstr_t* out);
+
+/**
+ * Removes nil checks of values which cannot be nil.
+ * @param func Function to optimize.
+ */
+void optimizer_nullability(optimizer_func_t* func);
+
+/**
+ * Removes blocks which are no longer reachable from the function entry,
+ * jumps to the next instruction and labels nothing jumps to.
+ * @param func Function to optimize.
+ */
+void optimizer_remove_dead(optimizer_func_t* func);
+
+/**
+ * Replaces PUSHS right before POPS with MOVE, uses of variables holding
+ * a copy of another variable or literal are replaced with the source.
+ * Moves of variables to themselves are removed.
+ * Sets global error flag on allocation failure.
+ * @param func Function to optimize.
+ */
+void optimizer_copies(optimizer_func_t* func);
+
+/**
+ * Removes moves to variables which are not read before they are assigned
+ * again or the function returns. Result of instruction moved right after
+ * from a variable which is not read later is stored to the destination of
+ * the move directly.
+ * Sets global error flag on allocation failure.
+ * @param func Function to optimize.
+ */
+void optimizer_dead_stores(optimizer_func_t* func);
+
+/**
+ * Renames temporaries to the least variables $tmp1 to $tmpN found,
+ * temporaries which are never live at the same time share a variable.
+ * Their DEFVAR instructions are removed, the caller defines the
+ * variables before the code.
+ * Sets global error flag on allocation failure.
+ * @param func Function to optimize.
+ * @return Number of variables N. -1 if temporaries were not renamed
+ *  (code entered by CALL shares the frame, allocation failed).
+ */
+int optimizer_temps(optimizer_func_t* func);
+
+/**
+ * Frees all data of the function.
+ * @param func Function to free.
+ */
+void optimizer_free(optimizer_func_t* func);
+
+/**
+ * Optimizes code of a function body in place, temporaries included.
+ * Code is left unchanged if optimizer fails.
+ * @param code Code of the function body.
+ * @return Number of variables $tmp1 to $tmpN the code uses for
+ *  temporaries. -1 if they were not renamed and keep their names.
+ */
+int optimizer_function(dynstr_t* code);
+
+#endif  // __OPTIMIZER_H__
@@ -15,6 +15,12 @@
 #ifndef __OTHER_H__
 #define __OTHER_H__
 
+/**
+ * Storage class of global state private to each thread,
+ * code of functions is generated by several threads at once.
+ */
+#define THREAD_LOCAL __thread
+
 char* str_create_copy(char* str);
 
 #endif  // __OTHER_H__
@@ -16,6 +16,7 @@
 #include "scanner.h"
 #include "dynstr.h"
 #include "errors.h"
+#include "hash.h"
 
 /// Number of keywords in keywords array
 #define KEYWORDS_COUNT 15
@@ -38,6 +39,12 @@
 /// Global dynamic string for storing incomplete tokens
 dynstr_t str_buffer;
 
+/// Offset of the next character to be read from input
+size_t scanner_pos = 0;
+
+/// Offset of the first character of the token being scanned
+size_t scanner_token_begin = 0;
+
 
 /**
  * @brief All keywords of the ifj21 language.
@@ -89,6 +96,7 @@ typedef enum {
 
 
 void scanner_init() {
+  scanner_pos = 0;
   dynstr_t *res = dynstr_init(&str_buffer);
   if (res == NULL) {
     error_set(EXITSTATUS_INTERNAL_ERROR);
@@ -142,6 +150,9 @@ token_t* scanner_create_empty_token() {
   }
   new_token->attr.str = NULL;
   new_token->type = TT_NO_TYPE;
+  new_token->hash = 0;
+  new_token->begin = 0;
+  new_token->end = 0;
 
   return new_token;
 }
@@ -160,6 +171,7 @@ token_t *scanner_make_eof_token(token_t *tok) {
  * Changes the type of the token to TT_KEYWORD_ID and copies
  * the parsed token string to attr.str. The attribute char pointer can be NULL,
  * if the copy failed - then the error flag is also set.
+ * Identifier is hashed here, while its characters are still in cache.
  * @param tok Pointer to the token to change.
  * @return Pointer to the changed token.
  */
@@ -170,6 +182,7 @@ token_t *scanner_make_id_kw_token(token_t *tok) {
   }
   else {
     tok->type = tok_type;
+    tok->hash = hash_key(str_buffer.str, str_buffer.len);
     tok->attr.str = dynstr_copy_to_static(&str_buffer);
     if (tok->attr.str == NULL) {
       scanner_token_destroy(tok);
@@ -295,7 +308,31 @@ char get_escaped_cahr(int c) {
 }
 
 
-token_t *scanner_get_next_token() {
+/** Read next character from input, keeping track of position.
+ * @return Read character or EOF.
+ */
+int scanner_getc() {
+  int c = getchar();
+  if (c != EOF) {
+    scanner_pos++;
+  }
+  return c;
+}
+
+/** Return character back to input, keeping track of position.
+ * @param c Character to return.
+ */
+void scanner_ungetc(int c) {
+  if (c != EOF) {
+    scanner_pos--;
+  }
+  ungetc(c, stdin);
+}
+
+/** Scan next token from input.
+ * @return Pointer to the token. NULL if failed.
+ */
+token_t *scanner_scan_token() {
   if (dynstr_clear(&str_buffer) == NULL) {
     error_set(EXITSTATUS_INTERNAL_ERROR);
     return NULL;
@@ -311,14 +348,17 @@ token_t *scanner_get_next_token() {
   int curr_char; // int so we can check for EOF
 
   for (;;) {
-    curr_char = getchar();
+    curr_char = scanner_getc();
 
     switch (state) {
       case STATE_START:
+        // token starts at the first character not skipped here
+        scanner_token_begin = curr_char == EOF ? scanner_pos : scanner_pos - 1;
 
         if (isspace(curr_char)) {
           continue;
         }
+
         /* TODO(filip): what about different locales? */
         else if (isalpha(curr_char) || curr_char == '_') {
           APPEND_CHAR(curr_char, new_token);
@@ -371,7 +411,7 @@ token_t *scanner_get_next_token() {
           APPEND_CHAR(curr_char, new_token);
         }
         else {
-          ungetc(curr_char, stdin);
+          scanner_ungetc(curr_char);
           return scanner_make_id_kw_token(new_token);
         }
         break;
@@ -390,7 +430,7 @@ token_t *scanner_get_next_token() {
           state = STATE_NUMBER_EXP_START;
         }
         else {
-          ungetc(curr_char, stdin);
+          scanner_ungetc(curr_char);
           return scanner_make_int_token(new_token);
         }
         break;
@@ -445,7 +485,7 @@ token_t *scanner_get_next_token() {
           state = STATE_NUMBER_EXP_START;
         }
         else {
-          ungetc(curr_char, stdin);
+          scanner_ungetc(curr_char);
           return scanner_make_number_token(new_token);
         }
         break;
@@ -454,7 +494,7 @@ token_t *scanner_get_next_token() {
           APPEND_CHAR(curr_char, new_token);
         }
         else {
-          ungetc(curr_char, stdin);
+          scanner_ungetc(curr_char);
           return scanner_make_number_token(new_token);
         }
         break;
@@ -465,7 +505,7 @@ token_t *scanner_get_next_token() {
           return scanner_make_op_token(new_token, TT_COP_EQ);
         }
         else {
-          ungetc(curr_char, stdin);
+          scanner_ungetc(curr_char);
           return scanner_make_op_token(new_token, TT_ASSIGN);
         }
         break;
@@ -474,7 +514,7 @@ token_t *scanner_get_next_token() {
           return scanner_make_op_token(new_token, TT_COP_GE);
         }
         else {
-          ungetc(curr_char, stdin);
+          scanner_ungetc(curr_char);
           return scanner_make_op_token(new_token, TT_COP_GT);
         }
         break;
@@ -483,7 +523,7 @@ token_t *scanner_get_next_token() {
           return scanner_make_op_token(new_token, TT_COP_LE);
         }
         else {
-          ungetc(curr_char, stdin);
+          scanner_ungetc(curr_char);
           return scanner_make_op_token(new_token, TT_COP_LT);
         }
         break;
@@ -492,7 +532,7 @@ token_t *scanner_get_next_token() {
           return scanner_make_op_token(new_token, TT_COP_NEQ);
         }
         else {
-          ungetc(curr_char, stdin);
+          scanner_ungetc(curr_char);
           scanner_token_destroy(new_token);
           error_set(EXITSTATUS_ERROR_LEXICAL);
           return NULL;
@@ -503,7 +543,7 @@ token_t *scanner_get_next_token() {
           return scanner_make_op_token(new_token, TT_MOP_INT_DIV);
         }
         else {
-          ungetc(curr_char, stdin);
+          scanner_ungetc(curr_char);
           return scanner_make_op_token(new_token, TT_MOP_DIV);
         }
         break;
@@ -512,7 +552,7 @@ token_t *scanner_get_next_token() {
           state = STATE_COMMENT_START;
         }
         else {
-          ungetc(curr_char, stdin);
+          scanner_ungetc(curr_char);
           return scanner_make_op_token(new_token, TT_MOP_MINUS);
         }
         break;
@@ -521,7 +561,7 @@ token_t *scanner_get_next_token() {
           return scanner_make_op_token(new_token, TT_SOP_CONCAT);
         }
         else {
-          ungetc(curr_char, stdin);
+          scanner_ungetc(curr_char);
           scanner_token_destroy(new_token);
           error_set(EXITSTATUS_ERROR_LEXICAL);
           return NULL;
@@ -730,3 +770,12 @@ token_t *scanner_get_next_token() {
     }
   }
 }
+
+token_t *scanner_get_next_token() {
+  token_t *tok = scanner_scan_token();
+  if (tok != NULL) {
+    tok->begin = scanner_token_begin;
+    tok->end = scanner_pos;
+  }
+  return tok;
+}
@@ -12,6 +12,9 @@
 #ifndef __SCANNER_H
 #define __SCANNER_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 /// Offset from 0 of the first keyword token type
 #define TOK_KEYWORD_OFFSET 3
 
@@ -93,10 +96,20 @@ typedef union {
  * Union of a string, integer and double. Depending on the token type,
  * the corresponding value is stored in the attribute.
  * If a token doesn't require an attribute, it is set to a NULL char pointer.
+ * @var token_t::hash
+ * Hash of the identifier name for #TT_ID, computed by hash_key().
+ * Lets symbol table look up the identifier without hashing it again.
+ * @var token_t::begin
+ * Offset of the first character of the token in the input.
+ * @var token_t::end
+ * Offset just past the last character of the token in the input.
  */
 typedef struct {
   token_type_t type;
   attr_t attr;
+  uint32_t hash;
+  size_t begin;
+  size_t end;
 } token_t;
 
 
@@ -15,7 +15,7 @@
 #include "scope.h"
 #include "errors.h"
 
-scope_info_t *scope_info;
+THREAD_LOCAL scope_info_t *scope_info;
 
 void scope_init() {
   scope_info = malloc(sizeof(scope_info_t));
@@ -26,21 +26,48 @@ void scope_init() {
     return;
   }
 
+  scope_info->stack = malloc(sizeof(scope_item_t) * SCOPE_STACK_INIT_SIZE);
+  if (scope_info->stack == NULL) {
+    free(scope_info);
+    scope_info = NULL;
+    if (!error_get()) {
+      error_set(EXITSTATUS_INTERNAL_ERROR);
+    }
+    return;
+  }
+
   scope_info->if_cnt = 0;
   scope_info->while_cnt = 0;
+  scope_info->inline_cnt = 0;
   scope_info->top = -1;
+  scope_info->size = SCOPE_STACK_INIT_SIZE;
 }
 
 void scope_destroy() {
+  if (scope_info != NULL) {
+    free(scope_info->stack);
+  }
   free(scope_info);
 }
 
 void scope_push_item(char type, unsigned int lvl) {
-  scope_info->top++;
-  if (scope_info->top < SCOPE_STACK_SIZE) {
-    scope_info->stack[scope_info->top].lvl = lvl;
-    scope_info->stack[scope_info->top].type = type;
+  if (scope_info->top + 1 >= scope_info->size) {
+    int new_size = scope_info->size * 2;
+    scope_item_t *tmp =
+        realloc(scope_info->stack, sizeof(scope_item_t) * new_size);
+    if (tmp == NULL) {
+      if (!error_get()) {
+        error_set(EXITSTATUS_INTERNAL_ERROR);
+      }
+      return;
+    }
+    scope_info->stack = tmp;
+    scope_info->size = new_size;
   }
+
+  scope_info->top++;
+  scope_info->stack[scope_info->top].lvl = lvl;
+  scope_info->stack[scope_info->top].type = type;
 }
 
 scope_item_t scope_get_item(int offset) {
@@ -61,6 +88,11 @@ void scope_new_while() {
   scope_push_item('w', scope_info->while_cnt);
 }
 
+void scope_new_inline() {
+  scope_info->inline_cnt++;
+  scope_push_item('i', scope_info->inline_cnt);
+}
+
 void scope_pop_item() {
   if (scope_info->top >= 0) {
     scope_info->top--;
@@ -72,7 +104,7 @@ int scope_len() {
 }
 
 char* scope_get_correct_id(char *id, int lvl) {
-  static char new_id[100] = {'\0'};
+  static THREAD_LOCAL char new_id[100] = {'\0'};
   if (!scope_empty() && scope_len() - lvl > 0) {
     scope_item_t si = scope_get_item(lvl);
     sprintf(new_id, "%s$%c%d", id, si.type, si.lvl);
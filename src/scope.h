@@ -14,10 +14,12 @@
 
 #include <stdbool.h>
 
-#define SCOPE_STACK_SIZE 100
+#include "other.h"
+
+#define SCOPE_STACK_INIT_SIZE 16 ///< Initial capacity of scope stack
 
 typedef struct {
-  char type; ///< Either 'f' - for if; or 'w' - for while
+  char type; ///< 'f' - for if; 'w' - for while; 'i' - for inlined function
   unsigned int lvl; ///< Current level
 } scope_item_t;
 
@@ -25,11 +27,13 @@ typedef struct {
 typedef struct {
   unsigned int if_cnt;
   unsigned int while_cnt;
+  unsigned int inline_cnt;
   int top;
-  scope_item_t stack[SCOPE_STACK_SIZE];
+  int size; ///< Allocated capacity of the stack
+  scope_item_t *stack;
 } scope_info_t;
 
-extern scope_info_t *scope_info;
+extern THREAD_LOCAL scope_info_t *scope_info;
 
 
 /** Intialize scope stack and counters.
@@ -43,6 +47,7 @@ void scope_init();
 void scope_destroy();
 
 /** Push new item onto the scope stack.
+ * Stack grows as needed. On error sets the global error flag.
  * @param type Type of scope for which to push item
  */
 void scope_push_item(char type, unsigned int lvl);
@@ -67,6 +72,11 @@ void scope_new_if();
  */
 void scope_new_while();
 
+/** Create a new scope of inlined function body.
+ * Increments inline counter and pushes a new item onto the stack.
+ */
+void scope_new_inline();
+
 /** Remove a scope item from the top of the stack.
  */
 void scope_pop_item();
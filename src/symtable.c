@@ -18,6 +18,7 @@
 #include <string.h>
 
 #include "errors.h"
+#include "hash.h"
 
 // COMPILE-TIME CONSTANTS
 
@@ -37,9 +38,10 @@ symtab_subtab_t* symtab_subtab_create(size_t n);
 /**
  * Creates record of identifier.
  * @param key Name of the identifier.
+ * @param hash Hash of the key.
  * @return Created record. NULL if failed to create.
  */
-symtab_record_t* symtab_record_create(symtab_key_t key);
+symtab_record_t* symtab_record_create(symtab_key_t key, uint32_t hash);
 
 /**
  * Inserts bultin function into the symtable.
@@ -47,9 +49,10 @@ symtab_record_t* symtab_record_create(symtab_key_t key);
  * @param name Name of the builtin function.
  * @param param_types Data types of parameters of the builtin function.
  * @param return_types Data types of return values of the builtin function.
+ * @param builtin Identifier of the builtin function.
  */
 void symtab_init_builtin(symtab_t* symtab, char* name, char* param_types,
-                         char* return_types);
+                         char* return_types, symtab_builtin_t builtin);
 
 // DEALLOCATION FUNCTIONS
 
@@ -71,45 +74,49 @@ void symtab_subtab_clear(symtab_subtab_t* subtab);
  */
 void symtab_record_free(symtab_record_t* rec);
 
+/**
+ * Empties lookup cache of symbol table.
+ * @param symtab Symbol table to empty cache of.
+ */
+void symtab_cache_clear(symtab_t* symtab);
+
 // MANIPULATION WITH RECORDS
 
 /**
  * Searches subtable for identifier.
  * @param subtab Subtable to search on.
  * @param key Key to search for.
+ * @param hash Hash of the key.
+ * @param stats If not NULL, statistics to record the search into.
  * @return Found record data. NULL otherwise.
  */
 symtab_data_t* symtab_subtab_find(const symtab_subtab_t* subtab,
-                                  symtab_key_t key);
+                                  symtab_key_t key, uint32_t hash,
+                                  symtab_stats_t* stats);
+
+/**
+ * Same as symtab_subtab_find(), returns whole record.
+ * @param subtab Subtable to search on.
+ * @param key Key to search for.
+ * @param hash Hash of the key.
+ * @param stats If not NULL, statistics to record the search into.
+ * @return Found record. NULL otherwise.
+ */
+symtab_record_t* symtab_subtab_find_record(const symtab_subtab_t* subtab,
+                                           symtab_key_t key, uint32_t hash,
+                                           symtab_stats_t* stats);
 
 /**
  * Creates and inserts new record in subtable.
  * @param subtab Subtable to instert into.
  * @param key Key of the new record.
+ * @param hash Hash of the key.
  * @param type Type of inserted record.
  *  'v' - variable, 'f' - function.
  * @return Created record. NULL if failed to create.
  */
 symtab_data_t* symtab_subtab_insert(symtab_subtab_t* subtab, symtab_key_t key,
-                                    char type);
-
-// HASH FUNCTION
-
-/**
- * Hash function.
- * @param data Key to hash.
- * @return Index created from key.
- */
-uint32_t SuperFastHash(symtab_key_t data);
-//--------------------------------------------------------------------------------------
-// APPLIES TO SINGLE FUNCTION DECLARATION ABOVE
-// TAKEN FROM: http://www.azillionmonkeys.com/qed/hash.html
-// COPYRIGHT: © Copyright 2004-2008 by Paul Hsieh
-// LICENSE: GNU Lesser General Public License v2.1
-// LICENSE TEXT: https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt
-// CHANGES MADE: 01.10.2021 - changed parameter type and count; added local len
-// variable
-//--------------------------------------------------------------------------------------
+                                    uint32_t hash, char type);
 
 // FUNCTION DEFINITIONS
 
@@ -128,16 +135,18 @@ symtab_t* symtab_create() {
     return NULL;
   }
 
-  symtab_init_builtin(symtab, "write", "a+", "");
-  symtab_init_builtin(symtab, "reads", "", "s");
-  symtab_init_builtin(symtab, "readi", "", "i");
-  symtab_init_builtin(symtab, "readn", "", "n");
-  symtab_init_builtin(symtab, "tointeger", "n", "i");
-  symtab_init_builtin(symtab, "substr", "snn", "s");
-  symtab_init_builtin(symtab, "ord", "si", "i");
-  symtab_init_builtin(symtab, "chr", "i", "s");
+  symtab_init_builtin(symtab, "write", "a+", "", BUILTIN_WRITE);
+  symtab_init_builtin(symtab, "reads", "", "s", BUILTIN_READS);
+  symtab_init_builtin(symtab, "readi", "", "i", BUILTIN_READI);
+  symtab_init_builtin(symtab, "readn", "", "n", BUILTIN_READN);
+  symtab_init_builtin(symtab, "tointeger", "n", "i", BUILTIN_TOINTEGER);
+  symtab_init_builtin(symtab, "substr", "snn", "s", BUILTIN_SUBSTR);
+  symtab_init_builtin(symtab, "ord", "si", "i", BUILTIN_ORD);
+  symtab_init_builtin(symtab, "chr", "i", "s", BUILTIN_CHR);
 
   symtab->local_scopes = NULL;
+  symtab->stats = NULL;
+  symtab_cache_clear(symtab);
 
   return symtab;
 }
@@ -151,6 +160,8 @@ symtab_subtab_t* symtab_subtab_create(size_t n) {
   }
 
   subtab->next = NULL;
+  subtab->record_cnt = 0;
+  subtab->collision_cnt = 0;
   subtab->bucket_cnt = n;
   for (unsigned i = 0; i < n; i++) {
     subtab->list[i] = NULL;
@@ -159,7 +170,7 @@ symtab_subtab_t* symtab_subtab_create(size_t n) {
   return subtab;
 }
 
-symtab_record_t* symtab_record_create(symtab_key_t key) {
+symtab_record_t* symtab_record_create(symtab_key_t key, uint32_t hash) {
   symtab_record_t* rec = malloc(sizeof(symtab_record_t));
   if (!rec) {
     error_set(EXITSTATUS_INTERNAL_ERROR);
@@ -176,12 +187,13 @@ symtab_record_t* symtab_record_create(symtab_key_t key) {
 
   rec->next = NULL;
   rec->key = new_key;
+  rec->hash = hash;
 
   return rec;
 }
 
 void symtab_init_builtin(symtab_t* symtab, char* id, char* param_types,
-                         char* return_types) {
+                         char* return_types, symtab_builtin_t builtin) {
   symtab_func_data_t* func_data = symtab_insert_func(symtab, id);
   if (error_get()) {
     return;
@@ -209,12 +221,14 @@ void symtab_init_builtin(symtab_t* symtab, char* id, char* param_types,
   strncpy(func_data->return_types, return_types, strlen(return_types) + 1);
 
   func_data->was_defined = true;
+  func_data->builtin = builtin;
 }
 
 // DEALLOCATION FUNCTIONS
 
 void symtab_free(symtab_t* symtab) {
   symtab_clear(symtab);
+  free(symtab->stats);
   free(symtab);
 }
 
@@ -227,6 +241,7 @@ void symtab_clear(symtab_t* symtab) {
     symtab_subtab_free(symtab->local_scopes);
     symtab->local_scopes = next;
   }
+  symtab_cache_clear(symtab);
 }
 
 void symtab_subtab_free(symtab_subtab_t* subtab) {
@@ -271,29 +286,83 @@ bool symtab_subtab_push(symtab_t* symtab) {
 
   subtab->next = symtab->local_scopes;
   symtab->local_scopes = subtab;
+  symtab_cache_clear(symtab);
+
+  symtab_stats_t* stats = symtab->stats;
+  if (stats) {
+    stats->scopes++;
+    stats->depth++;
+    if (stats->depth > stats->peak_depth) {
+      stats->peak_depth = stats->depth;
+    }
+  }
 
   return true;
 }
 
 void symtab_subtab_pop(symtab_t* symtab) {
+  symtab_stats_t* stats = symtab->stats;
+  if (stats) {
+    symtab_subtab_t* top = symtab->local_scopes;
+    stats->depth--;
+    stats->local_records += top->record_cnt;
+    stats->local_collisions += top->collision_cnt;
+    if (top->record_cnt > stats->max_scope_records) {
+      stats->max_scope_records = top->record_cnt;
+    }
+    if (top->collision_cnt > stats->max_scope_collisions) {
+      stats->max_scope_collisions = top->collision_cnt;
+    }
+  }
+
   symtab_subtab_t* next = symtab->local_scopes->next;
   symtab_subtab_free(symtab->local_scopes);
   symtab->local_scopes = next;
+  symtab_cache_clear(symtab);
+}
+
+void symtab_cache_clear(symtab_t* symtab) {
+  for (unsigned i = 0; i < SYMTAB_CACHE_SIZE; i++) {
+    symtab->cache[i].rec = NULL;
+  }
 }
 
 // MANIPULATION WITH RECORDS
 
-symtab_var_data_t* symtab_find_var(const symtab_t* symtab, symtab_key_t key,
+uint32_t symtab_hash(symtab_key_t key) { return hash_key(key, strlen(key)); }
+
+symtab_var_data_t* symtab_find_var(symtab_t* symtab, symtab_key_t key,
                                    int* lvl) {
-  for (symtab_subtab_t* subtab = symtab->local_scopes; subtab != NULL;
-       subtab = subtab->next) {
-    symtab_data_t* data = symtab_subtab_find(subtab, key);
-    if (data) {
-      return &data->var_data;
+  return symtab_find_var_hashed(symtab, key, symtab_hash(key), lvl);
+}
+
+symtab_var_data_t* symtab_find_var_hashed(symtab_t* symtab, symtab_key_t key,
+                                          uint32_t hash, int* lvl) {
+  symtab_cache_entry_t* entry = &symtab->cache[hash & (SYMTAB_CACHE_SIZE - 1)];
+  if (entry->rec && entry->rec->hash == hash && !strcmp(entry->rec->key, key)) {
+    if (symtab->stats) {
+      symtab->stats->cache_hits++;
     }
     if (lvl != NULL) {
-      (*lvl)++;
+      (*lvl) += entry->lvl;
+    }
+    return &entry->rec->data.var_data;
+  }
+
+  int found_lvl = 0;
+  for (symtab_subtab_t* subtab = symtab->local_scopes; subtab != NULL;
+       subtab = subtab->next) {
+    symtab_record_t* rec =
+        symtab_subtab_find_record(subtab, key, hash, symtab->stats);
+    if (rec) {
+      entry->rec = rec;
+      entry->lvl = found_lvl;
+      if (lvl != NULL) {
+        (*lvl) += found_lvl;
+      }
+      return &rec->data.var_data;
     }
+    found_lvl++;
   }
 
   return NULL;
@@ -301,7 +370,14 @@ symtab_var_data_t* symtab_find_var(const symtab_t* symtab, symtab_key_t key,
 
 symtab_var_data_t* symtab_find_var_local(const symtab_t* symtab,
                                          symtab_key_t key) {
-  symtab_data_t* data = symtab_subtab_find(symtab->local_scopes, key);
+  return symtab_find_var_local_hashed(symtab, key, symtab_hash(key));
+}
+
+symtab_var_data_t* symtab_find_var_local_hashed(const symtab_t* symtab,
+                                                symtab_key_t key,
+                                                uint32_t hash) {
+  symtab_data_t* data =
+      symtab_subtab_find(symtab->local_scopes, key, hash, symtab->stats);
   if (data) {
     return &data->var_data;
   }
@@ -310,7 +386,13 @@ symtab_var_data_t* symtab_find_var_local(const symtab_t* symtab,
 }
 
 symtab_func_data_t* symtab_find_func(const symtab_t* symtab, symtab_key_t key) {
-  symtab_data_t* data = symtab_subtab_find(symtab->global_scope, key);
+  return symtab_find_func_hashed(symtab, key, symtab_hash(key));
+}
+
+symtab_func_data_t* symtab_find_func_hashed(const symtab_t* symtab,
+                                            symtab_key_t key, uint32_t hash) {
+  symtab_data_t* data =
+      symtab_subtab_find(symtab->global_scope, key, hash, symtab->stats);
   if (data) {
     return &data->func_data;
   }
@@ -319,37 +401,65 @@ symtab_func_data_t* symtab_find_func(const symtab_t* symtab, symtab_key_t key) {
 }
 
 symtab_data_t* symtab_subtab_find(const symtab_subtab_t* subtab,
-                                  symtab_key_t key) {
-  size_t index = SuperFastHash(key) % subtab->bucket_cnt;
+                                  symtab_key_t key, uint32_t hash,
+                                  symtab_stats_t* stats) {
+  symtab_record_t* rec = symtab_subtab_find_record(subtab, key, hash, stats);
+  return rec ? &rec->data : NULL;
+}
+
+symtab_record_t* symtab_subtab_find_record(const symtab_subtab_t* subtab,
+                                           symtab_key_t key, uint32_t hash,
+                                           symtab_stats_t* stats) {
+  size_t index = hash % subtab->bucket_cnt;
 
-  for (symtab_record_t* rec = subtab->list[index]; rec != NULL;
-       rec = rec->next) {
-    if (!strcmp(rec->key, key)) {
-      return &rec->data;
+  unsigned long probes = 0;
+  symtab_record_t* rec = subtab->list[index];
+  for (; rec != NULL; rec = rec->next) {
+    probes++;
+    if (rec->hash == hash && !strcmp(rec->key, key)) {
+      break;
     }
   }
 
-  return NULL;
+  if (stats) {
+    stats->lookups++;
+    stats->probes += probes;
+    if (probes > stats->max_probes) {
+      stats->max_probes = probes;
+    }
+    if (rec) {
+      stats->hits++;
+    }
+  }
+
+  return rec;
 }
 
 symtab_var_data_t* symtab_insert_var(symtab_t* symtab, symtab_key_t key) {
-  return &symtab_subtab_insert(symtab->local_scopes, key, 'v')->var_data;
+  uint32_t hash = symtab_hash(key);
+
+  // new variable may shadow the cached one
+  symtab->cache[hash & (SYMTAB_CACHE_SIZE - 1)].rec = NULL;
+
+  return &symtab_subtab_insert(symtab->local_scopes, key, hash, 'v')->var_data;
 }
 
 symtab_func_data_t* symtab_insert_func(symtab_t* symtab, symtab_key_t key) {
-  return &symtab_subtab_insert(symtab->global_scope, key, 'f')->func_data;
+  return &symtab_subtab_insert(symtab->global_scope, key, symtab_hash(key),
+                               'f')
+              ->func_data;
 }
 
 symtab_data_t* symtab_subtab_insert(symtab_subtab_t* subtab, symtab_key_t key,
-                                    char type) {
-  size_t index = SuperFastHash(key) % subtab->bucket_cnt;
+                                    uint32_t hash, char type) {
+  size_t index = hash % subtab->bucket_cnt;
 
   symtab_record_t* last = NULL;
   for (last = subtab->list[index]; last != NULL && last->next != NULL;
        last = last->next)
     ;
 
-  symtab_record_t* new_rec = symtab_record_create(key);
+  symtab_record_t* new_rec = symtab_record_create(key, hash);
   if (error_get()) {
     return NULL;
   }
@@ -361,6 +471,7 @@ symtab_data_t* symtab_subtab_insert(symtab_subtab_t* subtab, symtab_key_t key,
     new_rec->data.func_data.func_name = NULL;
     new_rec->data.func_data.param_types = NULL;
     new_rec->data.func_data.return_types = NULL;
+    new_rec->data.func_data.builtin = BUILTIN_NONE;
   }
 
   if (!last)  // if no record on current bucket
@@ -368,6 +479,11 @@ symtab_data_t* symtab_subtab_insert(symtab_subtab_t* subtab, symtab_key_t key,
   else  // otherwise append
     last->next = new_rec;
 
+  subtab->record_cnt++;
+  if (last) {
+    subtab->collision_cnt++;
+  }
+
   return &new_rec->data;
 }
 
@@ -380,77 +496,52 @@ void symtab_subtab_foreach(const symtab_subtab_t* subtab,
   }
 }
 
-// HASH FUNCTION
-
-//--------------------------------------------------------------------------------------
-// TAKEN CODE
-// TAKEN FROM: http://www.azillionmonkeys.com/qed/hash.html
-// COPYRIGHT: © Copyright 2004-2008 by Paul Hsieh
-// LICENSE: GNU Lesser General Public License v2.1
-// LICENSE TEXT: https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt
-// CHANGES MADE: 01.10.2021 - changed parameter type and count; added local len
-//                            variable
-
-#undef get16bits
-#if (defined(__GNUC__) && defined(__i386__)) || defined(__WATCOMC__) || \
-    defined(_MSC_VER) || defined(__BORLANDC__) || defined(__TURBOC__)
-#define get16bits(d) (*((const uint16_t*)(d)))
-#endif
-
-#if !defined(get16bits)
-#define get16bits(d)                               \
-  ((((uint32_t)(((const uint8_t*)(d))[1])) << 8) + \
-   (uint32_t)(((const uint8_t*)(d))[0]))
-#endif
-
-uint32_t SuperFastHash(symtab_key_t data) {
-  int len = strlen(data);
-  uint32_t hash = len, tmp;
-  int rem;
-
-  if (len <= 0 || data == NULL) return 0;
-
-  rem = len & 3;
-  len >>= 2;
-
-  /* Main loop */
-  for (; len > 0; len--) {
-    hash += get16bits(data);
-    tmp = (get16bits(data + 2) << 11) ^ hash;
-    hash = (hash << 16) ^ tmp;
-    data += 2 * sizeof(uint16_t);
-    hash += hash >> 11;
+// STATISTICS
+
+bool symtab_stats_enable(symtab_t* symtab) {
+  if (symtab->stats) {
+    return true;
   }
 
-  /* Handle end cases */
-  switch (rem) {
-    case 3:
-      hash += get16bits(data);
-      hash ^= hash << 16;
-      hash ^= ((signed char)data[sizeof(uint16_t)]) << 18;
-      hash += hash >> 11;
-      break;
-    case 2:
-      hash += get16bits(data);
-      hash ^= hash << 11;
-      hash += hash >> 17;
-      break;
-    case 1:
-      hash += (signed char)*data;
-      hash ^= hash << 10;
-      hash += hash >> 1;
+  symtab->stats = calloc(1, sizeof(symtab_stats_t));
+  if (!symtab->stats) {
+    error_set(EXITSTATUS_INTERNAL_ERROR);
+    return false;
   }
 
-  /* Force "avalanching" of final 127 bits */
-  hash ^= hash << 3;
-  hash += hash >> 5;
-  hash ^= hash << 4;
-  hash += hash >> 17;
-  hash ^= hash << 25;
-  hash += hash >> 6;
+  // local subtables already on the stack
+  for (symtab_subtab_t* subtab = symtab->local_scopes; subtab != NULL;
+       subtab = subtab->next) {
+    symtab->stats->depth++;
+  }
+  symtab->stats->peak_depth = symtab->stats->depth;
 
-  return hash;
+  return true;
 }
 
-// END OF TAKEN CODE
-//--------------------------------------------------------------------------------------
+void symtab_stats_print(const symtab_t* symtab, FILE* f) {
+  const symtab_stats_t* stats = symtab->stats;
+  if (!stats) {
+    return;
+  }
+
+  const symtab_subtab_t* global = symtab->global_scope;
+
+  fprintf(f, "symtab: %s hash\n", hash_name());
+  fprintf(f, "symtab: %lu lookups, %lu hits\n", stats->lookups, stats->hits);
+  fprintf(f, "symtab: %lu variable lookups resolved by cache\n",
+          stats->cache_hits);
+  fprintf(f, "symtab: %.2f average probes, %lu max probes\n",
+          stats->lookups ? (double)stats->probes / stats->lookups : 0.0,
+          stats->max_probes);
+  fprintf(f, "symtab: global table %zu records, %zu collisions, %zu buckets\n",
+          global->record_cnt, global->collision_cnt, global->bucket_cnt);
+  fprintf(f, "symtab: %lu local scopes, %lu peak depth\n", stats->scopes,
+          stats->peak_depth);
+  fprintf(f, "symtab: local tables %lu records, %.2f average, %lu max\n",
+          stats->local_records,
+          stats->scopes ? (double)stats->local_records / stats->scopes : 0.0,
+          stats->max_scope_records);
+  fprintf(f, "symtab: local tables %lu collisions, %lu max\n",
+          stats->local_collisions, stats->max_scope_collisions);
+}
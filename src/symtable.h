@@ -23,8 +23,16 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 
+// COMPILE-TIME CONSTANTS
+
+/**
+ * Entry count of variable lookup cache. Must be power of two.
+ */
+#define SYMTAB_CACHE_SIZE 16
+
 // DATA STRUCTURES
 
 /**
@@ -57,6 +65,23 @@ typedef struct {
   bool is_init;
 } symtab_var_data_t;
 
+/**
+ * @brief Builtin function identifier.
+ *  Lets code generator dispatch on builtin functions
+ *  without comparing their names.
+ */
+typedef enum {
+  BUILTIN_NONE,       ///< User defined function
+  BUILTIN_WRITE,      ///< write(...)
+  BUILTIN_READS,      ///< reads()
+  BUILTIN_READI,      ///< readi()
+  BUILTIN_READN,      ///< readn()
+  BUILTIN_TOINTEGER,  ///< tointeger(f)
+  BUILTIN_SUBSTR,     ///< substr(s, i, j)
+  BUILTIN_ORD,        ///< ord(s, i)
+  BUILTIN_CHR,        ///< chr(i)
+} symtab_builtin_t;
+
 /**
  * @struct symtab_func_data_t
  * @brief Data of the function identifier.
@@ -71,12 +96,15 @@ typedef struct {
  *  Each represented as single character in string.
  * @var symtab_func_data_t::was_defined
  *  Was the function body already defined?
+ * @var symtab_func_data_t::builtin
+ *  Builtin function identifier, BUILTIN_NONE for user functions.
  */
 typedef struct {
   char* func_name;
   char* param_types;
   char* return_types;
   bool was_defined;
+  symtab_builtin_t builtin;
 } symtab_func_data_t;
 
 /**
@@ -99,6 +127,8 @@ typedef union {
  *  Next record on the same bucket.
  * @var symtab_record_t::key
  *  Key of the hash function.
+ * @var symtab_record_t::hash
+ *  Hash of the key.
  * @var symtab_record_t::what_data
  *  If 'v' -> variable record.
  *  If 'f' -> function record.
@@ -108,6 +138,7 @@ typedef union {
 typedef struct symtab_record {
   struct symtab_record* next;
   symtab_key_t key;
+  uint32_t hash;
   char what_data;
   symtab_data_t data;
 } symtab_record_t;
@@ -117,6 +148,10 @@ typedef struct symtab_record {
  * @brief Subtable of identifiers of one scope.
  * @var symtab_subtab_t::next
  *  Next subtable on the stack.
+ * @var symtab_subtab_t::record_cnt
+ *  Number of records in the subtable.
+ * @var symtab_subtab_t::collision_cnt
+ *  Number of records inserted into an already occupied bucket.
  * @var symtab_subtab_t::bucket_cnt
  *  Bucket count of the subtable.
  * @var symtab_subtab_t::list
@@ -124,10 +159,71 @@ typedef struct symtab_record {
  */
 typedef struct symtab_subtab {
   struct symtab_subtab* next;
+  size_t record_cnt;
+  size_t collision_cnt;
   size_t bucket_cnt;
   symtab_record_t* list[];
 } symtab_subtab_t;
 
+/**
+ * @struct symtab_cache_entry_t
+ * @brief Resolved variable reference.
+ *  Valid until a local subtable is pushed or popped,
+ *  or the name gets shadowed.
+ * @var symtab_cache_entry_t::rec
+ *  Record the name resolved to. NULL if entry is empty.
+ * @var symtab_cache_entry_t::lvl
+ *  Level of scope of the record, counted from the top of the stack.
+ */
+typedef struct {
+  symtab_record_t* rec;
+  int lvl;
+} symtab_cache_entry_t;
+
+/**
+ * @struct symtab_stats_t
+ * @brief Usage statistics of symbol table.
+ *  Collected only when enabled by symtab_stats_enable().
+ * @var symtab_stats_t::lookups
+ *  Number of searches of a single subtable.
+ * @var symtab_stats_t::hits
+ *  Number of searches of a single subtable which found the key.
+ * @var symtab_stats_t::cache_hits
+ *  Number of variable lookups resolved by the lookup cache.
+ * @var symtab_stats_t::probes
+ *  Total number of records compared during searches.
+ * @var symtab_stats_t::max_probes
+ *  Most records compared during a single search.
+ * @var symtab_stats_t::scopes
+ *  Number of local subtables pushed.
+ * @var symtab_stats_t::depth
+ *  Current number of local subtables on the stack.
+ * @var symtab_stats_t::peak_depth
+ *  Maximal number of local subtables on the stack.
+ * @var symtab_stats_t::local_records
+ *  Total number of records inserted in local subtables.
+ * @var symtab_stats_t::max_scope_records
+ *  Most records in a single local subtable.
+ * @var symtab_stats_t::local_collisions
+ *  Total number of collisions in local subtables.
+ * @var symtab_stats_t::max_scope_collisions
+ *  Most collisions in a single local subtable.
+ */
+typedef struct {
+  unsigned long lookups;
+  unsigned long hits;
+  unsigned long cache_hits;
+  unsigned long probes;
+  unsigned long max_probes;
+  unsigned long scopes;
+  unsigned long depth;
+  unsigned long peak_depth;
+  unsigned long local_records;
+  unsigned long max_scope_records;
+  unsigned long local_collisions;
+  unsigned long max_scope_collisions;
+} symtab_stats_t;
+
 /**
  * @struct symtab_t
  * @brief Hierarchical symbol table.
@@ -137,10 +233,17 @@ typedef struct symtab_subtab {
  *  Table containing global identifiers, ie. functions.
  * @var symtab_t::local_scopes
  *  Top of stack of tables containing local identifiers, ie. variables.
+ * @var symtab_t::stats
+ *  Usage statistics. NULL if not collected.
+ * @var symtab_t::cache
+ *  Direct-mapped cache of resolved variable names, indexed by hash.
+ *  Cleared whenever the stack of local tables changes.
  */
 typedef struct {
   symtab_subtab_t* global_scope;
   symtab_subtab_t* local_scopes;
+  symtab_stats_t* stats;
+  symtab_cache_entry_t cache[SYMTAB_CACHE_SIZE];
 } symtab_t;
 
 // PUBLIC FUNCTION FORWARD DECLARATIONS
@@ -186,17 +289,36 @@ void symtab_subtab_pop(symtab_t* symtab);
 
 // MANIPULATION WITH RECORDS
 
+/**
+ * Hashes key with the hash function used by symbol table.
+ * @param key Key to hash.
+ * @return Hash of the key.
+ */
+uint32_t symtab_hash(symtab_key_t key);
+
 /**
  * Searches whole stack of local tables
  * for most nested variable.
+ * Found variables are remembered in lookup cache of symbol table.
  * @param symtab Symbol table to search on.
  * @param key Key to search for.
  * @param lvl If not NULL, integer where to store level of scope.
  * @return Found record data. NULL otherwise.
  */
-symtab_var_data_t* symtab_find_var(const symtab_t* symtab, symtab_key_t key,
+symtab_var_data_t* symtab_find_var(symtab_t* symtab, symtab_key_t key,
                                    int* lvl);
 
+/**
+ * Same as symtab_find_var(), with already computed hash of the key.
+ * @param symtab Symbol table to search on.
+ * @param key Key to search for.
+ * @param hash Hash of the key, see symtab_hash().
+ * @param lvl If not NULL, integer where to store level of scope.
+ * @return Found record data. NULL otherwise.
+ */
+symtab_var_data_t* symtab_find_var_hashed(symtab_t* symtab, symtab_key_t key,
+                                          uint32_t hash, int* lvl);
+
 /**
  * Searches table on top of stack (most nested scope)
  * for variable.
@@ -207,6 +329,17 @@ symtab_var_data_t* symtab_find_var(const symtab_t* symtab, symtab_key_t key,
 symtab_var_data_t* symtab_find_var_local(const symtab_t* symtab,
                                          symtab_key_t key);
 
+/**
+ * Same as symtab_find_var_local(), with already computed hash of the key.
+ * @param symtab Symbol table to search on.
+ * @param key Key to search for.
+ * @param hash Hash of the key, see symtab_hash().
+ * @return Found record data. NULL otherwise.
+ */
+symtab_var_data_t* symtab_find_var_local_hashed(const symtab_t* symtab,
+                                                symtab_key_t key,
+                                                uint32_t hash);
+
 /**
  * Searches global table for function identifier.
  * @param symtab Symbol table to search on.
@@ -215,6 +348,16 @@ symtab_var_data_t* symtab_find_var_local(const symtab_t* symtab,
  */
 symtab_func_data_t* symtab_find_func(const symtab_t* symtab, symtab_key_t key);
 
+/**
+ * Same as symtab_find_func(), with already computed hash of the key.
+ * @param symtab Symbol table to search on.
+ * @param key Key to search for.
+ * @param hash Hash of the key, see symtab_hash().
+ * @return Found record data. NULL otherwise.
+ */
+symtab_func_data_t* symtab_find_func_hashed(const symtab_t* symtab,
+                                            symtab_key_t key, uint32_t hash);
+
 /**
  * Creates and inserts new record in topmost local table (most nested scope).
  * @param symtab Symbol table to instert into.
@@ -239,4 +382,21 @@ symtab_func_data_t* symtab_insert_func(symtab_t* symtab, symtab_key_t key);
 void symtab_subtab_foreach(const symtab_subtab_t* subtab,
                            void (*f)(symtab_data_t* data));
 
+// STATISTICS
+
+/**
+ * Starts collecting usage statistics of symbol table.
+ * @param symtab Symbol table to collect statistics of.
+ * @return True if successful. False otherwise.
+ */
+bool symtab_stats_enable(symtab_t* symtab);
+
+/**
+ * Prints collected usage statistics of symbol table.
+ * Does nothing if statistics are not collected.
+ * @param symtab Symbol table to print statistics of.
+ * @param f File to print into.
+ */
+void symtab_stats_print(const symtab_t* symtab, FILE* f);
+
 #endif  // __SYMTAB_H__
@@ -13,14 +13,13 @@
 
 #include <stdbool.h>
 
-#include "codegen.h"
+#include "ast.h"
 #include "dynstr.h"
 #include "errors.h"
 #include "expressions.h"
 #include "other.h"
 #include "parser.h"
 #include "scanner.h"
-#include "scope.h"
 #include "symtable.h"
 
 // PRIVATE FUNCTION FORWARD DECLARATIONS
@@ -349,9 +348,18 @@ bool parser_exp_append(const char* left_types, int pos, dynstr_t* exp_types);
  * Parsing function for rules with
  * non-terminal 'exp' on left side.
  * @param exp_type Character where to store expression type.
+ * @param exp Where to store expression tree.
  * @return True if correct. False otherwise.
  */
-bool parser_exp(char* exp_type);
+bool parser_exp(char* exp_type, exptree_node_t** exp);
+
+/**
+ * Parsing function for condition of if and while statements.
+ * @param cond_type Character where to store condition type.
+ * @param cond Where to store condition tree.
+ * @return True if correct. False otherwise.
+ */
+bool parser_cond(char* cond_type, exptree_node_t** cond);
 
 // CHECK FOR TYPE COMPATIBILITY
 
@@ -528,7 +536,7 @@ bool parser_function_def() {
         goto POP_SUBTAB;
       }
 
-      codegen_function_definition_begin(id);
+      ast_function_begin(id);
       if (parser_param_list(&param_types)) {
         token = token_buff(TOKEN_THIS);
 
@@ -556,8 +564,8 @@ bool parser_function_def() {
             }
           }
 
-          codegen_function_definition_body();
           parser_define_func(id);
+          ast_function_body(symtab_find_func(symtab, id));
 
           if (parser_local_scope(id, &ret_types, false)) {
             token = token_buff(TOKEN_THIS);
@@ -569,7 +577,7 @@ bool parser_function_def() {
               }
 
               is_correct = true;
-              codegen_function_definition_end(id, ret_types.len);
+              ast_function_end();
               goto POP_SUBTAB;
             }
           }
@@ -727,7 +735,7 @@ bool parser_function_call(symtab_func_data_t* func) {
     }
 
     int arg_count = 0;
-    codegen_function_call_begin(func->func_name);
+    ast_call_begin(func);
     if (parser_arg_list(&arg_types, &arg_count)) {
       token = token_buff(TOKEN_THIS);
 
@@ -743,7 +751,7 @@ bool parser_function_call(symtab_func_data_t* func) {
         }
 
         is_correct = true;
-        codegen_function_call_do(func->func_name);
+        ast_call_end();
         goto FREE_ARG_TYPES;
       }
     }
@@ -786,7 +794,7 @@ bool parser_param_list(dynstr_t* param_types) {
         goto FREE_NAME;
       }
 
-      codegen_function_definition_param(name, 0);
+      ast_function_param(name, param_type);
 
       if (parser_param_append(param_types, 1)) {
         is_correct = true;
@@ -839,7 +847,7 @@ bool parser_param_append(dynstr_t* param_types, int param_pos) {
         goto FREE_NAME;
       }
 
-      codegen_function_definition_param(name, param_pos);
+      ast_function_param(name, param_type);
 
       if (parser_param_append(param_types, param_pos + 1)) {
         is_correct = true;
@@ -1092,7 +1100,7 @@ bool parser_arg_list(dynstr_t* arg_types, int* arg_pos) {
           return false;
         }
 
-        codegen_function_call_argument(token, *arg_pos, lvl);
+        ast_call_arg(token, arg_type, lvl);
         ++(*arg_pos);
 
         token = token_buff(TOKEN_NEW);
@@ -1135,7 +1143,7 @@ bool parser_arg_append(dynstr_t* arg_types, int* arg_pos) {
           return false;
         }
 
-        codegen_function_call_argument(token, *arg_pos, lvl);
+        ast_call_arg(token, arg_type, lvl);
         ++(*arg_pos);
 
         token = token_buff(TOKEN_NEW);
@@ -1166,7 +1174,7 @@ bool parser_arg(char* arg_type, int* lvl) {
   switch (token->type) {
     case TT_ID: {
       symtab_var_data_t* declared_var =
-          symtab_find_var(symtab, token->attr.str, lvl);
+          symtab_find_var_hashed(symtab, token->attr.str, token->hash, lvl);
       if (!declared_var) {
         error_set(EXITSTATUS_ERROR_SEMANTIC_IDENTIFIER);
         return false;
@@ -1316,8 +1324,9 @@ bool parser_returned(const char* ret_types, dynstr_t* exp_types) {
         return false;
       }
 
+      ast_return_begin(strlen(ret_types));
       if (parser_return_what(ret_types, exp_types)) {
-        codegen_function_return(strlen(ret_types), exp_types->len);
+        ast_return_end();
         return true;
       }
 
@@ -1375,7 +1384,7 @@ bool parser_var_dec(const char* func_name) {
   if (token->type == TT_ID) {
     // search current local scope for a variable of the same name
     symtab_var_data_t* declared_var =
-        symtab_find_var_local(symtab, token->attr.str);
+        symtab_find_var_local_hashed(symtab, token->attr.str, token->hash);
     if (declared_var) {
       error_set(EXITSTATUS_ERROR_SEMANTIC_IDENTIFIER);
       goto FREE_ID;
@@ -1383,7 +1392,7 @@ bool parser_var_dec(const char* func_name) {
 
     // function of same name as variable
     symtab_func_data_t* declared_func =
-        symtab_find_func(symtab, token->attr.str);
+        symtab_find_func_hashed(symtab, token->attr.str, token->hash);
     if (declared_func) {
       error_set(EXITSTATUS_ERROR_SEMANTIC_IDENTIFIER);
       goto FREE_ID;
@@ -1408,15 +1417,11 @@ bool parser_var_dec(const char* func_name) {
 
       char var_type = 0;
       if (parser_type(&var_type)) {
-        codegen_define_var(id, 0);
+        ast_local_begin(id, var_type);
         bool did_init = false;
         if (parser_init(var_type, &did_init)) {
           parser_declare_var(id, var_type);
-          if (did_init) {
-            // TODO check
-            codegen_assign_expression_add(id, 0);
-            codegen_assign_expression_finish(1);
-          }
+          ast_local_end();
           if (error_get()) {
             goto FREE_ID;
           }
@@ -1443,22 +1448,17 @@ bool parser_if_st(const char* func_name, const dynstr_t* ret_types) {
   token_t* token = token_buff(TOKEN_THIS);
 
   char cond_type;
-  if (parser_exp(&cond_type)) {
-    if (cond_type != 'b') {
-      codegen_not_nil();
-    }
+  exptree_node_t* cond;
+  if (parser_cond(&cond_type, &cond)) {
+    ast_if_begin(cond, cond_type);
     token = token_buff(TOKEN_THIS);
 
-    scope_new_if();
-
     if (token->type == TT_K_THEN) {
       token = token_buff(TOKEN_NEW);
       if (error_get()) {
         return false;
       }
 
-      codegen_if_begin();
-
       if (parser_local_scope(func_name, ret_types, true)) {
         token = token_buff(TOKEN_THIS);
 
@@ -1468,9 +1468,7 @@ bool parser_if_st(const char* func_name, const dynstr_t* ret_types) {
             return false;
           }
 
-          codegen_if_else();
-          scope_pop_item();  // else
-          scope_new_if();
+          ast_if_else();
 
           if (parser_local_scope(func_name, ret_types, true)) {
             token = token_buff(TOKEN_THIS);
@@ -1481,8 +1479,7 @@ bool parser_if_st(const char* func_name, const dynstr_t* ret_types) {
                 return false;
               }
 
-              codegen_if_end();
-              scope_pop_item();  // end if
+              ast_if_end();
 
               return true;
             }
@@ -1503,13 +1500,10 @@ bool parser_if_st(const char* func_name, const dynstr_t* ret_types) {
 bool parser_while_st(const char* func_name, const dynstr_t* ret_types) {
   token_t* token = token_buff(TOKEN_THIS);
 
-  codegen_while_begin();
-
   char cond_type;
-  if (parser_exp(&cond_type)) {
-    if (cond_type != 'b') {
-      codegen_not_nil();
-    }
+  exptree_node_t* cond;
+  if (parser_cond(&cond_type, &cond)) {
+    ast_while_begin(cond, cond_type);
     token = token_buff(TOKEN_THIS);
 
     if (token->type == TT_K_DO) {
@@ -1518,9 +1512,6 @@ bool parser_while_st(const char* func_name, const dynstr_t* ret_types) {
         return false;
       }
 
-      codegen_while_expr();
-      scope_new_while();
-
       if (parser_local_scope(func_name, ret_types, true)) {
         token = token_buff(TOKEN_THIS);
 
@@ -1530,8 +1521,7 @@ bool parser_while_st(const char* func_name, const dynstr_t* ret_types) {
             return false;
           }
 
-          codegen_while_end();
-          scope_pop_item();
+          ast_while_end();
 
           return true;
         }
@@ -1604,16 +1594,15 @@ bool parser_init_after(char var_type) {
 
 bool parser_init_exp(char var_type) {
   char exp_type;
-  if (parser_exp(&exp_type)) {
-    if (var_type != exp_type) {
-      if (var_type == 'n' && exp_type == 'i') {
-        codegen_cast_int_to_float1();
-      } else if (exp_type != 'x') {
-        error_set(EXITSTATUS_ERROR_SEMANTIC_ASSIGNMENT);
-        return false;
-      }
+  exptree_node_t* exp;
+  if (parser_exp(&exp_type, &exp)) {
+    if (var_type != exp_type && exp_type != 'x' &&
+        !(var_type == 'n' && exp_type == 'i')) {
+      error_set(EXITSTATUS_ERROR_SEMANTIC_ASSIGNMENT);
+      return false;
     }
 
+    ast_value(exp, var_type == 'n' && exp_type == 'i');
     return true;
   }
 
@@ -1628,7 +1617,8 @@ bool parser_init_exp(char var_type) {
 bool parser_init_func(char var_type) {
   token_t* token = token_buff(TOKEN_THIS);
 
-  symtab_func_data_t* declared = symtab_find_func(symtab, token->attr.str);
+  symtab_func_data_t* declared =
+      symtab_find_func_hashed(symtab, token->attr.str, token->hash);
 
   if (parser_function_call_by_id(token->attr.str)) {
     if (!parser_init_func_match(var_type, declared->return_types)) {
@@ -1720,7 +1710,8 @@ bool parser_assign_st(char* id) {
     goto FREE_ID_TYPES;
   }
 
-  codegen_assign_expression_add(id, lvl);
+  ast_assign_begin();
+  ast_assign_id(id, declared_var->data_type, lvl);
 
   if (parser_id_append(&id_types)) {
     token_t* token = token_buff(TOKEN_THIS);
@@ -1733,7 +1724,7 @@ bool parser_assign_st(char* id) {
 
       int assign_length = 0;
       if (parser_assign_what(&id_types, &assign_length)) {
-        codegen_assign_expression_finish(assign_length);
+        ast_assign_end(assign_length);
 
         is_correct = true;
         goto FREE_ID_TYPES;
@@ -1768,7 +1759,7 @@ bool parser_id_append(dynstr_t* id_types) {
     if (token->type == TT_ID) {
       int lvl = 0;
       symtab_var_data_t* declared_var =
-          symtab_find_var(symtab, token->attr.str, &lvl);
+          symtab_find_var_hashed(symtab, token->attr.str, token->hash, &lvl);
       if (!declared_var) {
         error_set(EXITSTATUS_ERROR_SEMANTIC_IDENTIFIER);
         return false;
@@ -1779,7 +1770,7 @@ bool parser_id_append(dynstr_t* id_types) {
         return false;
       }
 
-      codegen_assign_expression_add(token->attr.str, lvl);
+      ast_assign_id(token->attr.str, declared_var->data_type, lvl);
 
       token = token_buff(TOKEN_NEW);
       if (error_get()) {
@@ -1861,7 +1852,8 @@ EXIT:
 bool parser_assign_func(const dynstr_t* id_types, int* assign_length) {
   token_t* token = token_buff(TOKEN_THIS);
 
-  symtab_func_data_t* declared = symtab_find_func(symtab, token->attr.str);
+  symtab_func_data_t* declared =
+      symtab_find_func_hashed(symtab, token->attr.str, token->hash);
 
   if (parser_function_call_by_id(token->attr.str)) {
     if (!parser_assign_func_match(id_types->str, declared->return_types)) {
@@ -1894,10 +1886,9 @@ bool parser_exp_list(const char* left_types, dynstr_t* exp_types) {
     case TT_ID: {
       char exp_type;
       char var_type = left_types[0];
-      if (parser_exp(&exp_type)) {
-        if (var_type == 'n' && exp_type == 'i') {
-          codegen_cast_int_to_float1();
-        }
+      exptree_node_t* exp;
+      if (parser_exp(&exp_type, &exp)) {
+        ast_value(exp, var_type == 'n' && exp_type == 'i');
 
         dynstr_append(exp_types, exp_type);
         if (error_get()) {
@@ -1939,10 +1930,9 @@ bool parser_exp_append(const char* left_types, int pos, dynstr_t* exp_types) {
 
       char exp_type;
       char var_type = left_types[pos];
-      if (parser_exp(&exp_type)) {
-        if (var_type == 'n' && exp_type == 'i') {
-          codegen_cast_int_to_float1();
-        }
+      exptree_node_t* exp;
+      if (parser_exp(&exp_type, &exp)) {
+        ast_value(exp, var_type == 'n' && exp_type == 'i');
 
         dynstr_append(exp_types, exp_type);
         if (error_get()) {
@@ -1964,7 +1954,25 @@ bool parser_exp_append(const char* left_types, int pos, dynstr_t* exp_types) {
   return false;
 }
 
-bool parser_exp(char* exp_type) {
+bool parser_exp(char* exp_type, exptree_node_t** exp) {
+  token_t* token = token_buff(TOKEN_THIS);
+
+  switch (token->type) {
+    case TT_INTEGER:
+    case TT_NUMBER:
+    case TT_STRING:
+    case TT_LPAR:
+    case TT_K_NIL:
+    case TT_SOP_LENGTH:
+    case TT_ID:
+      return expression_parse_tree(exp_type, exp, &ast_arena);
+    default:
+      error_set(EXITSTATUS_ERROR_SYNTAX);
+      return false;
+  }
+}
+
+bool parser_cond(char* cond_type, exptree_node_t** cond) {
   token_t* token = token_buff(TOKEN_THIS);
 
   switch (token->type) {
@@ -1975,7 +1983,7 @@ bool parser_exp(char* exp_type) {
     case TT_K_NIL:
     case TT_SOP_LENGTH:
     case TT_ID:
-      return expression_parse(exp_type);
+      return expression_parse_tree(cond_type, cond, &ast_arena);
     default:
       error_set(EXITSTATUS_ERROR_SYNTAX);
       return false;
@@ -0,0 +1,45 @@
+#!/bin/sh
+# Compile time of long expressions.
+# Generates programs with one arithmetic and one concatenation chain
+# of up to 100000 operands and measures time to compile each of them
+# with every given compiler (eg. builds with different EXPRESSION_PARSER).
+# Usage: expression_bench.sh [compiler...]
+
+[ $# -eq 0 ] && set -- ./ifj21
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+generate() {
+  awk -v terms="$1" 'BEGIN {
+    print "require \"ifj21\""
+    print "function main()"
+    print "  local a : integer = 1"
+    print "  local s : string = \"x\""
+    printf "  local n : number = a"
+    for (i = 1; i < terms; i++) {
+      op = substr("+-*/", i % 4 + 1, 1)
+      printf " %s (a + %d) * 2.5", op, i
+    }
+    print ""
+    printf "  local t : string = s"
+    for (i = 1; i < terms; i++) {
+      printf " .. \"%d\" .. s", i
+    }
+    print ""
+    print "  local l : integer = #t"
+    print "  write(n, l, \"\\n\")"
+    print "end"
+    print "main()"
+  }'
+}
+
+for terms in 12500 25000 50000 100000; do
+  generate "$terms" > "$TMP/program.tl"
+  for compiler in "$@"; do
+    start=$(date +%s%N)
+    "$compiler" < "$TMP/program.tl" > "$TMP/program.code"
+    status=$?
+    end=$(date +%s%N)
+    echo "$compiler terms $terms: exit $status, $(( (end - start) / 1000000 )) ms"
+  done
+done
@@ -0,0 +1,98 @@
+#!/bin/sh
+# Executed instructions of loop-heavy programs.
+# Generates programs whose loops repeat computations of values not
+# changed by their bodies (string lengths, products of bounds) and
+# counts instructions executed by the interpreter for the code of
+# every given compiler (eg. builds before and after an optimization).
+# End-to-end test programs with loops are counted together at the end.
+# Usage: loop_bench.sh [compiler...]
+# Interpreter is taken from IC21INT, tests/e2e-from-github/ic21int
+# by default.
+
+[ $# -eq 0 ] && set -- ./ifj21
+IC21INT=${IC21INT:-tests/e2e-from-github/ic21int}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+generate() {
+  awk -v kind="$1" -v count="$2" 'BEGIN {
+    print "require \"ifj21\""
+    if (kind == "scan") {
+      # count characters of string longer than the number of passes
+      print "function main(s : string, c : string)"
+      print "  local i : integer = 1"
+      print "  local n : integer = 0"
+      print "  while i <= #s do"
+      print "    local d : string = substr(s, i, i)"
+      print "    if d == c then n = n + 1 else end"
+      print "    i = i + 1"
+      print "  end"
+      print "  write(n, \"\\n\")"
+      print "end"
+      printf "main(\""
+      for (i = 0; i < count; i++) {
+        printf "%s", substr("abc", i % 3 + 1, 1)
+      }
+      print "\", \"a\")"
+    } else if (kind == "grid") {
+      # sum over rows and columns bounded by products of parameters
+      print "function main(w : integer, h : integer)"
+      print "  local y : integer = 0"
+      print "  local sum : integer = 0"
+      print "  while y < h * 2 do"
+      print "    local x : integer = 0"
+      print "    while x < w * 2 + 1 do"
+      print "      sum = sum + x * y + (w * 2 + 1) // 3"
+      print "      x = x + 1"
+      print "    end"
+      print "    y = y + 1"
+      print "  end"
+      print "  write(sum, \"\\n\")"
+      print "end"
+      print "main(" int(sqrt(count)) ", " int(sqrt(count)) ")"
+    } else {
+      # build string from parts joined by separator of both ends
+      print "function main(n : integer, a : string, b : string)"
+      print "  local s : string = \"\""
+      print "  local i : integer = 0"
+      print "  while i < n - 1 do"
+      print "    s = s .. a .. b .. \";\""
+      print "    i = i + 1"
+      print "  end"
+      print "  local l : integer = #s"
+      print "  write(l, \"\\n\")"
+      print "end"
+      print "main(" count ", \"left\", \"right\")"
+    }
+  }'
+}
+
+for kind in scan grid concat; do
+  for count in 500 2000; do
+    generate "$kind" "$count" > "$TMP/program.tl"
+    for compiler in "$@"; do
+      "$compiler" < "$TMP/program.tl" > "$TMP/program.code"
+      status=$?
+      executed=$("$IC21INT" -v "$TMP/program.code" 2>&1 >/dev/null |
+                 grep -c "Executing instruction")
+      echo "$compiler $kind $count: exit $status, $executed instructions"
+    done
+  done
+done
+
+for compiler in "$@"; do
+  programs=0
+  total=0
+  for dir in tests/e2e-from-github/test_cases/*/; do
+    grep -q while "$dir/program.tl" || continue
+    "$compiler" < "$dir/program.tl" > "$TMP/program.code" 2>/dev/null ||
+      continue
+    input="$dir/input"
+    [ -f "$input" ] || input=/dev/null
+    executed=$("$IC21INT" -v "$TMP/program.code" < "$input" 2>&1 >/dev/null |
+               grep -c "Executing instruction")
+    programs=$((programs + 1))
+    total=$((total + executed))
+  done
+  echo "$compiler e2e loops: $programs programs, $total instructions"
+done
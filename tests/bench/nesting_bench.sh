@@ -0,0 +1,52 @@
+#!/bin/sh
+# Compile time of deeply nested programs.
+# Generates programs with blocks nested up to 10000 levels deep
+# (alternating if and while) and measures time to compile each of them.
+# Fails when the time grows faster than linearly with the depth.
+# Usage: nesting_bench.sh [compiler]
+
+COMPILER=${1:-./ifj21}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+generate() {
+  awk -v depth="$1" 'BEGIN {
+    print "require \"ifj21\""
+    print "function main()"
+    print "  local v0 : integer = 0"
+    for (i = 1; i <= depth; i++) {
+      if (i % 2) {
+        print "if v" i - 1 " == 0 then"
+      } else {
+        print "while v" i - 1 " < 0 do"
+      }
+      print "local v" i " : integer = v" i - 1 " + 1"
+    }
+    print "write(v" depth ", \"\\n\")"
+    for (i = depth; i >= 1; i--) {
+      if (i % 2) {
+        print "else"
+      }
+      print "end"
+    }
+    print "end"
+    print "main()"
+  }'
+}
+
+for depth in 1250 2500 5000 10000; do
+  generate "$depth" > "$TMP/program.tl"
+  start=$(date +%s%N)
+  "$COMPILER" < "$TMP/program.tl" > "$TMP/program.code"
+  status=$?
+  end=$(date +%s%N)
+  time=$(( (end - start) / 1000000 ))
+  echo "depth $depth: exit $status, $time ms"
+  [ "$depth" -eq 2500 ] && base=$time
+done
+
+# four times deeper than the base takes 16 times longer if quadratic
+if [ "$time" -gt $(( base * 8 + 50 )) ]; then
+  echo "depth 10000 took more than 8 times as long as depth 2500"
+  exit 1
+fi
@@ -0,0 +1,74 @@
+/**
+ * @file
+ * @brief Symbol table lookup benchmark
+ *
+ * Measures lookup throughput of symbol table with hash function
+ * selected at build time (see hash.h). Identifiers are short names
+ * typical for IFJ21 programs, spread over several nested scopes.
+ * Lookups either hash the key (symtab_find_var) or reuse hash
+ * computed by scanner (symtab_find_var_hashed).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../src/errors.h"
+#include "../../src/hash.h"
+#include "../../src/symtable.h"
+
+#define SCOPES 4
+#define IDS_PER_SCOPE 24
+#define ID_COUNT (SCOPES * IDS_PER_SCOPE)
+#define ROUNDS 200000
+
+static const char* prefixes[] = {"i",   "j",      "n",   "x",     "tmp",
+                                 "str", "result", "len", "count", "a_b"};
+
+int main() {
+  static char ids[ID_COUNT][16];
+  static uint32_t hashes[ID_COUNT];
+
+  symtab_t* symtab = symtab_create();
+  if (!symtab) {
+    return 1;
+  }
+
+  for (int i = 0; i < ID_COUNT; i++) {
+    if (i % IDS_PER_SCOPE == 0) {
+      symtab_subtab_push(symtab);
+    }
+    sprintf(ids[i], "%s%d", prefixes[i % 10], i / 10);
+    hashes[i] = symtab_hash(ids[i]);
+    symtab_insert_var(symtab, ids[i]);
+  }
+  symtab_stats_enable(symtab);
+
+  unsigned long found = 0;
+  clock_t start = clock();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < ID_COUNT; i++) {
+      found += symtab_find_var(symtab, ids[i], NULL) != NULL;
+    }
+  }
+  double plain = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  start = clock();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < ID_COUNT; i++) {
+      found += symtab_find_var_hashed(symtab, ids[i], hashes[i], NULL) != NULL;
+    }
+  }
+  double hashed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  double lookups = (double)ROUNDS * ID_COUNT;
+  printf("%s: %.1f ns/lookup, %.1f ns/lookup with scanner hash (%lu found)\n",
+         hash_name(), plain * 1e9 / lookups, hashed * 1e9 / lookups, found);
+  printf("%s: %.2f average probes, %lu max probes\n", hash_name(),
+         (double)symtab->stats->probes / symtab->stats->lookups,
+         symtab->stats->max_probes);
+
+  symtab_free(symtab);
+  return 0;
+}
@@ -0,0 +1,134 @@
+#include "../../lib/greatest.h"
+#include "../../src/ast.c"
+
+TEST ast_blocks(void) {
+  error_clear();
+  ast_init();
+
+  // function f(a) while a do if a then return else end end end
+  token_t token = {.type = TT_INTEGER, .attr.int_val = 1};
+  exptree_node_t *cond = exptree_leaf(&ast_arena, &token, 'i', 0);
+  ast_function_begin("f");
+  ast_function_param("a", 'i');
+  symtab_func_data_t f = {.return_types = "i", .builtin = BUILTIN_NONE};
+  ast_function_body(&f);
+  ast_while_begin(cond, 'i');
+  ast_if_begin(cond, 'i');
+  ast_return_begin(1);
+  ast_value(cond, true);
+  ast_return_end();
+  ast_if_else();
+  ast_if_end();
+  ast_while_end();
+  ast_function_end();
+  ast_call_begin(NULL);
+  ast_call_end();
+
+  ast_node_t *func = ast_program;
+  ASSERT_EQ(AST_FUNCTION, func->kind);
+  ASSERT_STR_EQ("f", func->name);
+  ASSERT_EQ(1, func->ret_count);
+  ASSERT_STR_EQ("a", func->ids->tree->value.str);
+  ASSERT_EQ(NULL, func->ids->next);
+
+  ast_node_t *loop = func->body;
+  ASSERT_EQ(AST_WHILE, loop->kind);
+  ASSERT_EQ(func, loop->parent);
+  ASSERT_EQ(NULL, loop->next);
+
+  ast_node_t *branch = loop->body;
+  ASSERT_EQ(AST_IF, branch->kind);
+  ASSERT_EQ(NULL, branch->else_body);
+  ASSERT_EQ(AST_RETURN, branch->body->kind);
+  ASSERT_EQ(1, branch->body->value_count);
+  ASSERT(branch->body->values->to_number);
+
+  // call after the function is a statement of the top level
+  ASSERT_EQ(AST_CALL, func->next->kind);
+  ASSERT_EQ(NULL, func->next->parent);
+
+  ast_free();
+  ASSERT_EQ(0, error_get());
+  PASS();
+}
+
+TEST ast_assigned_call(void) {
+  error_clear();
+  ast_init();
+
+  // local x : integer = g(1)  x, y = g(1)
+  token_t token = {.type = TT_INTEGER, .attr.int_val = 1};
+  ast_local_begin("x", 'i');
+  ast_call_begin(NULL);
+  ast_call_arg(&token, 'i', 0);
+  ast_call_end();
+  ast_local_end();
+  ast_assign_begin();
+  ast_assign_id("x", 'i', 0);
+  ast_assign_id("y", 'n', 1);
+  ast_call_begin(NULL);
+  ast_call_end();
+  ast_assign_end(2);
+
+  ast_node_t *local = ast_program;
+  ASSERT_EQ(AST_LOCAL, local->kind);
+  ASSERT_EQ(NULL, local->values);
+  ASSERT_EQ(AST_CALL, local->call->kind);
+  ASSERT_EQ(EXP_INTEGER, local->call->ids->tree->kind);
+
+  ast_node_t *assign = local->next;
+  ASSERT_EQ(AST_ASSIGN, assign->kind);
+  ASSERT_EQ(2, assign->value_count);
+  ASSERT_STR_EQ("y", assign->ids->next->tree->value.str);
+  ASSERT_EQ(1, assign->ids->next->tree->lvl);
+  ASSERT(assign->call);
+  ASSERT_EQ(NULL, assign->next);
+
+  ast_free();
+  PASS();
+}
+
+TEST ast_prune_unreachable(void) {
+  error_clear();
+  ast_init();
+
+  // functions f, g, h, k where f calls g, k is called in if false
+  // and only f is called from the top level
+  symtab_func_data_t funcs[4];
+  const char *names[] = {"f", "g", "h", "k"};
+  for (int i = 0; i < 4; i++) {
+    funcs[i] = (symtab_func_data_t){.return_types = "", .builtin = BUILTIN_NONE};
+  }
+  token_t token = {.type = TT_K_NIL};
+  exptree_node_t *never = exptree_leaf(&ast_arena, &token, 'x', 0);
+  for (int i = 3; i >= 0; i--) {
+    ast_function_begin(names[i]);
+    ast_function_body(&funcs[i]);
+    if (i == 0) {
+      ast_call_begin(&funcs[1]);
+      ast_call_end();
+      ast_if_begin(never, 'x');
+      ast_call_begin(&funcs[3]);
+      ast_call_end();
+      ast_if_end();
+    }
+    ast_function_end();
+  }
+  ast_call_begin(&funcs[0]);
+  ast_call_end();
+
+  ast_prune();
+  ASSERT_EQ(0, error_get());
+  ASSERT_STR_EQ("g", ast_program->name);
+  ASSERT_STR_EQ("f", ast_program->next->name);
+  ASSERT_EQ(AST_CALL, ast_program->next->next->kind);
+
+  ast_free();
+  PASS();
+}
+
+SUITE(ast_tests) {
+  RUN_TEST(ast_blocks);
+  RUN_TEST(ast_assigned_call);
+  RUN_TEST(ast_prune_unreachable);
+}
@@ -0,0 +1,338 @@
+#include "../../lib/greatest.h"
+#include "../../src/ast.h"
+#include "../../src/codegen.h"
+#include "../../src/errors.h"
+#include "../../src/other.h"
+
+// defined in codegen.c, which is compiled in by expressions_tests.c
+extern THREAD_LOCAL dynstr_t main_buffer;
+void codegen_thread_init();
+void codegen_thread_free();
+
+/** Function defined by program of a test */
+typedef struct {
+  symtab_func_data_t data;  ///< Name, types of parameters and results
+  char *params[4];          ///< Names of parameters, types are in data
+  void (*body)(void);       ///< Adds statements of the body
+} codegen_test_func_t;
+
+// Functions of the program being generated, bodies can call them
+codegen_test_func_t *codegen_test_funcs = NULL;
+
+symtab_func_data_t codegen_test_write = {.func_name = "write",
+                                         .builtin = BUILTIN_WRITE};
+
+/**
+ * Builds program defining functions in order and calling main at the top
+ * level if given, then generates it by given number of threads.
+ * Program is kept until the next call or the end of the test.
+ * @return Copy of the generated code, NULL on error.
+ */
+char *codegen_test_program(codegen_test_func_t *funcs, int count,
+                           symtab_func_data_t *main, int jobs) {
+  error_clear();
+  ast_free();
+  ast_init();
+  codegen_test_funcs = funcs;
+  for (int i = 0; i < count; i++) {
+    ast_function_begin(funcs[i].data.func_name);
+    for (int j = 0; funcs[i].data.param_types[j]; j++) {
+      ast_function_param(funcs[i].params[j], funcs[i].data.param_types[j]);
+    }
+    ast_function_body(&funcs[i].data);
+    funcs[i].body();
+    ast_function_end();
+  }
+  if (main) {
+    ast_call_begin(main);
+    ast_call_end();
+    ast_prune();
+  }
+
+  codegen_thread_init();
+  codegen_program(ast_program, jobs);
+  char *code = error_get() ? NULL : str_create_copy(main_buffer.str);
+  codegen_thread_free();
+  return code;
+}
+
+void codegen_destroy(void *arg) {
+  (void)arg;
+  ast_free();
+}
+
+void codegen_write_loop(void) {
+  // while 1 do write(1) end
+  token_t one = {.type = TT_INTEGER, .attr.int_val = 1};
+  ast_while_begin(exptree_leaf(&ast_arena, &one, 'i', 0), 'i');
+  ast_call_begin(&codegen_test_write);
+  ast_call_arg(&one, 'i', 0);
+  ast_call_end();
+  ast_while_end();
+}
+
+TEST codegen_parallel_functions(void) {
+  // functions with loops writing a value, code does not depend on threads
+  codegen_test_func_t funcs[] = {
+      {{.func_name = "f", .param_types = "", .return_types = ""},
+       {NULL},
+       codegen_write_loop},
+      {{.func_name = "g", .param_types = "", .return_types = ""},
+       {NULL},
+       codegen_write_loop},
+      {{.func_name = "h", .param_types = "", .return_types = ""},
+       {NULL},
+       codegen_write_loop},
+  };
+  char *serial = codegen_test_program(funcs, 3, NULL, 1);
+  char *parallel = codegen_test_program(funcs, 3, NULL, 3);
+  ASSERT(serial && parallel);
+  ASSERT_STR_EQ(serial, parallel);
+  ASSERT(strstr(serial, "LABEL $while_3_0\n"));
+  ASSERT(strstr(serial, "JUMP $while_2_0\n"));
+
+  free(serial);
+  free(parallel);
+  PASS();
+}
+
+void codegen_return_x(void) {
+  // return x
+  token_t x = {.type = TT_ID, .attr.str = "x"};
+  ast_return_begin(1);
+  ast_value(exptree_leaf(&ast_arena, &x, 'i', 0), false);
+  ast_return_end();
+}
+
+void codegen_local_call(void) {
+  // local y : integer = g(1)
+  token_t one = {.type = TT_INTEGER, .attr.int_val = 1};
+  ast_local_begin("y", 'i');
+  ast_call_begin(&codegen_test_funcs[0].data);
+  ast_call_arg(&one, 'i', 0);
+  ast_call_end();
+  ast_local_end();
+}
+
+TEST codegen_inline_call(void) {
+  // function g(x) return x end  function f() local y = g(1) end  f()
+  codegen_test_func_t funcs[] = {
+      {{.func_name = "g", .param_types = "i", .return_types = "i"},
+       {"x"},
+       codegen_return_x},
+      {{.func_name = "f", .param_types = "", .return_types = ""},
+       {NULL},
+       codegen_local_call},
+  };
+  codegen_inlining = true;
+  char *code = codegen_test_program(funcs, 2, &funcs[1].data, 1);
+  codegen_inlining = false;
+  ASSERT(code);
+  ASSERT_EQ(1, codegen_inlined);
+  // parameter is defined in the frame of f, y is never read so the
+  // copies of the argument are removed
+  ASSERT(strstr(code, "DEFVAR LF@x$i1\n"));
+  ASSERT_EQ(NULL, strstr(code, "POPS LF@x$i1\n"));
+  ASSERT_EQ(NULL, strstr(code, "CALL $fn_g"));
+
+  free(code);
+  PASS();
+}
+
+void codegen_swapped_call(void) {
+  // local r : integer = f(b, a) return r
+  token_t a = {.type = TT_ID, .attr.str = "a"};
+  token_t b = {.type = TT_ID, .attr.str = "b"};
+  token_t r = {.type = TT_ID, .attr.str = "r"};
+  ast_local_begin("r", 'i');
+  ast_call_begin(&codegen_test_funcs[0].data);
+  ast_call_arg(&b, 'i', 0);
+  ast_call_arg(&a, 'i', 0);
+  ast_call_end();
+  ast_local_end();
+  ast_return_begin(1);
+  ast_value(exptree_leaf(&ast_arena, &r, 'i', 0), false);
+  ast_return_end();
+}
+
+TEST codegen_tail_call(void) {
+  // function f(a, b) : integer local r : integer = f(b, a) return r end
+  codegen_test_func_t funcs[] = {
+      {{.func_name = "f", .param_types = "ii", .return_types = "i"},
+       {"a", "b"},
+       codegen_swapped_call},
+  };
+  char *code = codegen_test_program(funcs, 1, NULL, 1);
+  ASSERT(code);
+  ASSERT(strstr(code, "LABEL $tailfn_f\n"));
+  ASSERT(strstr(code, "PUSHS LF@b\nMOVE LF@b LF@a\n"
+                      "POPS LF@a\nJUMP $tailfn_f\n"));
+  ASSERT_EQ(NULL, strstr(code, "CALL $fn_f"));
+
+  free(code);
+  PASS();
+}
+
+/** Expression i < #s, or i + #s if not a condition, at given depth */
+exptree_node_t *codegen_length_operation(exptree_kind_t kind, int lvl) {
+  token_t i = {.type = TT_ID, .attr.str = "i"};
+  token_t s = {.type = TT_ID, .attr.str = "s"};
+  exptree_node_t *len = exptree_op(&ast_arena, EXP_STRLEN, 'i',
+                                   exptree_leaf(&ast_arena, &s, 's', lvl),
+                                   NULL);
+  return exptree_op(&ast_arena, kind, kind == EXP_LT ? 'b' : 'i',
+                    exptree_leaf(&ast_arena, &i, 'i', lvl), len);
+}
+
+void codegen_nested_loops(int depth) {
+  // while i < #s do ... while i < #s do i = i + #s end ... end
+  for (int lvl = 0; lvl < depth; lvl++) {
+    ast_while_begin(codegen_length_operation(EXP_LT, lvl), 'b');
+  }
+  ast_assign_begin();
+  ast_assign_id("i", 'i', depth);
+  ast_value(codegen_length_operation(EXP_PLUS, depth), false);
+  ast_assign_end(1);
+  for (int lvl = 0; lvl < depth; lvl++) {
+    ast_while_end();
+  }
+}
+
+void codegen_loop(void) { codegen_nested_loops(1); }
+
+void codegen_deep_loops(void) { codegen_nested_loops(2000); }
+
+TEST codegen_loop_invariant(void) {
+  // function f(i, s) while i < #s do i = i + #s end end
+  codegen_test_func_t funcs[] = {
+      {{.func_name = "f", .param_types = "is", .return_types = ""},
+       {"i", "s"},
+       codegen_loop},
+  };
+  char *code = codegen_test_program(funcs, 1, NULL, 1);
+  ASSERT(code);
+  // length is computed once before the loop, not in every pass
+  ASSERT(strstr(code, "STRLEN LF@$tmp2 LF@s\n"
+                      "LT LF@$tmp1 LF@i LF@$tmp2\n"));
+  ASSERT(strstr(code, "PUSHS LF@i\nPUSHS LF@$tmp2\nADDS\n"));
+  ASSERT_EQ(NULL, strstr(strstr(code, "STRLEN") + 1, "STRLEN"));
+
+  free(code);
+  PASS();
+}
+
+TEST codegen_deep_loop_invariant(void) {
+  // loops nested deeply, i is assigned by the innermost one only
+  codegen_test_func_t funcs[] = {
+      {{.func_name = "f", .param_types = "is", .return_types = ""},
+       {"i", "s"},
+       codegen_deep_loops},
+  };
+  char *code = codegen_test_program(funcs, 1, NULL, 1);
+  ASSERT(code);
+  // length is computed before the outermost loop and reused by all,
+  // i is read again by every condition
+  ASSERT(strstr(code, "STRLEN LF@$tmp2 LF@s\n"
+                      "LT LF@$tmp1 LF@i LF@$tmp2\n"));
+  ASSERT_EQ(NULL, strstr(strstr(code, "STRLEN") + 1, "STRLEN"));
+  ASSERT(strstr(code, "LT LF@$tmp1 LF@i LF@$tmp2\n"
+                      "JUMPIFEQ $while_end_1_1999 LF@$tmp1 bool@false\n"));
+
+  free(code);
+  PASS();
+}
+
+void codegen_countdown(void) {
+  // while i > 0 do i = i - 1 end
+  token_t i = {.type = TT_ID, .attr.str = "i"};
+  token_t zero = {.type = TT_INTEGER, .attr.int_val = 0};
+  token_t one = {.type = TT_INTEGER, .attr.int_val = 1};
+  ast_while_begin(exptree_op(&ast_arena, EXP_GT, 'b',
+                             exptree_leaf(&ast_arena, &i, 'i', 0),
+                             exptree_leaf(&ast_arena, &zero, 'i', 0)),
+                  'b');
+  ast_assign_begin();
+  ast_assign_id("i", 'i', 1);
+  ast_value(exptree_op(&ast_arena, EXP_MINUS, 'i',
+                       exptree_leaf(&ast_arena, &i, 'i', 1),
+                       exptree_leaf(&ast_arena, &one, 'i', 0)),
+            false);
+  ast_assign_end(1);
+  ast_while_end();
+}
+
+TEST codegen_loop_rotation(void) {
+  // function f(i) while i > 0 do i = i - 1 end end
+  codegen_test_func_t funcs[] = {
+      {{.func_name = "f", .param_types = "i", .return_types = ""},
+       {"i"},
+       codegen_countdown},
+  };
+  char *code = codegen_test_program(funcs, 1, NULL, 1);
+  ASSERT(code);
+  // guard before the first pass, the body branches back while i > 0
+  ASSERT(strstr(code,
+                "GT LF@$tmp1 LF@i int@0\n"
+                "JUMPIFEQ $while_end_1_0 LF@$tmp1 bool@false\n"
+                "LABEL $while_1_0\n"));
+  ASSERT(strstr(code,
+                "POPS LF@i\nGT LF@$tmp1 LF@i int@0\n"
+                "JUMPIFEQ $while_1_0 LF@$tmp1 bool@true\n"
+                "LABEL $while_end_1_0\n"));
+  ASSERT_EQ(NULL, strstr(code, "JUMP $while_1_0"));
+
+  free(code);
+  PASS();
+}
+
+void codegen_uninitialized(void) {
+  // local a : integer local b : integer b = 1 return a, b
+  token_t a = {.type = TT_ID, .attr.str = "a"};
+  token_t b = {.type = TT_ID, .attr.str = "b"};
+  token_t one = {.type = TT_INTEGER, .attr.int_val = 1};
+  ast_local_begin("a", 'i');
+  ast_local_end();
+  ast_local_begin("b", 'i');
+  ast_local_end();
+  ast_assign_begin();
+  ast_assign_id("b", 'i', 0);
+  ast_value(exptree_leaf(&ast_arena, &one, 'i', 0), false);
+  ast_assign_end(1);
+  ast_return_begin(2);
+  ast_value(exptree_leaf(&ast_arena, &a, 'i', 0), false);
+  ast_value(exptree_leaf(&ast_arena, &b, 'i', 0), false);
+  ast_return_end();
+}
+
+TEST codegen_frame_layout(void) {
+  // function f() : integer, integer
+  //   local a : integer local b : integer b = 1 return a, b end
+  codegen_test_func_t funcs[] = {
+      {{.func_name = "f", .param_types = "", .return_types = "ii"},
+       {NULL},
+       codegen_uninitialized},
+  };
+  char *code = codegen_test_program(funcs, 1, NULL, 1);
+  ASSERT(code);
+  // variables are defined together, only a can be read while nil
+  ast_node_t *local = ast_program->body;
+  ASSERT_EQ(CODEGEN_ACCESS_READ, codegen_first_access(local->next, "a"));
+  ASSERT_EQ(CODEGEN_ACCESS_ASSIGNED,
+            codegen_first_access(local->next->next, "b"));
+  ASSERT(strstr(code, "PUSHFRAME\nDEFVAR LF@a\nDEFVAR LF@b\n"));
+  ASSERT_EQ(NULL, strstr(code, "MOVE LF@b nil@nil\n"));
+
+  free(code);
+  PASS();
+}
+
+SUITE(codegen_tests) {
+  GREATEST_SET_TEARDOWN_CB(codegen_destroy, NULL);
+  RUN_TEST(codegen_parallel_functions);
+  RUN_TEST(codegen_inline_call);
+  RUN_TEST(codegen_tail_call);
+  RUN_TEST(codegen_loop_invariant);
+  RUN_TEST(codegen_deep_loop_invariant);
+  RUN_TEST(codegen_loop_rotation);
+  RUN_TEST(codegen_frame_layout);
+}
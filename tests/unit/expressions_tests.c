@@ -1,8 +1,11 @@
 #include "../../lib/greatest.h"
+#include "../../src/arena.c"
 #include "../../src/codegen.c"
 #include "../../src/scope.c"
 #include "../../src/errors.c"
 #include "../../src/expressions.c"
+#include "../../src/exptree.c"
+#include "../../src/other.c"
 #include "../../src/parser.c"
 #include "../../src/symtable.c"
 #include "scanner_tests.h"
@@ -10,12 +13,18 @@
 void expressions_init(void *arg) {
   (void)arg;
   scanner_init();
+  error_clear();
   parser_init_symtab();
+  symtab_subtab_push(symtab);
+  parser_declare_var("i", 'i');
+  parser_declare_var("n", 'n');
+  parser_declare_var("s", 's');
 }
 
 void expressions_destroy(void *arg) {
   (void)arg;
   scanner_destroy();
+  parser_destroy_symtab();
 }
 
 TEST expressions_basic(void) {
@@ -63,6 +72,220 @@ TEST expressions_invalid1(void) {
   PASS();
 }
 
+TEST expressions_typecheck_table(void) {
+  const expression_typerule_t *rule = expression_typecheck(SYM_PLUS, 'i', 'n');
+  ASSERT_EQ('n', rule->type);
+  ASSERT_EQ('n', rule->cast_left);
+  ASSERT_EQ(0, rule->cast_right);
+
+  rule = expression_typecheck(SYM_DIVIDE2, 'n', 'n');
+  ASSERT_EQ('i', rule->type);
+  ASSERT_EQ('i', rule->cast_left);
+  ASSERT_EQ('i', rule->cast_right);
+
+  ASSERT_EQ('b', expression_typecheck(SYM_EQ, 'x', 'i')->type);
+  ASSERT_EQ(EXITSTATUS_ERROR_UNEXPECTED_NIL,
+            expression_typecheck(SYM_DOTDOT, 's', 'x')->error);
+  ASSERT_EQ(EXITSTATUS_ERROR_SEMANTIC_TYPE_EXPR,
+            expression_typecheck(SYM_DIVIDE, 's', 'n')->error);
+  ASSERT_EQ(EXITSTATUS_ERROR_SEMANTIC_TYPE_EXPR,
+            expression_typecheck(SYM_LT, 's', 's')->error);
+  PASS();
+}
+
+TEST expressions_tree(void) {
+  SET_INPUT("i + 2.5 * #s");
+  error_clear();
+  token_buff(TOKEN_NEW);
+  char type;
+  arena_t arena;
+  arena_init(&arena);
+  exptree_node_t *tree;
+  ASSERT(expression_parse_tree(&type, &tree, &arena));
+
+  ASSERT_EQ('n', type);
+  ASSERT_EQ(EXP_PLUS, tree->kind);
+  ASSERT_EQ(0, tree->begin);
+  ASSERT_EQ(12, tree->end);
+  ASSERT_EQ(EXP_INT2FLOAT, tree->left->kind);
+  ASSERT_EQ(EXP_ID, tree->left->left->kind);
+  ASSERT_STR_EQ("i", tree->left->left->value.str);
+
+  exptree_node_t *mul = tree->right;
+  ASSERT_EQ(EXP_MUL, mul->kind);
+  ASSERT_EQ('n', mul->type);
+  ASSERT_EQ(EXP_NUMBER, mul->left->kind);
+  ASSERT_EQ(EXP_INT2FLOAT, mul->right->kind);
+  ASSERT_EQ(EXP_STRLEN, mul->right->left->kind);
+  ASSERT_EQ(10, mul->right->left->begin);
+  ASSERT_STR_EQ("s", mul->right->left->left->value.str);
+
+  arena_free(&arena);
+  fclose(stdin);
+  PASS();
+}
+
+TEST expressions_tree_equal(void) {
+  SET_INPUT("#s * 3 + #s * 3 + #s * 4");
+  error_clear();
+  token_buff(TOKEN_NEW);
+  char type;
+  arena_t arena;
+  arena_init(&arena);
+  exptree_node_t *tree;
+  ASSERT(expression_parse_tree(&type, &tree, &arena));
+
+  exptree_node_t *first = tree->left->left;
+  exptree_node_t *second = tree->left->right;
+  ASSERT(first != second);
+  ASSERT_EQ(first->hash, second->hash);
+  ASSERT(exptree_equal(first, second));
+  ASSERT_FALSE(exptree_equal(first, tree->right));
+
+  exptree_node_t *copy = exptree_copy(&arena, first);
+  ASSERT(copy != NULL);
+  ASSERT(exptree_equal(copy, first));
+
+  arena_free(&arena);
+  fclose(stdin);
+  PASS();
+}
+
+TEST expressions_repeated_value(void) {
+  SET_INPUT("#s * #s");
+  error_clear();
+  token_buff(TOKEN_NEW);
+  scope_init();
+  dynstr_init(&main_buffer);
+  active_buffer = &main_buffer;
+  arena_init(&cse_arena);
+  char type;
+  ASSERT(expression_parse(&type));
+
+  // length is computed once and saved
+  char *first = strstr(main_buffer.str, "STRLEN");
+  ASSERT(first != NULL);
+  ASSERT_EQ(NULL, strstr(first + 1, "STRLEN"));
+  ASSERT(strstr(main_buffer.str,
+                "POPS LF@$cse1\nPUSHS LF@$cse1\n"
+                "PUSHS LF@$cse1\nMULS\n") != NULL);
+
+  codegen_cse_clear();
+  arena_free(&cse_arena);
+  scope_destroy();
+  dynstr_free_buffer(&main_buffer);
+  active_buffer = NULL;
+  cse_max = 0;
+  fclose(stdin);
+  PASS();
+}
+
+TEST expressions_concat(void) {
+  SET_INPUT("\"a\" .. \"b c\" .. \"d\"");
+  error_clear();
+  token_buff(TOKEN_NEW);
+  char type;
+  arena_t arena;
+  arena_init(&arena);
+  exptree_node_t *tree;
+  ASSERT(expression_parse_tree(&type, &tree, &arena));
+
+  // literals are joined at compile time
+  ASSERT_EQ(EXP_STRING, tree->kind);
+  ASSERT_STR_EQ("ab\\032cd", tree->value.str);
+
+  // x .. "a" .. y .. "b" .. "c"
+  token_t x = {.type = TT_ID, .attr.str = "x"};
+  token_t y = {.type = TT_ID, .attr.str = "y"};
+  token_t a = {.type = TT_STRING, .attr.str = "a"};
+  token_t b = {.type = TT_STRING, .attr.str = "b"};
+  exptree_node_t *chain = exptree_leaf(&arena, &x, 's', 0);
+  token_t *operands[] = {&a, &y, &b, &b};
+  for (int i = 0; i < 4; i++) {
+    chain = exptree_concat(&arena, 's', chain,
+                           exptree_leaf(&arena, operands[i], 's', 0));
+  }
+  ASSERT_EQ(EXP_CONCAT, chain->kind);
+  ASSERT_STR_EQ("bb", chain->right->value.str);
+
+  scope_init();
+  dynstr_init(&main_buffer);
+  active_buffer = &main_buffer;
+  tmpmax = 0;
+  codegen_expression_concat_chain(chain);
+  ASSERT_STR_EQ(
+      "CONCAT LF@$tmp1 LF@x string@a\n"
+      "CONCAT LF@$tmp1 LF@$tmp1 LF@y\n"
+      "CONCAT LF@$tmp1 LF@$tmp1 string@bb\n"
+      "PUSHS LF@$tmp1\n",
+      main_buffer.str);
+
+  scope_destroy();
+  dynstr_free_buffer(&main_buffer);
+  active_buffer = NULL;
+  tmpmax = 0;
+  arena_free(&arena);
+  fclose(stdin);
+  PASS();
+}
+
+TEST expressions_condition_jump(char *input, char *expected) {
+  SET_INPUT(input);
+  error_clear();
+  token_buff(TOKEN_NEW);
+  scope_init();
+  dynstr_init(&main_buffer);
+  active_buffer = &main_buffer;
+  arena_init(&cse_arena);
+  tmpmax = 0;
+  char type;
+  exptree_node_t *tree;
+  ASSERT(expression_parse_condition(&type, &tree));
+  codegen_condition_jump(tree, type, false, "$else_", 0);
+  ASSERT_STR_EQ(expected, main_buffer.str);
+
+  arena_free(&cse_arena);
+  scope_destroy();
+  dynstr_free_buffer(&main_buffer);
+  active_buffer = NULL;
+  tmpmax = 0;
+  fclose(stdin);
+  PASS();
+}
+
+TEST expressions_simplified(char *input, char *expected) {
+  SET_INPUT(input);
+  error_clear();
+  token_buff(TOKEN_NEW);
+  scope_init();
+  dynstr_init(&main_buffer);
+  active_buffer = &main_buffer;
+  arena_init(&cse_arena);
+  char type;
+  ASSERT(expression_parse(&type));
+  ASSERT_STR_EQ(expected, main_buffer.str);
+
+  arena_free(&cse_arena);
+  scope_destroy();
+  dynstr_free_buffer(&main_buffer);
+  active_buffer = NULL;
+  fclose(stdin);
+  PASS();
+}
+
+TEST expressions_condition_truth(char *input, exptree_truth_t expected) {
+  SET_INPUT(input);
+  error_clear();
+  token_buff(TOKEN_NEW);
+  char type;
+  exptree_node_t *tree;
+  ASSERT(expression_parse_condition(&type, &tree));
+  ASSERTm(input, expected == exptree_truth(tree));
+
+  fclose(stdin);
+  PASS();
+}
+
 SUITE(expressions_tests) {
   GREATEST_SET_SETUP_CB(expressions_init, NULL);
   GREATEST_SET_TEARDOWN_CB(expressions_destroy, NULL);
@@ -70,4 +293,41 @@ SUITE(expressions_tests) {
   RUN_TEST(expressions_parentheses);
   RUN_TEST(expressions_parentheses2);
   RUN_TEST(expressions_invalid1);
+  RUN_TEST(expressions_typecheck_table);
+  RUN_TEST(expressions_tree);
+  RUN_TEST(expressions_tree_equal);
+  RUN_TEST(expressions_repeated_value);
+  RUN_TEST(expressions_concat);
+  RUN_TESTp(expressions_condition_jump, "2 == 3",
+            "JUMPIFNEQ $else_0 int@2 int@3\n");
+  RUN_TESTp(expressions_condition_jump, "2 < 3",
+            "LT LF@$tmp1 int@2 int@3\n"
+            "JUMPIFEQ $else_0 LF@$tmp1 bool@false\n");
+  RUN_TESTp(expressions_condition_jump, "i * 3 <= 3",
+            "PUSHS LF@i\nPUSHS int@3\nMULS\nPUSHS int@3\n"
+            "GTS\nPUSHS bool@true\nJUMPIFEQS $else_0\n");
+  RUN_TESTp(expressions_condition_jump, "\"a\"",
+            "JUMPIFEQ $else_0 nil@nil string@a\n");
+  // variable could be nil, operation is kept
+  RUN_TESTp(expressions_simplified, "i * 1", "PUSHS LF@i\nPUSHS int@1\nMULS\n");
+  RUN_TESTp(expressions_simplified, "(i + 1) * 1 + 0 - 0",
+            "PUSHS LF@i\nPUSHS int@1\nADDS\n");
+  RUN_TESTp(expressions_simplified, "2 * 3 + 1.5", "PUSHS float@0x1.ep+2\n");
+  RUN_TESTp(expressions_simplified, "i * 2", "PUSHS LF@i\nPUSHS LF@i\nADDS\n");
+  RUN_TESTp(expressions_simplified, "n / 4",
+            "PUSHS LF@n\nPUSHS float@0x1p-2\nMULS\n");
+  RUN_TESTp(expressions_simplified, "n / 3",
+            "PUSHS LF@n\nPUSHS float@0x1.8p+1\nDIVS\n");
+  RUN_TESTp(expressions_condition_truth, "1 == 1", EXPTREE_TRUE);
+  RUN_TESTp(expressions_condition_truth, "0 > 1", EXPTREE_FALSE);
+  RUN_TESTp(expressions_condition_truth, "2 * 3 >= 6.0", EXPTREE_TRUE);
+  RUN_TESTp(expressions_condition_truth, "nil ~= nil", EXPTREE_FALSE);
+  RUN_TESTp(expressions_condition_truth, "#\"a b\" == 3", EXPTREE_TRUE);
+  RUN_TESTp(expressions_condition_truth, "\"ab\" == \"a\"", EXPTREE_FALSE);
+  RUN_TESTp(expressions_condition_truth, "nil", EXPTREE_FALSE);
+  RUN_TESTp(expressions_condition_truth, "0", EXPTREE_TRUE);
+  RUN_TESTp(expressions_condition_truth, "1 // (1 - 1) == 0",
+            EXPTREE_UNKNOWN);
+  RUN_TESTp(expressions_condition_truth, "\"a\" .. \"b\" == \"ab\"",
+            EXPTREE_TRUE);
 }
@@ -5,6 +5,10 @@ SUITE_EXTERN(scanner_basic_tests);
 SUITE_EXTERN(scanner_input_file_tests);
 SUITE_EXTERN(scanner_keyword_tests);
 SUITE_EXTERN(expressions_tests);
+SUITE_EXTERN(symtable_tests);
+SUITE_EXTERN(optimizer_tests);
+SUITE_EXTERN(ast_tests);
+SUITE_EXTERN(codegen_tests);
 
 GREATEST_MAIN_DEFS();
 
@@ -16,6 +20,10 @@ int main(int argc, char **argv) {
   RUN_SUITE(scanner_input_file_tests);
   RUN_SUITE(scanner_keyword_tests);
   RUN_SUITE(expressions_tests);
+  RUN_SUITE(symtable_tests);
+  RUN_SUITE(optimizer_tests);
+  RUN_SUITE(ast_tests);
+  RUN_SUITE(codegen_tests);
 
   GREATEST_MAIN_END();
 }
@@ -0,0 +1,194 @@
+#include "../../lib/greatest.h"
+#include "../../src/optimizer.c"
+
+/** Optimizes code and compares result. */
+#define ASSERT_OPTIMIZED(expected, code)  \
+  do {                                    \
+    dynstr_t out;                         \
+    dynstr_init(&out);                    \
+    dynstr_append_str(&out, code);        \
+    optimizer_function(&out);             \
+    ASSERT_STR_EQ(expected, out.str);     \
+    dynstr_free_buffer(&out);             \
+  } while (0)
+
+TEST optimizer_roundtrip(void) {
+  char *code =
+      "DEFVAR LF@x\n"
+      "# comment\n"
+      "READ LF@x int\n"
+      "JUMPIFEQ $write_nil0 nil@nil LF@x\n"
+      "WRITE LF@x\n"
+      "JUMP $write_end0\n"
+      "LABEL $write_nil0\n"
+      "WRITE string@nil\n"
+      "LABEL $write_end0\n"
+      "\n";
+  ASSERT_OPTIMIZED(code, code);
+  PASS();
+}
+
+TEST optimizer_write_not_nil(void) {
+  ASSERT_OPTIMIZED(
+      "WRITE int@1\n"
+      "RETURN\n",
+      "PUSHS int@1\n"
+      "POPS LF@x\n"
+      "JUMPIFEQ $write_nil0 nil@nil LF@x\n"
+      "WRITE LF@x\n"
+      "JUMP $write_end0\n"
+      "LABEL $write_nil0\n"
+      "WRITE string@nil\n"
+      "LABEL $write_end0\n"
+      "RETURN\n");
+  PASS();
+}
+
+TEST optimizer_condition_not_nil(void) {
+  ASSERT_OPTIMIZED(
+      "PUSHS string@a\n"
+      "# if_0\n"
+      "POPS LF@$tmp1\n"
+      "WRITE int@1\n"
+      "RETURN\n",
+      "MOVE LF@x string@a\n"
+      "PUSHS LF@x\n"
+      "PUSHS nil@nil\n"
+      "EQS\n"
+      "NOTS\n"
+      "# if_0\n"
+      "POPS LF@$tmp1\n"
+      "JUMPIFEQ $else_0 LF@$tmp1 bool@false\n"
+      "WRITE int@1\n"
+      "RETURN\n"
+      "LABEL $else_0\n"
+      "WRITE int@2\n"
+      "RETURN\n");
+  PASS();
+}
+
+TEST optimizer_loop_may_be_nil(void) {
+  // x becomes nil in the loop, check in loop condition is kept
+  char *code =
+      "MOVE LF@x int@1\n"
+      "LABEL $while_0\n"
+      "PUSHS LF@x\n"
+      "PUSHS nil@nil\n"
+      "EQS\n"
+      "NOTS\n"
+      "POPS LF@$tmp1\n"
+      "JUMPIFEQ $while_end_0 LF@$tmp1 bool@false\n"
+      "MOVE LF@x nil@nil\n"
+      "JUMP $while_0\n"
+      "LABEL $while_end_0\n";
+  ASSERT_OPTIMIZED(code, code);
+  PASS();
+}
+
+TEST optimizer_helper_kept(void) {
+  // code entered only by CALL is not changed
+  char *code =
+      "JUMP $ord_end\n"
+      "LABEL $ord\n"
+      "PUSHFRAME\n"
+      "JUMPIFEQ $ord_ret nil@nil int@1\n"
+      "LABEL $ord_ret\n"
+      "POPFRAME\n"
+      "RETURN\n"
+      "LABEL $ord_end\n"
+      "CALL $ord\n";
+  ASSERT_OPTIMIZED(code, code);
+  PASS();
+}
+
+TEST optimizer_temps_shared(void) {
+  // $tmp1 and $cse1 are never live at the same time, $licm1 always is
+  dynstr_t out;
+  dynstr_init(&out);
+  dynstr_append_str(&out,
+                    "DEFVAR LF@$tmp1\n"
+                    "READ LF@$licm1 int\n"
+                    "LABEL $while_0\n"
+                    "READ LF@$tmp1 int\n"
+                    "WRITE LF@$tmp1\n"
+                    "ADD LF@$cse1 LF@$licm1 int@1\n"
+                    "WRITE LF@$cse1\n"
+                    "JUMP $while_0\n");
+  ASSERT_EQ(2, optimizer_function(&out));
+  ASSERT_STR_EQ(
+      "READ LF@$tmp2 int\n"
+      "LABEL $while_0\n"
+      "READ LF@$tmp1 int\n"
+      "WRITE LF@$tmp1\n"
+      "ADD LF@$tmp1 LF@$tmp2 int@1\n"
+      "WRITE LF@$tmp1\n"
+      "JUMP $while_0\n",
+      out.str);
+  dynstr_free_buffer(&out);
+  PASS();
+}
+
+TEST optimizer_copies_removed(void) {
+  // x and t only copy other variables, nil stored to t is never read
+  ASSERT_OPTIMIZED(
+      "READ LF@y int\n"
+      "LABEL $while_0\n"
+      "PUSHS LF@y\n"
+      "PUSHS int@1\n"
+      "ADDS\n"
+      "POPS LF@z\n"
+      "CONCAT LF@$tmp1 LF@s string@a\n"
+      "WRITE LF@$tmp1\n"
+      "JUMP $while_0\n",
+      "READ LF@y int\n"
+      "PUSHS LF@y\n"
+      "POPS LF@x\n"
+      "LABEL $while_0\n"
+      "PUSHS LF@x\n"
+      "PUSHS int@1\n"
+      "ADDS\n"
+      "POPS LF@z\n"
+      "CONCAT LF@$tmp1 LF@s string@a\n"
+      "MOVE LF@t LF@$tmp1\n"
+      "WRITE LF@t\n"
+      "MOVE LF@t nil@nil\n"
+      "JUMP $while_0\n");
+  PASS();
+}
+
+TEST optimizer_removed_push(void) {
+  // p is never read, its pushed value is gone when nil check of q is checked
+  ASSERT_OPTIMIZED(
+      "PUSHS nil@nil\n"
+      "POPS LF@q\n"
+      "JUMPIFEQ $write_nil0 nil@nil LF@q\n"
+      "WRITE LF@q\n"
+      "JUMP $write_end0\n"
+      "LABEL $write_nil0\n"
+      "WRITE string@nil\n"
+      "LABEL $write_end0\n"
+      "RETURN\n",
+      "PUSHS nil@nil\n"
+      "PUSHS int@3\n"
+      "POPS LF@p\n"
+      "POPS LF@q\n"
+      "JUMPIFEQ $write_nil0 nil@nil LF@q\n"
+      "WRITE LF@q\n"
+      "JUMP $write_end0\n"
+      "LABEL $write_nil0\n"
+      "WRITE string@nil\n"
+      "LABEL $write_end0\n"
+      "RETURN\n");
+  PASS();
+}
+
+SUITE(optimizer_tests) {
+  RUN_TEST(optimizer_roundtrip);
+  RUN_TEST(optimizer_write_not_nil);
+  RUN_TEST(optimizer_condition_not_nil);
+  RUN_TEST(optimizer_loop_may_be_nil);
+  RUN_TEST(optimizer_helper_kept);
+  RUN_TEST(optimizer_temps_shared);
+  RUN_TEST(optimizer_copies_removed);
+  RUN_TEST(optimizer_removed_push);
+}
@@ -1,6 +1,7 @@
 #include "scanner_tests.h"
 #include "../../lib/greatest.h"
 
+#include "../../src/hash.c"
 #include "../../src/scanner.c"
 
 
@@ -153,6 +154,9 @@ enum greatest_test_res param_single_tok_test(char *in, char *a_str, int a_int, d
   if (a_str != NULL) { // if a_str != NULL, we expect this token to be of type that has a string as its attribute
     ASSERT_NEQ(NULL, tok->attr.str);
     ASSERT_STR_EQ(a_str, tok->attr.str);
+    if (expected_type == TT_ID) {
+      ASSERT_EQ(hash_key(a_str, strlen(a_str)), tok->hash);
+    }
   }
   else if (expected_type == TT_INTEGER) {
     ASSERT_EQ(a_int, tok->attr.int_val);
@@ -535,6 +539,30 @@ TEST comments_correct_test() {
   PASS();
 }
 
+// token position tests
+TEST token_span_test() {
+  SET_INPUT("  abc -- x\n 42 ..");
+  token_t *tok = scanner_get_next_token();
+  ASSERT_EQ(TT_ID, tok->type);
+  ASSERT_EQ(2, tok->begin);
+  ASSERT_EQ(5, tok->end);
+  scanner_token_destroy(tok);
+
+  tok = scanner_get_next_token();
+  ASSERT_EQ(TT_INTEGER, tok->type);
+  ASSERT_EQ(12, tok->begin);
+  ASSERT_EQ(14, tok->end);
+  scanner_token_destroy(tok);
+
+  tok = scanner_get_next_token();
+  ASSERT_EQ(TT_SOP_CONCAT, tok->type);
+  ASSERT_EQ(15, tok->begin);
+  ASSERT_EQ(17, tok->end);
+  scanner_token_destroy(tok);
+  fclose(stdin);
+
+  PASS();
+}
 
 SUITE(scanner_basic_tests) {
   GREATEST_SET_SETUP_CB(start_scanner, NULL);
@@ -550,6 +578,7 @@ SUITE(scanner_basic_tests) {
   RUN_TEST(one_char_possible_other_test);
   RUN_TEST(multi_char_op_test);
   RUN_TEST(comments_correct_test);
+  RUN_TEST(token_span_test);
 }
 
 // whole program tests
@@ -0,0 +1,100 @@
+#include "../../lib/greatest.h"
+#include "../../src/errors.h"
+#include "../../src/symtable.h"
+
+TEST symtable_stats_disabled(void) {
+  error_clear();
+  symtab_t *tab = symtab_create();
+  ASSERT_NEQ(NULL, tab);
+  ASSERT_EQ(NULL, tab->stats);
+
+  ASSERT_NEQ(NULL, symtab_find_func(tab, "write"));
+
+  symtab_free(tab);
+  PASS();
+}
+
+TEST symtable_stats_lookups(void) {
+  error_clear();
+  symtab_t *tab = symtab_create();
+  ASSERT(symtab_stats_enable(tab));
+
+  ASSERT_NEQ(NULL, symtab_find_func(tab, "write"));
+  ASSERT_EQ(NULL, symtab_find_func(tab, "foo"));
+
+  ASSERT_EQ(2, tab->stats->lookups);
+  ASSERT_EQ(1, tab->stats->hits);
+  ASSERT(tab->stats->probes >= 1);
+  ASSERT(tab->stats->max_probes >= 1);
+
+  symtab_free(tab);
+  PASS();
+}
+
+TEST symtable_stats_scopes(void) {
+  error_clear();
+  symtab_t *tab = symtab_create();
+  ASSERT(symtab_stats_enable(tab));
+
+  ASSERT(symtab_subtab_push(tab));
+  symtab_insert_var(tab, "a");
+  symtab_insert_var(tab, "b");
+  ASSERT(symtab_subtab_push(tab));
+  symtab_insert_var(tab, "c");
+
+  int lvl = 0;
+  ASSERT_NEQ(NULL, symtab_find_var(tab, "a", &lvl));
+  ASSERT_EQ(1, lvl);
+  ASSERT_EQ(2, tab->stats->peak_depth);
+
+  symtab_subtab_pop(tab);
+  symtab_subtab_pop(tab);
+
+  ASSERT_EQ(0, tab->stats->depth);
+  ASSERT_EQ(2, tab->stats->scopes);
+  ASSERT_EQ(3, tab->stats->local_records);
+  ASSERT_EQ(2, tab->stats->max_scope_records);
+
+  symtab_free(tab);
+  PASS();
+}
+
+TEST symtable_cache_shadowing(void) {
+  error_clear();
+  symtab_t *tab = symtab_create();
+  ASSERT(symtab_stats_enable(tab));
+
+  ASSERT(symtab_subtab_push(tab));
+  symtab_var_data_t *outer = symtab_insert_var(tab, "a");
+  ASSERT(symtab_subtab_push(tab));
+
+  int lvl = 0;
+  ASSERT_EQ(outer, symtab_find_var(tab, "a", &lvl));
+  ASSERT_EQ(1, lvl);
+  lvl = 0;
+  ASSERT_EQ(outer, symtab_find_var(tab, "a", &lvl));
+  ASSERT_EQ(1, lvl);
+  ASSERT_EQ(1, tab->stats->cache_hits);
+
+  symtab_var_data_t *inner = symtab_insert_var(tab, "a");
+  lvl = 0;
+  ASSERT_EQ(inner, symtab_find_var(tab, "a", &lvl));
+  ASSERT_EQ(0, lvl);
+
+  symtab_subtab_pop(tab);
+  lvl = 0;
+  ASSERT_EQ(outer, symtab_find_var(tab, "a", &lvl));
+  ASSERT_EQ(0, lvl);
+  ASSERT_EQ(1, tab->stats->cache_hits);
+
+  symtab_subtab_pop(tab);
+  symtab_free(tab);
+  PASS();
+}
+
+SUITE(symtable_tests) {
+  RUN_TEST(symtable_stats_disabled);
+  RUN_TEST(symtable_stats_lookups);
+  RUN_TEST(symtable_stats_scopes);
+  RUN_TEST(symtable_cache_shadowing);
+}